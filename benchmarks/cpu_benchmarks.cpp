@@ -0,0 +1,347 @@
+#include "model_loader.hpp"
+#include "mesh_tangents.hpp"
+#include "mesh_primitives.hpp"
+#include "performance_tracker.hpp"
+#include "frame_statistics.hpp"
+#include "pipelines/geometry_pipeline.hpp"
+#include "hdr_target.hpp"
+#include <fastgltf/core.hpp>
+#include <fstream>
+
+// Times the CPU side of asset processing and of the frame loop on the bundled models. Nothing in here creates a Vulkan
+// instance or device, so it runs on machines without a GPU. Run it from the repository root:
+//   ferrite_benchmarks [--models <directory>] [--iterations <count>] [--json <file>]
+// With --check it only runs the regression checks and fails when one of them does.
+
+namespace
+{
+constexpr uint32_t DEFAULT_ITERATIONS = 5;
+// Copies of the model in the draw gathering scene, laid out in a grid.
+constexpr uint32_t SCENE_INSTANCES = 64;
+// Gathering and sphere generation only take microseconds, they're repeated within an iteration to get above timer noise.
+constexpr uint32_t SHORT_BENCHMARK_REPEATS = 100;
+// Frames recorded by a single iteration of the performance tracker benchmark.
+constexpr uint32_t TRACKER_FRAMES = 10000;
+constexpr float VIEWPORT_HEIGHT = 1080.0f;
+
+struct BenchmarkResult
+{
+    std::string name;
+    std::string unit;
+    double itemsPerIteration;
+    double medianMilliseconds;
+    double minMilliseconds;
+
+    double Throughput() const { return itemsPerIteration / (medianMilliseconds / 1000.0); }
+};
+
+// Runs the function once to warm up caches and allocators, then times it for every iteration.
+template <typename F>
+BenchmarkResult Measure(std::string name, std::string unit, double itemsPerIteration, uint32_t iterations, F&& function)
+{
+    function();
+
+    std::vector<double> samples(std::max(iterations, 1u));
+    for(auto& sample : samples)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        sample = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    BenchmarkResult result{ std::move(name), std::move(unit), itemsPerIteration, samples[samples.size() / 2], samples.front() };
+
+    spdlog::info("{:<44} median {:>10.3f}ms, min {:>10.3f}ms, {:>14.1f} {}/s",
+                 result.name, result.medianMilliseconds, result.minMilliseconds, result.Throughput(), result.unit);
+
+    return result;
+}
+
+// Everything ModelLoader::Load does on the CPU for a model, except mesh optimization and meshlet building.
+void RunModelBenchmarks(const std::filesystem::path& path, uint32_t iterations, std::vector<BenchmarkResult>& results)
+{
+    // External buffers and images are read into memory, so file access isn't part of the measurements.
+    auto data = fastgltf::GltfDataBuffer::FromPath(path);
+    if(!data)
+        throw std::runtime_error("Failed reading " + path.string());
+
+    fastgltf::Parser parser;
+    auto loadedGltf = parser.loadGltf(data.get(), path.parent_path(),
+                                      fastgltf::Options::DecomposeNodeMatrices | fastgltf::Options::LoadExternalBuffers | fastgltf::Options::LoadExternalImages);
+    if(!loadedGltf)
+        throw std::runtime_error(getErrorMessage(loadedGltf.error()).data());
+
+    const fastgltf::Asset& gltf = loadedGltf.get();
+    std::string modelName = path.stem().string();
+
+    std::vector<MeshPrimitive> primitives;
+    ModelLoader::ProcessTimings timings{};
+    auto processPrimitives = [&]()
+    {
+        primitives.clear();
+        for(const auto& mesh : gltf.meshes)
+            for(const auto& primitive : mesh.primitives)
+                primitives.emplace_back(ModelLoader::ProcessPrimitive(primitive, gltf, timings));
+    };
+    processPrimitives();
+
+    size_t vertexCount = 0;
+    for(const auto& primitive : primitives)
+        vertexCount += primitive.vertices.size();
+
+    results.emplace_back(Measure(modelName + " ProcessPrimitive", "vertices", vertexCount, iterations, processPrimitives));
+    results.emplace_back(Measure(modelName + " CalculateTangents", "vertices", vertexCount, iterations, [&]()
+    {
+        for(auto& primitive : primitives)
+            CalculateTangents(primitive);
+    }));
+
+    if(!gltf.images.empty())
+    {
+        std::vector<Texture> textures(gltf.images.size());
+        auto decodeImages = [&]()
+        {
+            for(size_t i = 0; i < gltf.images.size(); ++i)
+                textures[i] = ModelLoader::ProcessImage(gltf.images[i], gltf);
+        };
+        decodeImages();
+
+        double megapixels = 0.0;
+        for(const auto& texture : textures)
+            megapixels += texture.width * texture.height / 1000000.0;
+
+        results.emplace_back(Measure(modelName + " ProcessImage", "megapixels", megapixels, iterations, decodeImages));
+    }
+
+    auto model = std::make_shared<ModelHandle>();
+    size_t primitiveIndex = 0;
+    for(const auto& mesh : gltf.meshes)
+    {
+        auto meshHandle = std::make_shared<MeshHandle>();
+        for(size_t i = 0; i < mesh.primitives.size(); ++i)
+            meshHandle->primitives.emplace_back(ModelLoader::DescribePrimitive(primitives[primitiveIndex++]));
+
+        model->meshes.emplace_back(std::move(meshHandle));
+    }
+    ModelLoader::BuildHierarchy(*model, gltf);
+
+    SceneDescription scene{};
+    scene.camera.position = glm::vec3{ 0.0f, 0.2f, 0.0f };
+    scene.camera.rotation = glm::quat{ 1.0f, 0.0f, 0.0f, 0.0f };
+    scene.camera.fov = glm::radians(45.0f);
+    scene.camera.nearPlane = 0.01f;
+    scene.camera.farPlane = 100.0f;
+    scene.models.emplace_back(model);
+
+    // Spread out by the model size, so the instances end up at different LODs.
+    BoundingBox bounds{};
+    for(const auto& node : model->hierarchy.allNodes)
+        for(const auto& primitive : node.mesh->primitives)
+        {
+            bounds.min = glm::min(bounds.min, glm::vec3{ node.transform * glm::vec4{ primitive.boundingBox.min, 1.0f } });
+            bounds.max = glm::max(bounds.max, glm::vec3{ node.transform * glm::vec4{ primitive.boundingBox.max, 1.0f } });
+        }
+    float spacing = glm::length(bounds.max - bounds.min) * 1.5f;
+
+    auto gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(SCENE_INSTANCES))));
+    for(uint32_t i = 0; i < SCENE_INSTANCES; ++i)
+    {
+        glm::vec3 offset{ static_cast<float>(i % gridSize) * spacing, 0.0f, -static_cast<float>(i / gridSize + 1) * spacing };
+        scene.gameObjects.emplace_back(GameObject{ glm::translate(glm::mat4{ 1.0f }, offset), model });
+    }
+
+    std::vector<DrawCall> drawCalls;
+    std::vector<glm::mat4> transforms;
+    GeometryPipeline::GatherDrawCalls(scene, VIEWPORT_HEIGHT, drawCalls, transforms);
+
+    results.emplace_back(Measure(modelName + " GatherDrawCalls", "draws", static_cast<double>(drawCalls.size()) * SHORT_BENCHMARK_REPEATS, iterations, [&]()
+    {
+        for(uint32_t i = 0; i < SHORT_BENCHMARK_REPEATS; ++i)
+            GeometryPipeline::GatherDrawCalls(scene, VIEWPORT_HEIGHT, drawCalls, transforms);
+    }));
+}
+
+void RunUVSphereBenchmarks(uint32_t iterations, std::vector<BenchmarkResult>& results)
+{
+    // The skydome sphere, and one dense enough to show the per vertex cost.
+    for(uint32_t resolution : { 32u, 256u })
+    {
+        MeshPrimitive sphere = GenerateUVSphere(resolution, resolution);
+        double vertices = static_cast<double>(sphere.vertices.size()) * SHORT_BENCHMARK_REPEATS;
+
+        results.emplace_back(Measure(fmt::format("GenerateUVSphere {}x{}", resolution, resolution), "vertices", vertices, iterations, [&]()
+        {
+            for(uint32_t i = 0; i < SHORT_BENCHMARK_REPEATS; ++i)
+                sphere = GenerateUVSphere(resolution, resolution);
+        }));
+    }
+}
+
+void RunPerformanceTrackerBenchmarks(uint32_t iterations, std::vector<BenchmarkResult>& results)
+{
+    PerformanceTracker tracker{};
+
+    // The passes Engine profiles, so the GPU zone histories are updated as well.
+    std::vector<GPUTiming> timings{ { "Culling", 0.1f }, { "Geometry", 2.0f }, { "Depth pyramid", 0.1f }, { "Skydome", 0.2f },
+                                    { "Lighting", 1.0f }, { "Tonemapping", 0.3f } };
+
+    results.emplace_back(Measure("PerformanceTracker::Update", "frames", TRACKER_FRAMES, iterations, [&]()
+    {
+        for(uint32_t i = 0; i < TRACKER_FRAMES; ++i)
+        {
+            tracker.SetGPUTimings(timings);
+            tracker.Update();
+        }
+    }));
+}
+
+// A slow start, like the first frames after loading, used to leave the recent average unseeded so that every later frame
+// was flagged as a hitch.
+bool CheckHitchesAfterSlowStart()
+{
+    constexpr uint32_t SLOW_FRAMES = 20;
+    constexpr uint32_t STEADY_FRAMES = 1000;
+
+    FrameStatistics statistics{};
+    for(uint32_t i = 0; i < SLOW_FRAMES; ++i)
+        statistics.Add(80.0f);
+    for(uint32_t i = 0; i < STEADY_FRAMES; ++i)
+        statistics.Add(16.0f);
+
+    if(statistics.HitchCount() != SLOW_FRAMES)
+    {
+        spdlog::error("Expected {} hitches after a slow start, got {}", SLOW_FRAMES, statistics.HitchCount());
+        return false;
+    }
+
+    return true;
+}
+
+// More strictly decreasing values than the window holds used to overwrite the oldest entry, so Max() returned the newest
+// value instead of the largest one in the window.
+bool CheckWindowMaxOfDecreasingValues()
+{
+    constexpr size_t WINDOW = 4;
+
+    SlidingWindowMax<WINDOW> windowMax{};
+    for(uint32_t i = 0; i < 8; ++i)
+    {
+        float value = 10.0f - static_cast<float>(i);
+        windowMax.Push(value);
+
+        float expected = value + static_cast<float>(std::min<size_t>(i, WINDOW - 1));
+        if(windowMax.Max() != expected)
+        {
+            spdlog::error("Expected a window maximum of {} after pushing {}, got {}", expected, value, windowMax.Max());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The HDR target formats have to keep radiance within the relative error their mantissa allows. Half floats round to 10
+// mantissa bits, glm truncates the packed format to the 5 mantissa bits of its blue channel.
+bool CheckHDRQuantizationError()
+{
+    const std::array<std::pair<vk::Format, float>, 3> bounds{ {
+        { vk::Format::eR32G32B32A32Sfloat, 0.0f },
+        { vk::Format::eR16G16B16A16Sfloat, std::exp2(-11.0f) },
+        { vk::Format::eB10G11R11UfloatPack32, std::exp2(-5.0f) },
+    } };
+
+    bool passed = true;
+    for(const auto& [format, bound] : bounds)
+    {
+        float error = MeasureHDRQuantizationError(format);
+        if(error > bound)
+        {
+            spdlog::error("Expected a relative quantization error of at most {} for {}, got {}", bound, vk::to_string(format), error);
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+bool WriteJSON(const std::filesystem::path& path, const std::vector<BenchmarkResult>& results)
+{
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed writing benchmark results to {}", path.string());
+        return false;
+    }
+
+    file << "{\n  \"results\": [";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        file << (i == 0 ? "\n" : ",\n")
+             << "    { \"name\": \"" << result.name << "\", \"unit\": \"" << result.unit << "\""
+             << ", \"items\": " << result.itemsPerIteration
+             << ", \"median_ms\": " << result.medianMilliseconds
+             << ", \"min_ms\": " << result.minMilliseconds
+             << ", \"throughput_per_second\": " << result.Throughput() << " }";
+    }
+    file << "\n  ]\n}\n";
+
+    spdlog::info("Wrote benchmark results to {}", path.string());
+    return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    std::filesystem::path modelDirectory{ "assets/models" };
+    uint32_t iterations = DEFAULT_ITERATIONS;
+    std::string jsonFile;
+    bool check = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string_view argument{ argv[i] };
+        bool hasValue = i + 1 < argc;
+        if(argument == "--models" && hasValue)
+            modelDirectory = argv[++i];
+        else if(argument == "--iterations" && hasValue)
+            iterations = std::stoul(argv[++i]);
+        else if(argument == "--json" && hasValue)
+            jsonFile = argv[++i];
+        else if(argument == "--check")
+            check = true;
+        else
+            spdlog::warn("Ignoring unknown argument {}", argument);
+    }
+
+    if(check)
+    {
+        // Runs every check, so one failure doesn't hide the others.
+        bool passed = CheckHitchesAfterSlowStart();
+        passed &= CheckWindowMaxOfDecreasingValues();
+        passed &= CheckHDRQuantizationError();
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const std::array<std::string_view, 3> models{ "Box.glb", "DamagedHelmet.glb", "ABeautifulGame/ABeautifulGame.gltf" };
+
+    std::vector<BenchmarkResult> results;
+    try
+    {
+        for(std::string_view model : models)
+            RunModelBenchmarks(modelDirectory / model, iterations, results);
+
+        RunUVSphereBenchmarks(iterations, results);
+        RunPerformanceTrackerBenchmarks(iterations, results);
+    }
+    catch(const std::exception& e)
+    {
+        spdlog::error(e.what());
+        return EXIT_FAILURE;
+    }
+
+    if(!jsonFile.empty() && !WriteJSON(jsonFile, results))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
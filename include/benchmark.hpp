@@ -0,0 +1,110 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include "frame_statistics.hpp"
+#include "performance_tracker.hpp"
+#include "cpu_profiler.hpp"
+#include "camera.hpp"
+#include <filesystem>
+#include <map>
+
+struct CameraKey
+{
+    // Seconds since the start of the path.
+    float time;
+    glm::vec3 position;
+    // Degrees, yaw around the world up axis and pitch around the camera's right axis.
+    float yaw;
+    float pitch;
+};
+
+struct BenchmarkModel
+{
+    std::string path;
+    glm::mat4 transform{ 1.0f };
+};
+
+// Parsed from a text file with one setting per line, lines starting with # are comments:
+//   warmup <frames>
+//   frames <frames>
+//   timestep <milliseconds>
+//   model <path> [x y z [scale [yaw degrees]]]
+//   key <seconds> <x> <y> <z> <yaw degrees> <pitch degrees>
+struct BenchmarkDescription
+{
+    uint32_t warmupFrames{ 60 };
+    uint32_t measuredFrames{ 600 };
+    float timestep{ 1000.0f / 60.0f };
+    std::vector<BenchmarkModel> models;
+    std::vector<CameraKey> cameraPath;
+
+    static BenchmarkDescription Load(const std::filesystem::path& path);
+};
+
+// Smooth path through camera keys, with Catmull-Rom interpolation between them. Times outside the keys are clamped.
+class CameraPath
+{
+public:
+    explicit CameraPath(std::vector<CameraKey> keys);
+
+    void Apply(float time, Camera& camera) const;
+
+    static float Yaw(const glm::quat& rotation);
+    static float Pitch(const glm::quat& rotation);
+
+private:
+    std::vector<CameraKey> _keys;
+};
+
+// Records the camera into keys that can be replayed by a benchmark.
+class CameraPathRecorder
+{
+public:
+    // A key is kept every interval seconds.
+    explicit CameraPathRecorder(float interval = 0.5f);
+
+    // Delta time in seconds.
+    void Record(float deltaTime, const Camera& camera);
+    bool Write(const std::filesystem::path& path) const;
+
+private:
+    std::vector<CameraKey> _keys;
+    float _interval;
+    float _time{ 0.0f };
+};
+
+// Replays a benchmark description at a fixed timestep. Warm-up frames hold the camera at the start of the path, so
+// texture streaming and caches settle, after which the measured frames follow the path. The frame time, the time spent
+// in the CPU zones of the main thread and the GPU passes are collected for every measured frame. The GPU timings have to
+// be read once the frame finished, so they cover exactly the measured frames.
+class Benchmark
+{
+public:
+    Benchmark(BenchmarkDescription description, std::filesystem::path source);
+
+    NON_COPYABLE(Benchmark);
+    NON_MOVABLE(Benchmark);
+
+    const BenchmarkDescription& Description() const { return _description; }
+
+    // Places the camera for the current frame.
+    void UpdateCamera(Camera& camera) const;
+    // Call once at the end of every frame. CPU zones that started after frameStart are counted for this frame, gpuTimings
+    // have to be the ones recorded by this frame.
+    void EndFrame(uint64_t frameStart, const std::vector<GPUTiming>& gpuTimings);
+    bool Finished() const { return _frame >= _description.warmupFrames + _description.measuredFrames; }
+
+    bool WriteReport(const std::filesystem::path& path, glm::uvec2 resolution) const;
+
+private:
+    BenchmarkDescription _description;
+    std::filesystem::path _source;
+    CameraPath _cameraPath;
+    uint32_t _frame{ 0 };
+
+    FrameStatistics _frameTimes;
+    std::map<std::string, FrameStatistics, std::less<>> _cpuZones;
+    std::map<std::string, FrameStatistics, std::less<>> _gpuPasses;
+    std::vector<ProfileEvent> _events;
+    std::map<std::string_view, float> _zoneTotals;
+};
@@ -26,8 +26,7 @@ struct CameraUBO
 struct CameraStructure
 {
     vk::DescriptorSetLayout descriptorSetLayout;
+    // Point at the frame allocator buffers, the camera data is picked with a dynamic offset.
     std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets;
-    std::array<vk::Buffer, MAX_FRAMES_IN_FLIGHT> buffers;
-    std::array<VmaAllocation, MAX_FRAMES_IN_FLIGHT> allocations;
-    std::array<void*, MAX_FRAMES_IN_FLIGHT> mappedPtrs;
+    std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> offsets;
 };
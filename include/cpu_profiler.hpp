@@ -0,0 +1,104 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Zones kept per thread, older ones are overwritten.
+constexpr size_t CPU_PROFILER_EVENTS_PER_THREAD = 16384;
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// Measures the rest of the enclosing scope. The name isn't copied, so it should be a string literal.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__){ name }
+
+struct ProfileEvent
+{
+    std::string_view name;
+    // Nanoseconds on the steady clock.
+    uint64_t begin;
+    uint64_t end;
+    uint32_t threadId;
+};
+
+// Collects the zones measured by PROFILE_ZONE. Every thread writes into its own ring buffer, so recording a zone never
+// takes a lock. Buffers of threads that exited are handed to new threads, which keeps the memory bounded when worker
+// threads come and go, like the ones started by util::ParallelFor.
+//
+// Exporting reads the buffers while other threads may still write, so it should happen when workers are idle, like at
+// a frame boundary on the main thread.
+class CPUProfiler
+{
+public:
+    static CPUProfiler& Instance();
+
+    NON_COPYABLE(CPUProfiler);
+    NON_MOVABLE(CPUProfiler);
+
+    static uint64_t Now();
+
+    void Record(std::string_view name, uint64_t begin, uint64_t end);
+    // Appends the zones of all threads that began at or after the given time, newest first per thread. Only walks the
+    // recent part of each buffer, so it's cheap enough to call every frame.
+    void CollectEvents(uint64_t since, std::vector<ProfileEvent>& events) const;
+
+    // Writes the zones of all threads as Chrome trace events, which Perfetto and chrome://tracing can open. GPU zones are
+    // shown as a separate process on the same timeline.
+    bool ExportChromeTrace(const std::filesystem::path& path, std::span<const ProfileEvent> gpuEvents) const;
+
+    // Writes the text as the contents of a JSON string, without the surrounding quotes.
+    static void WriteEscaped(std::ostream& stream, std::string_view text);
+
+private:
+    struct ThreadBuffer
+    {
+        std::vector<ProfileEvent> events = std::vector<ProfileEvent>(CPU_PROFILER_EVENTS_PER_THREAD);
+        std::atomic<uint64_t> head{ 0 };
+        std::atomic<bool> inUse{ true };
+        uint32_t threadId;
+    };
+
+    // Gives the buffer back when its thread exits.
+    struct ThreadBufferOwner
+    {
+        ThreadBuffer* buffer{ nullptr };
+        ~ThreadBufferOwner();
+    };
+
+    CPUProfiler() = default;
+
+    ThreadBuffer& AcquireThreadBuffer();
+
+    mutable std::mutex _buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+    uint32_t _nextThreadId{ 0 };
+};
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(std::string_view name) :
+        _name(name),
+        _begin(CPUProfiler::Now())
+    {
+    }
+
+    ~ProfileZone()
+    {
+        CPUProfiler::Instance().Record(_name, _begin, CPUProfiler::Now());
+    }
+
+    NON_COPYABLE(ProfileZone);
+    NON_MOVABLE(ProfileZone);
+
+private:
+    std::string_view _name;
+    uint64_t _begin;
+};
@@ -7,10 +7,14 @@
 #include "mesh.hpp"
 #include "include.hpp"
 #include "camera.hpp"
-#include "hdr_target.hpp"
+#include "model_loader.hpp"
+#include "single_time_commands.hpp"
+#include "startup_timeline.hpp"
+#include <future>
 
 class Application;
 class GeometryPipeline;
+class CullingPipeline;
 class LightingPipeline;
 class SkydomePipeline;
 class TonemappingPipeline;
@@ -19,6 +23,14 @@ class SwapChain;
 class GBuffers;
 class VulkanBrain;
 class ModelLoader;
+class TextureStreamer;
+class MemoryManager;
+class FrameAllocator;
+class GPUProfiler;
+class PipelineCompiler;
+class ShaderWatcher;
+class Benchmark;
+class CameraPathRecorder;
 
 class Engine
 {
@@ -33,15 +45,26 @@ public:
     void Quit() { _shouldQuit = true; };
 
 private:
+    // Created first, so creating the device is part of the timeline.
+    StartupTimeline _startupTimeline;
     const VulkanBrain _brain;
     vk::DescriptorSetLayout _materialDescriptorSetLayout;
     std::array<vk::CommandBuffer, MAX_FRAMES_IN_FLIGHT> _commandBuffers;
-
+    std::unique_ptr<FrameAllocator> _frameAllocator;
+    std::unique_ptr<GPUProfiler> _gpuProfiler;
+    // Declared before the pipelines, so it outlives the pipelines it's still compiling.
+    std::unique_ptr<PipelineCompiler> _pipelineCompiler;
+    // Only created for windowed runs of builds that can compile GLSL.
+    std::unique_ptr<ShaderWatcher> _shaderWatcher;
+
+    std::unique_ptr<CullingPipeline> _cullingPipeline;
     std::unique_ptr<GeometryPipeline> _geometryPipeline;
     std::unique_ptr<LightingPipeline> _lightingPipeline;
     std::unique_ptr<SkydomePipeline> _skydomePipeline;
     std::unique_ptr<TonemappingPipeline> _tonemappingPipeline;
     std::unique_ptr<IBLPipeline> _iblPipeline;
+    std::unique_ptr<MemoryManager> _memoryManager;
+    std::unique_ptr<TextureStreamer> _textureStreamer;
     std::unique_ptr<ModelLoader> _modelLoader;
 
     SceneDescription _scene;
@@ -54,8 +77,6 @@ private:
     std::array<vk::Semaphore, MAX_FRAMES_IN_FLIGHT> _renderFinishedSemaphores;
     std::array<vk::Fence, MAX_FRAMES_IN_FLIGHT> _inFlightFences;
 
-    HDRTarget _hdrTarget;
-
     CameraStructure _cameraStructure;
 
     std::shared_ptr<Application> _application;
@@ -67,15 +88,52 @@ private:
 
     PerformanceTracker _performanceTracker;
 
+    // Headless only, frames are written here when it isn't empty.
+    std::filesystem::path _frameDumpDirectory;
+    uint32_t _dumpedFrameCount{ 0 };
+
+    // Written with the P key, and at exit when a trace file was passed in.
+    std::filesystem::path _traceFile;
+    bool _exportTraceOnExit{ false };
+    std::filesystem::path _statisticsFile;
+
+    std::unique_ptr<Benchmark> _benchmark;
+    std::filesystem::path _benchmarkReport;
+    std::unique_ptr<CameraPathRecorder> _cameraRecorder;
+    std::filesystem::path _recordPathFile;
+
+    // Started by the constructor and picked up at frame boundaries by UpdateStartup, while a loading screen is shown.
+    struct PendingModel
+    {
+        std::string path;
+        std::future<ProcessedModel> processed;
+        std::vector<glm::mat4> instances;
+    };
+    std::future<StagedImage> _pendingEnvironmentMap;
+    std::vector<PendingModel> _pendingModels;
+    bool _firstFramePresented{ false };
+    // Every pipeline compiled and the IBL maps precomputed.
+    bool _rendererReady{ false };
+    bool _startupComplete{ false };
+    std::filesystem::path _startupReportFile;
+
     bool _shouldQuit = false;
 
     void CreateDescriptorSetLayout();
     void CreateCommandBuffers();
     void RecordCommandBuffer(const vk::CommandBuffer& commandBuffer, uint32_t swapChainImageIndex);
+    void RecordSceneCommands(vk::CommandBuffer commandBuffer, uint32_t swapChainImageIndex);
+    void RecordLoadingCommands(vk::CommandBuffer commandBuffer, uint32_t swapChainImageIndex) const;
     void CreateSyncObjects();
+    void ExportTrace() const;
+    void LoadScene();
+    void UpdateStartup();
+    bool AdvanceStartup(bool wait);
+    bool RendererReady() const { return _rendererReady; }
+    void Resize();
+    void UpdateCameraFromInput(float deltaTimeMS, glm::ivec2 mousePos);
     void InitializeCameraUBODescriptors();
     void UpdateCameraDescriptorSet(uint32_t currentFrame);
     CameraUBO CalculateCamera(const Camera& camera);
-    void InitializeHDRTarget();
-    void LoadEnvironmentMap();
+    void CreateEnvironmentPipelines(const StagedImage& environmentMap);
 };
@@ -2,13 +2,38 @@
 
 #include <cstdint>
 #include <functional>
+#include <string>
 #include <vulkan/vulkan.hpp>
 
+enum class HDRPrecision
+{
+    // RGBA16F, 8 bytes per pixel.
+    eHalf,
+    // B10G11R11 unsigned floats, 4 bytes per pixel, less precision and no alpha.
+    ePacked
+};
+
 struct InitInfo
 {
     uint32_t extensionCount{ 0 };
     const char* const* extensions{ nullptr };
     uint32_t width, height;
+    HDRPrecision hdrPrecision{ HDRPrecision::eHalf };
+    // Renders into offscreen images instead of a swap chain, retrieveSurface isn't used.
+    bool headless{ false };
+    // Headless only, every rendered frame is written to this directory when it isn't empty.
+    std::string frameDumpDirectory;
+    // Captured CPU and GPU zones are written here at exit when it isn't empty.
+    std::string traceFile;
+    // Frame time statistics are written to this path with .csv and .json extensions at exit when it isn't empty.
+    std::string statisticsFile;
+    // Replays this benchmark description instead of the default scene when it isn't empty, and quits when it's done.
+    std::string benchmarkFile;
+    std::string benchmarkReport{ "benchmark_report.json" };
+    // The camera is recorded into a path that benchmarks can replay and written here at exit when it isn't empty.
+    std::string recordPathFile;
+    // How long each stage of starting up took is written here once everything is loaded when it isn't empty.
+    std::string startupReportFile;
 
     std::function<vk::SurfaceKHR(vk::Instance)> retrieveSurface;
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include "include.hpp"
+
+class VulkanBrain;
+
+// Transient memory available to a single frame, shared by all passes.
+constexpr vk::DeviceSize FRAME_ALLOCATOR_SIZE = 4 * 1024 * 1024;
+
+struct FrameAllocation
+{
+    vk::Buffer buffer;
+    vk::DeviceSize offset;
+    void* mapped;
+};
+
+// Linear allocator for data that only lives for one frame, like uniform and storage buffer contents written by the CPU.
+// Every frame in flight owns a persistently mapped buffer, preferably in device local memory that is host visible
+// (resizable BAR), so shaders read it from VRAM. Allocating bumps an offset and the whole buffer is reset at once after
+// the fence of its frame signaled.
+//
+// The buffers never change, so descriptor sets can point at them once and pick their allocation with dynamic offsets.
+class FrameAllocator
+{
+public:
+    explicit FrameAllocator(const VulkanBrain& brain);
+    ~FrameAllocator();
+
+    NON_COPYABLE(FrameAllocator);
+    NON_MOVABLE(FrameAllocator);
+
+    // Call after waiting on the frame's fence, invalidates every allocation made for that frame before.
+    void Reset(uint32_t currentFrame);
+    // Alignment satisfies both uniform and storage buffer offsets, so allocations can be bound as either.
+    FrameAllocation Allocate(uint32_t currentFrame, vk::DeviceSize size);
+
+    template <typename T>
+    T* Allocate(uint32_t currentFrame, size_t count, vk::DeviceSize& offset)
+    {
+        FrameAllocation allocation = Allocate(currentFrame, sizeof(T) * count);
+        offset = allocation.offset;
+        return static_cast<T*>(allocation.mapped);
+    }
+
+    vk::Buffer Buffer(uint32_t currentFrame) const { return _frames[currentFrame].buffer; }
+    vk::DeviceSize Alignment() const { return _alignment; }
+    vk::DeviceSize UsedBytes(uint32_t currentFrame) const { return _frames[currentFrame].offset; }
+    bool DeviceLocal() const { return _deviceLocal; }
+
+private:
+    struct Frame
+    {
+        vk::Buffer buffer;
+        VmaAllocation allocation;
+        std::byte* mapped;
+        vk::DeviceSize offset{ 0 };
+    };
+
+    const VulkanBrain& _brain;
+
+    std::array<Frame, MAX_FRAMES_IN_FLIGHT> _frames;
+    vk::DeviceSize _alignment;
+    bool _deviceLocal{ false };
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ring_buffer.hpp"
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+// Frame durations are binned on a log scale between these bounds, in milliseconds. Percentiles are accurate to the
+// width of a bin, about 1.4% of the value.
+constexpr float FRAME_HISTOGRAM_MIN = 0.01f;
+constexpr float FRAME_HISTOGRAM_MAX = 10000.0f;
+constexpr uint32_t FRAME_HISTOGRAM_BINS = 1024;
+// Most recent hitches kept for inspection and export.
+constexpr size_t MAX_RECORDED_HITCHES = 64;
+
+struct HitchThresholds
+{
+    // Frames taking longer than this in milliseconds are always hitches.
+    float absolute{ 50.0f };
+    // Frames taking longer than this multiple of the recent average are hitches.
+    float relative{ 2.5f };
+};
+
+struct Hitch
+{
+    uint64_t frame;
+    float duration;
+    // Recent average the frame was compared against.
+    float expected;
+};
+
+// Streaming statistics over every frame duration it was given, each frame is added in constant time and memory. The
+// percentiles come from a log scale histogram, the mean and deviation from Welford's algorithm.
+class FrameStatistics
+{
+public:
+    void Add(float frameDuration);
+    void Reset();
+
+    // Percentile between 0 and 1, like 0.99 for P99.
+    float Percentile(float percentile) const;
+    float Mean() const { return static_cast<float>(_mean); }
+    float StandardDeviation() const;
+    // Mean absolute difference between consecutive frames, how uneven the pacing is regardless of the frame rate.
+    float Jitter() const;
+    float Min() const { return _count > 0 ? _min : 0.0f; }
+    float Max() const { return _max; }
+    uint64_t Count() const { return _count; }
+
+    void SetHitchThresholds(const HitchThresholds& thresholds) { _hitchThresholds = thresholds; }
+    const HitchThresholds& GetHitchThresholds() const { return _hitchThresholds; }
+    uint64_t HitchCount() const { return _hitchCount; }
+    const RingBuffer<Hitch, MAX_RECORDED_HITCHES>& RecentHitches() const { return _recentHitches; }
+
+    // Writes the summary as a single line JSON object.
+    void WriteJSON(std::ostream& stream) const;
+
+private:
+    static uint32_t Bin(float frameDuration);
+    static float BinCenter(uint32_t bin);
+
+    std::array<uint64_t, FRAME_HISTOGRAM_BINS> _histogram{};
+    uint64_t _count{ 0 };
+    double _mean{ 0.0 };
+    double _m2{ 0.0 };
+    double _jitterSum{ 0.0 };
+    float _previous{ 0.0f };
+    float _min{ FRAME_HISTOGRAM_MAX };
+    float _max{ 0.0f };
+
+    HitchThresholds _hitchThresholds;
+    // Exponential moving average of frames that weren't hitches.
+    float _recentAverage{ 0.0f };
+    uint64_t _hitchCount{ 0 };
+    RingBuffer<Hitch, MAX_RECORDED_HITCHES> _recentHitches;
+};
@@ -8,18 +8,27 @@
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 #include "include.hpp"
+#include "hdr_target.hpp"
 
+// Owns the screen sized render targets. Depth is only used by the geometry passes and the HDR target only by the passes
+// after them, so the two share memory when the device allows it. None of the targets keep their contents between frames,
+// every frame transitions them from an undefined layout, which means resizing doesn't have to record any commands.
 class GBuffers
 {
 public:
-    GBuffers(const VulkanBrain& brain, glm::uvec2 size);
+    GBuffers(const VulkanBrain& brain, glm::uvec2 size, HDRPrecision hdrPrecision = HDRPrecision::eHalf);
     ~GBuffers();
 
     NON_MOVABLE(GBuffers);
     NON_COPYABLE(GBuffers);
 
+    // The caller has to make sure the GPU isn't using the old targets anymore.
     void Resize(glm::uvec2 size);
 
+    // Layout transitions from undefined that also wait for the last use of the memory aliasing the target.
+    void RecordBeginDepthCommands(vk::CommandBuffer commandBuffer) const;
+    void RecordBeginHDRCommands(vk::CommandBuffer commandBuffer) const;
+
     vk::Image GBuffersImageArray() const { return _gBuffersImageArray; }
     VmaAllocation GBufferAllocation() const { return _gBufferAllocation; }
     const std::array<vk::ImageView, DEFERRED_ATTACHMENT_COUNT>& GBufferViews() const  { return _gBufferViews; }
@@ -30,6 +39,9 @@ public:
     vk::ImageView DepthImageView() const { return _depthImageView; }
     const vk::Rect2D& Scissor() const { return _scissor; }
     const vk::Viewport& Viewport() const { return _viewport; }
+    const HDRTarget& HDR() const { return _hdrTarget; }
+    bool DepthAliasesHDR() const { return _depthAliasesHDR; }
+    float HDRQuantizationError() const { return _hdrQuantizationError; }
 
     static vk::Format GBufferFormat() { return vk::Format::eR16G16B16A16Sfloat; }
 
@@ -42,10 +54,16 @@ private:
     std::array<vk::ImageView, DEFERRED_ATTACHMENT_COUNT> _gBufferViews;
 
     vk::Image _depthImage;
-    VmaAllocation _depthImageAllocation;
     vk::ImageView _depthImageView;
     vk::Format _depthFormat;
 
+    HDRTarget _hdrTarget;
+    float _hdrQuantizationError;
+
+    // Holds both depth and the HDR target when they alias, otherwise only depth and the HDR target has its own.
+    VmaAllocation _depthAllocation;
+    bool _depthAliasesHDR{ false };
+
     vk::Viewport _viewport;
     vk::Rect2D _scissor;
 
@@ -55,7 +73,7 @@ private:
     };
 
     void CreateGBuffers();
-    void CreateDepthResources();
+    void CreateDepthAndHDRTarget();
     void CreateViewportAndScissor();
     void CleanUp();
 };
\ No newline at end of file
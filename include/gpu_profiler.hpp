@@ -0,0 +1,69 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include "include.hpp"
+#include "performance_tracker.hpp"
+#include "cpu_profiler.hpp"
+#include <string_view>
+
+class VulkanBrain;
+
+// Upper bound on the zones recorded in a single frame, every zone takes two queries.
+constexpr uint32_t MAX_GPU_ZONES = 32;
+// Zones kept for trace exports, older ones are overwritten.
+constexpr size_t MAX_GPU_PROFILE_EVENTS = 8192;
+
+// Measures how long passes take on the GPU. Zones are bracketed with timestamp queries in a query pool per frame in
+// flight, whose results are read after waiting on the fence of that frame, so reading never stalls. Zones sharing a
+// name are added together, which lets the early and late parts of a pass show up as one entry.
+class GPUProfiler
+{
+public:
+    explicit GPUProfiler(const VulkanBrain& brain);
+    ~GPUProfiler();
+
+    NON_COPYABLE(GPUProfiler);
+    NON_MOVABLE(GPUProfiler);
+
+    // Call once the frame's submission finished, after waiting on its fence or the device. Reads the timings recorded the
+    // last time this frame was submitted.
+    void Update(uint32_t currentFrame);
+    // Resets the frame's queries, has to be recorded before any zone.
+    void RecordBeginFrame(vk::CommandBuffer commandBuffer, uint32_t currentFrame);
+    // The name isn't copied, it has to stay alive until the frame's timings are read, which string literals do.
+    void RecordBeginZone(vk::CommandBuffer commandBuffer, uint32_t currentFrame, std::string_view name);
+    // Ends the most recently begun zone that is still open.
+    void RecordEndZone(vk::CommandBuffer commandBuffer, uint32_t currentFrame);
+    // Call right after submitting the frame, anchors its zones on the CPU timeline.
+    void MarkSubmitted(uint32_t currentFrame);
+
+    // Timings of the last frame read by Update, in the order the zones were first begun.
+    const std::vector<GPUTiming>& Timings() const { return _timings; }
+    bool Supported() const { return _supported; }
+    // Recent zones on the steady clock timeline of the CPU profiler, not in chronological order. There's no clock
+    // calibration between the devices, the first zone of a frame is placed at its submission. Durations and the order
+    // within a frame are exact, the offset to the CPU zones is an approximation.
+    std::span<const ProfileEvent> Events() const { return _events; }
+
+private:
+    struct Frame
+    {
+        vk::QueryPool queryPool;
+        std::vector<std::string_view> zoneNames;
+        std::vector<uint32_t> openZones;
+        uint64_t submitTime{ 0 };
+        // Nothing is read until the queries were written at least once.
+        bool recorded{ false };
+    };
+
+    const VulkanBrain& _brain;
+
+    std::array<Frame, MAX_FRAMES_IN_FLIGHT> _frames;
+    std::vector<GPUTiming> _timings;
+    std::vector<ProfileEvent> _events;
+    size_t _nextEvent{ 0 };
+    // Nanoseconds per timestamp tick.
+    float _timestampPeriod;
+    uint64_t _timestampMask;
+    bool _supported;
+};
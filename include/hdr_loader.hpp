@@ -0,0 +1,37 @@
+#pragma once
+
+#include "include.hpp"
+#include <fstream>
+
+// Reads Radiance .hdr files one scanline at a time, so the full image never has to be decoded in memory at once.
+class HDRReader
+{
+public:
+    explicit HDRReader(std::string_view path);
+
+    uint32_t Width() const { return _width; }
+    uint32_t Height() const { return _height; }
+
+    // Decodes the next scanline as RGBA16F into destination, which has to hold Width() * 4 halves.
+    void ReadScanline(uint16_t* destination);
+
+    NON_MOVABLE(HDRReader);
+    NON_COPYABLE(HDRReader);
+
+private:
+    void ReadHeader();
+    void ReadFlatScanline();
+    void ReadRunLengthScanline();
+    uint8_t ReadByte();
+
+    std::ifstream _file;
+    std::vector<char> _fileBuffer;
+    uint32_t _width{ 0 };
+    uint32_t _height{ 0 };
+
+    // Planar red, green, blue and exponent channels of the current scanline.
+    std::array<std::vector<uint8_t>, 4> _channels;
+};
+
+// Converts planar RGBE pixels to interleaved RGBA16F with an alpha of one, clamping to the largest finite half.
+void RGBEToHalf(const std::array<const uint8_t*, 4>& channels, uint16_t* destination, size_t pixelCount);
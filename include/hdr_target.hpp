@@ -8,4 +8,9 @@ struct HDRTarget
     vk::Image images;
     vk::ImageView imageViews;
     VmaAllocation allocations;
-};
\ No newline at end of file
+};
+
+// Picks the format for the requested precision, falls back to wider formats when the device can't render to and sample it.
+vk::Format SelectHDRFormat(vk::PhysicalDevice physicalDevice, HDRPrecision precision);
+// Largest relative error per channel after storing radiance between 0.001 and 60000 in the format.
+float MeasureHDRQuantizationError(vk::Format format);
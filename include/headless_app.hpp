@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include "application.hpp"
+#include "class_decorations.hpp"
+
+// Runs the engine without a window, rendering into offscreen images. Meant for automated runs on machines without a
+// display, like CI with a software rasterizer. There is no input, the engine only sees an idle mouse and keyboard.
+class HeadlessApp : public Application
+{
+public:
+    // A frame count of 0 keeps running until the update loop asks to quit.
+    HeadlessApp(const CreateParameters& parameters, glm::uvec2 size, uint32_t frameCount);
+    ~HeadlessApp() override;
+
+    NON_COPYABLE(HeadlessApp);
+    NON_MOVABLE(HeadlessApp);
+
+    InitInfo GetInitInfo() override;
+    glm::uvec2 DisplaySize() override;
+    bool IsMinimized() override;
+    void Run(std::function<bool()> updateLoop) override;
+    void InitImGui() override;
+    void NewImGuiFrame() override;
+    void ShutdownImGui() override;
+    void SetMouseHidden(bool state) override;
+
+    const InputManager& GetInputManager() const override;
+
+private:
+    InitInfo _initInfo;
+    class InputManager _inputManager;
+
+    uint32_t _frameCount;
+    std::chrono::time_point<std::chrono::high_resolution_clock> _lastFrameTime;
+};
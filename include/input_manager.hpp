@@ -12,6 +12,7 @@ public:
         D = SDL_SCANCODE_D,
         Space = SDL_SCANCODE_SPACE,
         Escape = SDL_SCANCODE_ESCAPE,
+        P = SDL_SCANCODE_P,
         // Add other keys as needed
     };
 
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+// Read only view of a whole file, backed by the page cache instead of a heap copy.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    std::span<const std::byte> Data() const { return { _data, _size }; }
+
+    NON_COPYABLE(MappedFile);
+    NON_MOVABLE(MappedFile);
+
+private:
+    const std::byte* _data{ nullptr };
+    size_t _size{ 0 };
+
+#if defined(WINDOWS)
+    void* _file{ nullptr };
+    void* _mapping{ nullptr };
+#else
+    int _fileDescriptor{ -1 };
+#endif
+};
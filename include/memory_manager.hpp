@@ -0,0 +1,73 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include "include.hpp"
+#include "performance_tracker.hpp"
+#include <string_view>
+
+class VulkanBrain;
+
+// Device memory use above this fraction of the budget counts as memory pressure.
+constexpr float MEMORY_PRESSURE_THRESHOLD = 0.9f;
+// Frames to wait after firing the pressure callbacks, so evictions can take effect before checking again.
+constexpr uint32_t MEMORY_PRESSURE_COOLDOWN_FRAMES = 30;
+
+enum class MemoryCategory
+{
+    eTextures,
+    eMeshes,
+    eRenderTargets,
+    eStaging,
+    eOther,
+    eCount
+};
+
+// Tracks device memory usage against the heap budgets reported by VMA. Usage is split in categories based on the
+// allocation names, kept as running totals by the allocation helpers in util. Callbacks are fired when the device local
+// heaps come close to their budget, so systems holding optional memory can give some of it back before allocations start
+// failing.
+class MemoryManager
+{
+public:
+    // Receives the amount of bytes that should be freed to get back under the pressure threshold.
+    using PressureCallback = std::function<void(vk::DeviceSize bytesToFree)>;
+
+    explicit MemoryManager(const VulkanBrain& brain);
+
+    NON_COPYABLE(MemoryManager);
+    NON_MOVABLE(MemoryManager);
+
+    // Call once per frame.
+    void Update();
+    void AddPressureCallback(PressureCallback callback);
+
+    // Budget of all device local heaps together, optionally lowered by the override.
+    vk::DeviceSize DeviceBudget() const;
+    vk::DeviceSize DeviceUsage() const { return _deviceUsage; }
+    static vk::DeviceSize CategoryUsage(MemoryCategory category);
+    // Pretends the device has less memory than it does, 0 disables the override.
+    void SetBudgetOverride(vk::DeviceSize budget) { _budgetOverride = budget; }
+    vk::DeviceSize BudgetOverride() const { return _budgetOverride; }
+
+    MemoryStatistics Statistics() const;
+
+    static MemoryCategory Categorize(std::string_view allocationName);
+    static std::string_view CategoryName(MemoryCategory category);
+
+    // Names a new allocation and adds its size to the category of that name. The category is stored in the allocation's
+    // user data, so UntrackAllocation can remove it again without looking at the name.
+    static void TrackAllocation(VmaAllocator allocator, VmaAllocation allocation, std::string_view name);
+    // Call before freeing an allocation, allocations that were never tracked are ignored.
+    static void UntrackAllocation(VmaAllocator allocator, VmaAllocation allocation);
+
+private:
+    const VulkanBrain& _brain;
+
+    std::vector<PressureCallback> _pressureCallbacks;
+    vk::DeviceSize _deviceUsage{ 0 };
+    vk::DeviceSize _deviceBudget{ 0 };
+    vk::DeviceSize _budgetOverride{ 0 };
+
+    uint32_t _frameIndex{ 0 };
+    uint32_t _lastPressureFrame{ 0 };
+};
@@ -7,6 +7,7 @@
 #include "camera.hpp"
 #include <memory>
 #include <optional>
+#include <limits>
 #include <glm/gtc/quaternion.hpp>
 
 struct Vertex
@@ -27,6 +28,47 @@ struct Vertex
 
     static vk::VertexInputBindingDescription GetBindingDescription();
     static std::array<vk::VertexInputAttributeDescription, 5> GetAttributeDescriptions();
+    // Layout of the separate position stream, used by depth only passes.
+    static vk::VertexInputBindingDescription GetPositionBindingDescription();
+    static vk::VertexInputAttributeDescription GetPositionAttributeDescription();
+};
+
+struct BoundingBox
+{
+    glm::vec3 min{ std::numeric_limits<float>::max() };
+    glm::vec3 max{ std::numeric_limits<float>::lowest() };
+};
+
+constexpr uint32_t MAX_LOD_COUNT = 4;
+
+struct MeshLOD
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    // Object space distance the simplified surface deviates from the original.
+    float error;
+};
+
+constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+// Matches the std430 layout of the meshlet buffer in the task and mesh shaders.
+struct Meshlet
+{
+    glm::vec3 center;
+    float radius;
+
+    // Every triangle faces away from the camera when it looks at the apex from within the cutoff angle around the axis.
+    glm::vec3 coneApex;
+    float coneCutoff;
+    glm::vec3 coneAxis;
+    uint32_t vertexOffset;
+
+    // Byte offset into the packed triangle indices.
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    uint32_t _padding;
 };
 
 struct MeshPrimitive
@@ -36,6 +78,13 @@ struct MeshPrimitive
     vk::IndexType indexType;
     std::vector<std::byte> indicesBytes;
     std::vector<Vertex> vertices;
+    // Index ranges into indicesBytes, empty when no LODs were generated.
+    std::vector<MeshLOD> lods;
+
+    // Clusters of the full detail LOD, empty when no meshlets were built.
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint8_t> meshletTriangles;
 
     std::optional<uint32_t> materialIndex;
 };
@@ -49,6 +98,8 @@ struct Texture
 {
     uint32_t width, height, numChannels;
     std::vector<std::byte> data;
+    // Smaller mips for texture streaming, level 1 first. Left empty when the texture isn't streamed.
+    std::vector<std::vector<std::byte>> mips;
     bool isHDR = false;
     vk::Format format = vk::Format::eR8G8B8A8Unorm;
     vk::Format GetFormat() const
@@ -106,6 +157,9 @@ struct Material
     uint32_t emissiveUVChannel;
 };
 
+// Marks textures that aren't streamed, their images always contain all mips.
+constexpr uint32_t NO_STREAM_INDEX = std::numeric_limits<uint32_t>::max();
+
 struct TextureHandle
 {
     std::string name;
@@ -114,6 +168,7 @@ struct TextureHandle
     vk::ImageView imageView;
     uint32_t width, height;
     vk::Format format;
+    uint32_t streamIndex{ NO_STREAM_INDEX };
 };
 
 struct MaterialHandle
@@ -135,10 +190,24 @@ struct MaterialHandle
         int32_t useNormalMap{false};
         int32_t useOcclusionMap{false};
         float _padding1;
+
+        // Where the geometry pass reports the mips it needs, see TextureStreamer.
+        uint32_t albedoStreamIndex{ NO_STREAM_INDEX };
+        uint32_t mrStreamIndex{ NO_STREAM_INDEX };
+        uint32_t normalStreamIndex{ NO_STREAM_INDEX };
+        uint32_t occlusionStreamIndex{ NO_STREAM_INDEX };
+
+        uint32_t emissiveStreamIndex{ NO_STREAM_INDEX };
+        float _padding2{ 0.0f };
+        float _padding3{ 0.0f };
+        float _padding4{ 0.0f };
     };
 
     const static uint32_t TEXTURE_COUNT = 5;
 
+    // Bit i is set when the material samples textures[i]. Selects the geometry pipeline variant, see GeometryPipeline.
+    uint32_t featureMask{ 0 };
+
     vk::DescriptorSet descriptorSet;
     vk::Buffer materialUniformBuffer;
     VmaAllocation materialUniformAllocation;
@@ -176,12 +245,25 @@ struct MeshPrimitiveHandle
     vk::PrimitiveTopology topology;
     vk::IndexType indexType;
     uint32_t indexCount;
+    BoundingBox boundingBox;
+    // Always contains at least the full detail range.
+    std::vector<MeshLOD> lods;
 
     vk::Buffer vertexBuffer;
+    vk::Buffer positionBuffer;
     vk::Buffer indexBuffer;
     VmaAllocation vertexBufferAllocation;
+    VmaAllocation positionBufferAllocation;
     VmaAllocation indexBufferAllocation;
 
+    uint32_t meshletCount{ 0 };
+    vk::Buffer meshletBuffer;
+    vk::Buffer meshletVertexBuffer;
+    vk::Buffer meshletTriangleBuffer;
+    VmaAllocation meshletBufferAllocation{ nullptr };
+    VmaAllocation meshletVertexBufferAllocation{ nullptr };
+    VmaAllocation meshletTriangleBufferAllocation{ nullptr };
+
     std::shared_ptr<MaterialHandle> material;
 };
 
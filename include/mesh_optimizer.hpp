@@ -0,0 +1,38 @@
+#pragma once
+
+#include "include.hpp"
+#include "mesh.hpp"
+
+struct VertexCacheStatistics
+{
+    size_t transformedVertices{ 0 };
+    size_t triangleCount{ 0 };
+    size_t vertexCount{ 0 };
+
+    // Average cache miss ratio, vertex shader invocations per triangle. 0.5 is the best case for large grids, 3.0 the worst.
+    float ACMR() const { return triangleCount > 0 ? static_cast<float>(transformedVertices) / triangleCount : 0.0f; }
+    // Average transformed vertex ratio, vertex shader invocations per vertex. 1.0 is optimal.
+    float ATVR() const { return vertexCount > 0 ? static_cast<float>(transformedVertices) / vertexCount : 0.0f; }
+
+    VertexCacheStatistics& operator+=(const VertexCacheStatistics& other);
+};
+
+// Simulates a FIFO post-transform cache over the index buffer.
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Tipsify triangle reordering for post-transform cache locality. Writes the first triangle of every cluster
+// that starts after a cache flush to clusters, which are the points where overdraw sorting is free to reorder.
+std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize = 16);
+
+// Sorts the clusters so the ones facing away from the mesh center are drawn first, they are likely to occlude the rest.
+std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters);
+
+// Reorders vertices by first use in the index buffer and drops unreferenced ones.
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs all of the above on every LOD of the primitive, statistics are gathered for the full detail LOD.
+void OptimizeMesh(MeshPrimitive& primitive, VertexCacheStatistics& before, VertexCacheStatistics& after);
+
+// Greedily splits the full detail LOD into meshlets of at most MAX_MESHLET_VERTICES vertices and MAX_MESHLET_TRIANGLES triangles,
+// following the index order, so it should run after the other optimizations. Computes bounding spheres and normal cones for culling.
+void BuildMeshlets(MeshPrimitive& primitive);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "include.hpp"
+#include "mesh.hpp"
+
+// Quadric error edge-collapse simplification. Vertices only collapse onto existing vertices,
+// so the result still indexes the original vertex buffer. Vertices on borders and UV/normal seams are kept in place.
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error);
+
+// Appends a chain of simplified index ranges to the primitive's index buffer and fills in its LODs.
+void GenerateLODs(MeshPrimitive& primitive);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "include.hpp"
+#include "mesh.hpp"
+
+// Generates per vertex tangents following MikkTSpace: per triangle UV derivatives are projected onto the tangent plane
+// of each corner and weighted by the corner angle, the sign in w gives the bitangent handedness. Triangles are processed
+// in parallel chunks. Vertices aren't split where handedness changes, they get the sign of the dominant side instead.
+void CalculateTangents(MeshPrimitive& primitive);
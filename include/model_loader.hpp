@@ -3,42 +3,94 @@
 #include "class_decorations.hpp"
 #include "include.hpp"
 #include "mesh.hpp"
+#include "resource_cache.hpp"
+#include "mapped_file.hpp"
 #include <string>
 #include <fastgltf/core.hpp>
 
 class SingleTimeCommands;
+class TextureStreamer;
+
+// The CPU side of loading a model, waiting for ModelLoader::Upload. The glTF file and its external buffers and images stay
+// mapped until then.
+struct ProcessedModel
+{
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+    using File = fastgltf::MappedGltfFile;
+#else
+    using File = fastgltf::GltfDataBuffer;
+#endif
+
+    std::string path;
+    std::unique_ptr<File> file;
+    std::vector<std::unique_ptr<MappedFile>> mappedFiles;
+    std::unique_ptr<fastgltf::Asset> gltf;
+
+    std::vector<Mesh> meshes;
+    // Images that weren't decoded are left empty, Upload finds them in the resource cache.
+    std::vector<Texture> textures;
+    std::vector<uint64_t> imageKeys;
+    std::vector<Material> materials;
+};
 
 class ModelLoader
 {
 public:
-    ModelLoader(const VulkanBrain& brain, vk::DescriptorSetLayout materialDescriptorSetLayout);
+    // Textures are created through the streamer when one is given, otherwise they're fully resident.
+    ModelLoader(const VulkanBrain& brain, vk::DescriptorSetLayout materialDescriptorSetLayout, TextureStreamer* textureStreamer = nullptr, bool optimizeMeshes = true);
     ~ModelLoader();
 
     NON_COPYABLE(ModelLoader);
     NON_MOVABLE(ModelLoader);
 
+    // Processes and uploads a model on the calling thread.
     ModelHandle Load(std::string_view path);
+    // Parses the model, processes its meshes and decodes its images without touching the device, so models can be processed
+    // on other threads while the loader is in use. Images already in the resource cache are only skipped with
+    // skipCachedImages, which reads the cache and is only safe on the thread uploading models.
+    ProcessedModel Process(std::string_view path, bool skipCachedImages) const;
+    // Creates the GPU resources of a processed model, on the thread owning the loader. Streamed textures take over the decoded
+    // images.
+    ModelHandle Upload(ProcessedModel&& model);
     MeshPrimitiveHandle LoadPrimitive(const MeshPrimitive& primitive, SingleTimeCommands& commandBuffer, std::shared_ptr<MaterialHandle> material = nullptr);
 
+    // Time spent in each stage of primitive processing, summed over all primitives and threads.
+    struct ProcessTimings
+    {
+        std::chrono::duration<float, std::milli> attributes{};
+        std::chrono::duration<float, std::milli> tangents{};
+        std::chrono::duration<float, std::milli> lods{};
+
+        ProcessTimings& operator+=(const ProcessTimings& other);
+    };
+
+    // The CPU side of loading, none of these touch the device.
+    static MeshPrimitive ProcessPrimitive(const fastgltf::Primitive& primitive, const fastgltf::Asset& gltf, ProcessTimings& timings);
+    static Texture ProcessImage(const fastgltf::Image& gltfImage, const fastgltf::Asset& gltf);
+    // Fills in the draw parameters and bounds of a primitive, the buffers and material are left empty.
+    static MeshPrimitiveHandle DescribePrimitive(const MeshPrimitive& primitive);
+    // Adds a node for every mesh instance in the first scene, the meshes of the model have to be filled in already.
+    static void BuildHierarchy(ModelHandle& modelHandle, const fastgltf::Asset& gltf);
+
 private:
     const VulkanBrain& _brain;
-    fastgltf::Parser _parser;
     vk::UniqueSampler _sampler;
     std::shared_ptr<MaterialHandle> _defaultMaterial;
     vk::DescriptorSetLayout _materialDescriptorSetLayout;
+    ResourceCache _resourceCache;
+    TextureStreamer* _textureStreamer;
+    // Reorders indices and vertices for the post-transform cache, overdraw and vertex fetch.
+    bool _optimizeMeshes;
 
-    Mesh ProcessMesh(const fastgltf::Mesh& gltfMesh, const fastgltf::Asset& gltf);
-    MeshPrimitive ProcessPrimitive(const fastgltf::Primitive& primitive, const fastgltf::Asset& gltf);
-    Texture ProcessImage(const fastgltf::Image& gltfImage, const fastgltf::Asset& gltf);
-    Material ProcessMaterial(const fastgltf::Material& gltfMaterial, const fastgltf::Asset& gltf);
+    static Mesh ProcessMesh(const fastgltf::Mesh& gltfMesh, const fastgltf::Asset& gltf, ProcessTimings& timings);
+    static Material ProcessMaterial(const fastgltf::Material& gltfMaterial, const fastgltf::Asset& gltf);
 
-    vk::PrimitiveTopology MapGltfTopology(fastgltf::PrimitiveType gltfTopology);
-    vk::IndexType MapIndexType(fastgltf::ComponentType componentType);
-    uint32_t MapTextureIndexToImageIndex(uint32_t textureIndex, const fastgltf::Asset& gltf);
+    static vk::PrimitiveTopology MapGltfTopology(fastgltf::PrimitiveType gltfTopology);
+    static vk::IndexType MapIndexType(fastgltf::ComponentType componentType);
+    static uint32_t MapTextureIndexToImageIndex(uint32_t textureIndex, const fastgltf::Asset& gltf);
 
-    void CalculateTangents(MeshPrimitive& primitive);
-    glm::vec4 CalculateTangent(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec2 uv0, glm::vec2 uv1, glm::vec2 uv2, glm::vec3 normal);
-    ModelHandle LoadModel(const std::vector<Mesh>& meshes, const std::vector<Texture>& textures, const std::vector<Material>& materials, const fastgltf::Asset& gltf);
+    // Textures are only decoded for images that aren't cached yet, the others are left empty.
+    ModelHandle LoadModel(const std::vector<Mesh>& meshes, std::vector<Texture>&& textures, const std::vector<uint64_t>& imageKeys, const std::vector<Material>& materials, const fastgltf::Asset& gltf);
 
-    void RecurseHierarchy(const fastgltf::Node& gltfNode, ModelHandle& hierarchy, const fastgltf::Asset& gltf, glm::mat4 matrix);
+    static void RecurseHierarchy(const fastgltf::Node& gltfNode, ModelHandle& hierarchy, const fastgltf::Asset& gltf, glm::mat4 matrix);
 };
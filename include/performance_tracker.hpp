@@ -5,30 +5,77 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <utility>
+#include <filesystem>
+#include "ring_buffer.hpp"
+#include "frame_statistics.hpp"
+
+struct MemoryStatistics
+{
+    uint64_t deviceUsage{ 0 };
+    uint64_t deviceBudget{ 0 };
+    // Bytes per category name.
+    std::vector<std::pair<std::string, uint64_t>> categories;
+};
+
+struct GPUTiming
+{
+    std::string name;
+    float milliseconds;
+};
 
 class PerformanceTracker
 {
 public:
     PerformanceTracker();
+    // Measures the time since the previous call as a frame.
     void Update();
+    // Adds a frame with a known duration in milliseconds, for runs that don't follow the wall clock.
+    void Record(float frameDuration);
     void Render();
 
-private:
-    static const uint32_t MAX_SAMPLES{ 512 };
+    void SetMemoryStatistics(MemoryStatistics statistics) { _memoryStatistics = std::move(statistics); }
+    // Recorded with the next Update.
+    void SetGPUTimings(const std::vector<GPUTiming>& timings) { _gpuTimings = timings; }
 
+    const FrameStatistics& Statistics() const { return _statistics; }
+    void SetHitchThresholds(const HitchThresholds& thresholds) { _statistics.SetHitchThresholds(thresholds); }
+    // Keeps every frame duration from now on for ExportCSV, which grows by 4 bytes per frame.
+    void SetFrameLogEnabled(bool enabled) { _frameLogEnabled = enabled; }
 
-    std::vector<float> _fpsValues;
+    // One row per logged frame.
+    bool ExportCSV(const std::filesystem::path& path) const;
+    // Summary of the statistics and the recent hitches.
+    bool ExportJSON(const std::filesystem::path& path) const;
 
-    std::vector<float> _frameDurations;
-    std::vector<std::string> _labels;
+private:
+    static const uint32_t MAX_SAMPLES{ 512 };
+    // The first frames include startup work and aren't counted.
+    static const uint32_t WARMUP_FRAMES{ 4 };
+
+    RingBuffer<float, MAX_SAMPLES> _fpsValues;
+    RingBuffer<float, MAX_SAMPLES> _frameDurations;
+    RingBuffer<float, MAX_SAMPLES> _timePoints;
+    SlidingWindowMax<MAX_SAMPLES> _highestFps;
+    SlidingWindowMax<MAX_SAMPLES> _highestFrameDuration;
 
-    std::vector<float> _timePoints;
     std::chrono::steady_clock::time_point _lastFrameTime;
-    float _totalTime;
+    float _totalTime{ 0.0f };
     uint32_t _frameCounter{ 0 };
 
-    float _highestFps;
-    uint32_t _highestFpsRecordIndex;
-    float _highestFrameDuration;
-    uint32_t _highestFrameDurationRecordIndex;
-};
\ No newline at end of file
+    FrameStatistics _statistics;
+    bool _frameLogEnabled{ false };
+    std::vector<float> _frameLog;
+
+    MemoryStatistics _memoryStatistics;
+
+    struct GPUZoneHistory
+    {
+        std::string name;
+        // Sum of this zone and all zones before it, so the plots can be stacked.
+        RingBuffer<float, MAX_SAMPLES> stackedDurations;
+    };
+
+    std::vector<GPUTiming> _gpuTimings;
+    std::vector<GPUZoneHistory> _gpuZones;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "include.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
+
+class StartupTimeline;
+
+struct ShaderStage
+{
+    vk::ShaderStageFlagBits stage;
+    // SPIR-V file, read by the thread compiling the pipeline.
+    std::string path;
+    // Value of the specialization constant with each constant_id, starting at 0. Booleans, integers and floats are all
+    // 32 bits in GLSL.
+    std::vector<uint32_t> specializationConstants;
+};
+
+// Everything needed to create a graphics pipeline, held by value so it can be compiled on another thread. The defaults
+// are the state the passes share: back face culled, clockwise triangles without depth testing, with dynamic viewport and
+// scissor. Every color attachment is written without blending.
+struct GraphicsPipelineDescription
+{
+    std::string name;
+    std::vector<ShaderStage> shaders;
+    vk::PipelineLayout layout;
+
+    // Left out of pipelines with a mesh shader.
+    std::vector<vk::VertexInputBindingDescription> vertexBindings;
+    std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+    vk::PrimitiveTopology topology{ vk::PrimitiveTopology::eTriangleList };
+
+    vk::CullModeFlags cullMode{ vk::CullModeFlagBits::eBack };
+    vk::FrontFace frontFace{ vk::FrontFace::eClockwise };
+
+    bool depthTest{ false };
+    bool depthWrite{ false };
+    vk::CompareOp depthCompareOp{ vk::CompareOp::eLess };
+
+    std::vector<vk::Format> colorFormats;
+    vk::Format depthFormat{ vk::Format::eUndefined };
+};
+
+struct ComputePipelineDescription
+{
+    std::string name;
+    std::string shaderPath;
+    vk::PipelineLayout layout;
+};
+
+// A pipeline that may still be compiling. Get waits for it, so the first use blocks when it isn't done yet, and rethrows
+// when compiling failed. The compiler swaps in a new pipeline when one of its shaders is reloaded, so Get should be
+// called every frame instead of holding on to the handle.
+class CompiledPipeline
+{
+public:
+    CompiledPipeline() = default;
+
+    vk::Pipeline Get() const { return _state->current.get(); }
+    bool Ready() const;
+    // Waits for compilation to finish first, failed pipelines have nothing to destroy.
+    void Destroy(vk::Device device);
+
+private:
+    friend class PipelineCompiler;
+
+    struct State
+    {
+        std::string name;
+        // SPIR-V files the pipeline is created from, reloading any of them recompiles it.
+        std::vector<std::string> shaderPaths;
+        std::function<vk::Pipeline()> create;
+
+        std::shared_future<vk::Pipeline> current;
+        // Recompiled pipeline, swapped in at a frame boundary once it's done.
+        std::shared_future<vk::Pipeline> replacement;
+        // A shader changed while the replacement was still compiling, so it's compiled again after.
+        bool stale{ false };
+    };
+
+    explicit CompiledPipeline(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> _state;
+};
+
+// Compiles pipeline descriptions on a pool of worker threads, creating pipelines is thread-safe in Vulkan. All pipelines
+// share one pipeline cache, which is loaded from and saved to disk, so later runs skip most of the driver's compilation.
+class PipelineCompiler
+{
+public:
+    // Stages of compiling each pipeline are added to the timeline while it's set.
+    PipelineCompiler(const VulkanBrain& brain, std::filesystem::path cacheFile, StartupTimeline* timeline = nullptr);
+    // Finishes the queued pipelines before saving the cache.
+    ~PipelineCompiler();
+
+    NON_COPYABLE(PipelineCompiler);
+    NON_MOVABLE(PipelineCompiler);
+
+    CompiledPipeline Compile(GraphicsPipelineDescription description);
+    CompiledPipeline Compile(ComputePipelineDescription description);
+
+    // No pipelines are queued or compiling.
+    bool Idle() const;
+    void SetTimeline(StartupTimeline* timeline) { _timeline = timeline; }
+
+    // Recompiles every pipeline created from the SPIR-V file. They keep using the old pipeline until Update swaps it.
+    void Reload(const std::string& shaderPath);
+    // Called once per frame at a frame boundary, by the thread that records frames. Swaps in recompiled pipelines and
+    // destroys the ones they replaced once no frame in flight can still use them.
+    void Update();
+
+private:
+    const VulkanBrain& _brain;
+    std::filesystem::path _cacheFile;
+    vk::PipelineCache _cache;
+    std::atomic<StartupTimeline*> _timeline;
+
+    std::vector<std::thread> _workers;
+    std::deque<std::packaged_task<vk::Pipeline()>> _queue;
+    mutable std::mutex _mutex;
+    std::condition_variable _queueChanged;
+    uint32_t _compilingCount{ 0 };
+    bool _stopping{ false };
+
+    struct RetiredPipeline
+    {
+        vk::Pipeline pipeline;
+        // Value of _frameCount when the pipeline was swapped out.
+        uint64_t frame;
+    };
+
+    // Only used by the thread recording frames.
+    std::vector<std::weak_ptr<CompiledPipeline::State>> _pipelines;
+    std::vector<RetiredPipeline> _retiredPipelines;
+    uint64_t _frameCount{ 0 };
+
+    CompiledPipeline Register(std::string name, std::vector<std::string> shaderPaths, std::function<vk::Pipeline()> create);
+    std::shared_future<vk::Pipeline> Enqueue(std::string name, std::function<vk::Pipeline()> create);
+    void WorkerLoop();
+
+    vk::Pipeline CreatePipeline(const GraphicsPipelineDescription& description) const;
+    vk::Pipeline CreatePipeline(const ComputePipelineDescription& description) const;
+
+    void LoadCache();
+    void SaveCache() const;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "include.hpp"
+#include "gbuffers.hpp"
+#include "mesh.hpp"
+#include "frame_allocator.hpp"
+#include "pipeline_compiler.hpp"
+
+// Draws the per frame culling buffers are sized for at first, they grow to the next power of two when a scene has more.
+constexpr uint32_t INITIAL_DRAW_CAPACITY = 1024;
+// Must match the workgroup size of the meshlet task shader.
+constexpr uint32_t MESHLETS_PER_TASK = 32;
+
+enum class CullingPhase
+{
+    // Draws everything that was visible in the previous frame's depth pyramid.
+    eEarly,
+    // Draws everything that was rejected in the early phase, but turned out to be visible in the current depth.
+    eLate
+};
+
+struct DrawCall
+{
+    const MeshPrimitiveHandle* primitive;
+    glm::mat4 transform;
+    uint32_t uniformIndex;
+    uint32_t lod;
+    // Material features of the primitive, draws are sorted by it so every pipeline variant is bound once.
+    uint32_t featureMask;
+};
+
+class CullingPipeline
+{
+public:
+    CullingPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const GBuffers& gBuffers, const CameraStructure& camera, FrameAllocator& frameAllocator);
+    ~CullingPipeline();
+
+    // The early phase grows the buffers of the frame when there are more draws than fit, so it has to be recorded after
+    // waiting on the frame's fence and before the draws read the commands.
+    void RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const std::vector<DrawCall>& drawCalls, CullingPhase phase);
+    // Expects the depth image to be in shader read only layout.
+    void RecordDepthPyramidCommands(vk::CommandBuffer commandBuffer);
+    void RecreateDepthPyramid();
+
+    vk::Buffer IndirectBuffer(uint32_t currentFrame) const { return _frameData[currentFrame].indirectBuffer; }
+    vk::DeviceSize IndirectOffset(uint32_t currentFrame, CullingPhase phase) const { return CommandOffset(currentFrame, phase) * sizeof(vk::DrawIndexedIndirectCommand); }
+    vk::Buffer MeshTaskBuffer(uint32_t currentFrame) const { return _frameData[currentFrame].meshTaskBuffer; }
+    vk::DeviceSize MeshTaskOffset(uint32_t currentFrame, CullingPhase phase) const { return CommandOffset(currentFrame, phase) * sizeof(vk::DrawMeshTasksIndirectCommandEXT); }
+
+    NON_MOVABLE(CullingPipeline);
+    NON_COPYABLE(CullingPipeline);
+
+private:
+    struct DrawInfo
+    {
+        glm::mat4 model;
+        glm::vec4 boundingBoxMin;
+        glm::vec4 boundingBoxMax;
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t taskCount;
+    };
+
+    struct CullingPushConstants
+    {
+        uint32_t phase;
+        uint32_t drawCount;
+        uint32_t commandOffset;
+        uint32_t pyramidValid;
+        glm::vec2 pyramidSize;
+    };
+
+    struct DepthPyramidPushConstants
+    {
+        glm::uvec2 inputSize;
+        glm::uvec2 outputSize;
+    };
+
+    struct FrameData
+    {
+        // Offset of the draw infos within the frame allocator buffer.
+        vk::DeviceSize drawInfoOffset;
+        // Draws the buffers and the draw info descriptor range have room for.
+        uint32_t drawCapacity{ INITIAL_DRAW_CAPACITY };
+
+        vk::Buffer indirectBuffer;
+        VmaAllocation indirectBufferAllocation;
+
+        vk::Buffer meshTaskBuffer;
+        VmaAllocation meshTaskBufferAllocation;
+
+        vk::Buffer visibilityBuffer;
+        VmaAllocation visibilityBufferAllocation;
+
+        vk::DescriptorSet descriptorSet;
+    };
+
+    void CreateCullingPipeline(PipelineCompiler& compiler);
+    void CreateDepthPyramidPipeline(PipelineCompiler& compiler);
+    void CreateDescriptorSetLayouts();
+    void CreateBuffers(uint32_t frameIndex);
+    void DestroyBuffers(uint32_t frameIndex);
+    void GrowBuffers(uint32_t frameIndex, uint32_t drawCount);
+    void CreateDescriptorSets();
+    void UpdateCullingDescriptorSet(uint32_t frameIndex);
+    // Index of the first command of a phase, the late phase's commands follow the early ones.
+    uint32_t CommandOffset(uint32_t currentFrame, CullingPhase phase) const { return phase == CullingPhase::eEarly ? 0 : _frameData[currentFrame].drawCapacity; }
+    void CreateDepthPyramid();
+    void DestroyDepthPyramid();
+
+    const VulkanBrain& _brain;
+    const GBuffers& _gBuffers;
+    const CameraStructure& _camera;
+    FrameAllocator& _frameAllocator;
+
+    vk::DescriptorSetLayout _cullingDescriptorSetLayout;
+    vk::PipelineLayout _cullingPipelineLayout;
+    CompiledPipeline _cullingPipeline;
+
+    vk::DescriptorSetLayout _depthPyramidDescriptorSetLayout;
+    vk::PipelineLayout _depthPyramidPipelineLayout;
+    CompiledPipeline _depthPyramidPipeline;
+
+    vk::Image _depthPyramid;
+    VmaAllocation _depthPyramidAllocation;
+    vk::ImageView _depthPyramidView;
+    std::vector<vk::ImageView> _depthPyramidMipViews;
+    std::vector<vk::DescriptorSet> _depthPyramidDescriptorSets;
+    glm::uvec2 _depthPyramidSize;
+    uint32_t _depthPyramidMipCount;
+    bool _depthPyramidValid{ false };
+
+    vk::UniqueSampler _sampler;
+
+    std::array<FrameData, MAX_FRAMES_IN_FLIGHT> _frameData;
+};
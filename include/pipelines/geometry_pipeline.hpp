@@ -3,48 +3,112 @@
 #include "include.hpp"
 #include "gbuffers.hpp"
 #include "mesh.hpp"
+#include "pipelines/culling_pipeline.hpp"
+#include "texture_streamer.hpp"
+#include "frame_allocator.hpp"
+#include "pipeline_compiler.hpp"
+#include <unordered_map>
 
 struct UBO
 {
     alignas(16) glm::mat4 model;
 };
 
-constexpr uint32_t MAX_MESHES = 128;
+// Largest simplification error in pixels that is allowed on screen when picking a LOD.
+constexpr float LOD_ERROR_THRESHOLD = 1.0f;
 
 class GeometryPipeline
 {
 public:
-    GeometryPipeline(const VulkanBrain& brain, const GBuffers& gBuffers, vk::DescriptorSetLayout materialDescriptorSetLayout, const CameraStructure& camera);
+    GeometryPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const GBuffers& gBuffers, vk::DescriptorSetLayout materialDescriptorSetLayout, const CameraStructure& camera, const CullingPipeline& culling, const TextureStreamer& textureStreamer, FrameAllocator& frameAllocator);
     ~GeometryPipeline();
 
-    void RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene);
+    void PrepareDrawCalls(uint32_t currentFrame, const SceneDescription& scene);
+    // One draw per primitive of every node, with the LOD picked for a viewport of the given height. Draws index into
+    // transforms, which receives a matrix per node.
+    static void GatherDrawCalls(const SceneDescription& scene, float viewportHeight, std::vector<DrawCall>& drawCalls, std::vector<glm::mat4>& transforms);
+    void RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene, CullingPhase phase);
+
+    // Starts compiling the pipeline variants of the model's materials, so they're ready before it's first drawn.
+    void PrepareVariants(const ModelHandle& model);
+
+    const std::vector<DrawCall>& DrawCalls() const { return _drawCalls; }
+    bool DepthPrepassEnabled() const { return _depthPrepass; }
+    void SetDepthPrepassEnabled(bool enabled) { _depthPrepass = enabled; }
+    bool MeshShadingEnabled() const { return _meshShading && _brain.meshShadersSupported; }
+    void SetMeshShadingEnabled(bool enabled) { _meshShading = enabled; }
 
     NON_MOVABLE(GeometryPipeline);
     NON_COPYABLE(GeometryPipeline);
 
 private:
+    struct MeshletPushConstants
+    {
+        uint32_t meshletCount;
+    };
+
     struct FrameData
     {
-        vk::Buffer uniformBuffer;
-        VmaAllocation uniformBufferAllocation;
-        void* uniformBufferMapped;
+        // Offset of this frame's transforms within the frame allocator buffer.
+        vk::DeviceSize uniformOffset;
         vk::DescriptorSet descriptorSet;
     };
 
+    // Pipelines compiled for one material feature mask, with the fragment shader specialized to the maps in it.
+    struct Variant
+    {
+        CompiledPipeline pipeline;
+        CompiledPipeline equalDepthPipeline;
+        // Only compiled when mesh shaders are supported.
+        CompiledPipeline meshPipeline;
+    };
+
+    enum class DrawPass
+    {
+        eDepthPrepass,
+        eGeometry,
+        eAfterDepthPrepass,
+    };
+
+    void RecordDepthPrepassCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene, CullingPhase phase);
+    void RecordDraws(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene, CullingPhase phase, DrawPass pass);
     void CreatePipeline(vk::DescriptorSetLayout materialDescriptorSetLayout);
+    void CreateMeshPipeline(vk::DescriptorSetLayout materialDescriptorSetLayout);
+    // Compiles the variant the first time a feature mask is seen.
+    const Variant& GetVariant(uint32_t featureMask);
     void CreateDescriptorSetLayout();
+    vk::DescriptorSet MeshletDescriptorSet(const MeshPrimitiveHandle& primitive);
     void CreateDescriptorSets();
-    void CreateUniformBuffers();
     void UpdateGeometryDescriptorSet(uint32_t frameIndex);
-    void UpdateUniformData(uint32_t currentFrame, const std::vector<glm::mat4> transforms, const Camera& camera);
+    static uint32_t SelectLOD(const MeshPrimitiveHandle& primitive, const glm::mat4& transform, const Camera& camera, float viewportHeight);
+    void UpdateUniformData(uint32_t currentFrame, const std::vector<glm::mat4>& transforms, const Camera& camera);
 
     const VulkanBrain& _brain;
+    PipelineCompiler& _compiler;
     const GBuffers& _gBuffers;
     const CameraStructure& _camera;
+    const CullingPipeline& _culling;
+    const TextureStreamer& _textureStreamer;
+    FrameAllocator& _frameAllocator;
 
     vk::DescriptorSetLayout _descriptorSetLayout;
     vk::PipelineLayout _pipelineLayout;
-    vk::Pipeline _pipeline;
+    CompiledPipeline _depthPipeline;
+
+    vk::DescriptorSetLayout _meshletDescriptorSetLayout;
+    vk::PipelineLayout _meshPipelineLayout;
+
+    // Specialized per material feature mask by GetVariant.
+    GraphicsPipelineDescription _description;
+    GraphicsPipelineDescription _equalDepthDescription;
+    GraphicsPipelineDescription _meshDescription;
+    std::unordered_map<uint32_t, Variant> _variants;
+    std::unordered_map<const MeshPrimitiveHandle*, vk::DescriptorSet> _meshletDescriptorSets;
 
     std::array<FrameData, MAX_FRAMES_IN_FLIGHT> _frameData;
+    // Distance between transforms, so each one can be bound with a dynamic offset.
+    vk::DeviceSize _uniformStride;
+    std::vector<DrawCall> _drawCalls;
+    bool _depthPrepass{ false };
+    bool _meshShading{ false };
 };
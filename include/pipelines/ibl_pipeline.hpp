@@ -3,6 +3,7 @@
 #include "vulkan/vulkan.hpp"
 #include "vk_mem_alloc.h"
 #include "mesh.hpp"
+#include "pipeline_compiler.hpp"
 
 struct VulkanBrain;
 struct TextureHandle;
@@ -10,7 +11,7 @@ struct TextureHandle;
 class IBLPipeline
 {
 public:
-    IBLPipeline(const VulkanBrain& brain, const TextureHandle& environmentMap);
+    IBLPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const TextureHandle& environmentMap);
     ~IBLPipeline();
 
     void RecordCommands(vk::CommandBuffer commandBuffer);
@@ -32,11 +33,11 @@ private:
     const TextureHandle& _environmentMap;
 
     vk::PipelineLayout _irradiancePipelineLayout;
-    vk::Pipeline _irradiancePipeline;
+    CompiledPipeline _irradiancePipeline;
     vk::PipelineLayout _prefilterPipelineLayout;
-    vk::Pipeline _prefilterPipeline;
+    CompiledPipeline _prefilterPipeline;
     vk::PipelineLayout _brdfLUTPipelineLayout;
-    vk::Pipeline _brdfLUTPipeline;
+    CompiledPipeline _brdfLUTPipeline;
     vk::DescriptorSetLayout _descriptorSetLayout;
     vk::DescriptorSet _descriptorSet;
 
@@ -47,9 +48,9 @@ private:
     std::array<vk::ImageView, 6> _irradianceMapViews;
     std::vector<std::array<vk::ImageView, 6>> _prefilterMapViews;
 
-    void CreateIrradiancePipeline();
-    void CreatePrefilterPipeline();
-    void CreateBRDFLUTPipeline();
+    void CreateIrradiancePipeline(PipelineCompiler& compiler);
+    void CreatePrefilterPipeline(PipelineCompiler& compiler);
+    void CreateBRDFLUTPipeline(PipelineCompiler& compiler);
     void CreateDescriptorSetLayout();
     void CreateDescriptorSet();
     void CreateIrradianceCubemap();
@@ -5,11 +5,12 @@
 #include "mesh.hpp"
 #include "swap_chain.hpp"
 #include "hdr_target.hpp"
+#include "pipeline_compiler.hpp"
 
 class LightingPipeline
 {
 public:
-    LightingPipeline(const VulkanBrain& brain, const GBuffers& gBuffers, const HDRTarget& hdrTarget, const CameraStructure& camera, const Cubemap& irradianceMap, const Cubemap& prefilterMap, const TextureHandle& brdfLUT);
+    LightingPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const GBuffers& gBuffers, const HDRTarget& hdrTarget, const CameraStructure& camera, const Cubemap& irradianceMap, const Cubemap& prefilterMap, const TextureHandle& brdfLUT);
     ~LightingPipeline();
 
     void RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame);
@@ -19,7 +20,7 @@ public:
     NON_COPYABLE(LightingPipeline);
 
 private:
-    void CreatePipeline();
+    void CreatePipeline(PipelineCompiler& compiler);
     void CreateDescriptorSetLayout();
     void CreateDescriptorSets();
 
@@ -34,7 +35,7 @@ private:
     vk::DescriptorSetLayout _descriptorSetLayout;
     vk::DescriptorSet _descriptorSet;
     vk::PipelineLayout _pipelineLayout;
-    vk::Pipeline _pipeline;
+    CompiledPipeline _pipeline;
 
     vk::UniqueSampler _sampler;
 };
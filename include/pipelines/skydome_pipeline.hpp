@@ -3,13 +3,14 @@
 #include "include.hpp"
 #include "swap_chain.hpp"
 #include "mesh.hpp"
+#include "pipeline_compiler.hpp"
 
 struct HDRTarget;
 
 class SkydomePipeline
 {
 public:
-    SkydomePipeline(const VulkanBrain& brain, MeshPrimitiveHandle&& sphere, const CameraStructure& camera, const HDRTarget& hdrTarget, const TextureHandle& environmentMap);
+    SkydomePipeline(const VulkanBrain& brain, PipelineCompiler& compiler, MeshPrimitiveHandle&& sphere, const CameraStructure& camera, const HDRTarget& hdrTarget, const TextureHandle& environmentMap);
     ~SkydomePipeline();
 
     void RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame);
@@ -28,11 +29,11 @@ private:
     vk::UniqueSampler _sampler;
 
     vk::PipelineLayout _pipelineLayout;
-    vk::Pipeline _pipeline;
+    CompiledPipeline _pipeline;
     vk::DescriptorSet _descriptorSet;
     vk::DescriptorSetLayout _descriptorSetLayout;
 
-    void CreatePipeline();
+    void CreatePipeline(PipelineCompiler& compiler);
     void CreateDescriptorSetLayout();
     void CreateDescriptorSet();
 };
\ No newline at end of file
@@ -2,14 +2,17 @@
 #include "include.hpp"
 #include "swap_chain.hpp"
 #include "hdr_target.hpp"
+#include "pipeline_compiler.hpp"
 
 class TonemappingPipeline
 {
 public:
-    TonemappingPipeline(const VulkanBrain& brain, const HDRTarget& hdrTarget, const SwapChain& _swapChain);
+    TonemappingPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const HDRTarget& hdrTarget, const SwapChain& _swapChain);
     ~TonemappingPipeline();
 
     void RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, uint32_t swapChainIndex);
+    // Call after the HDR target was recreated.
+    void UpdateHDRView();
 
     NON_COPYABLE(TonemappingPipeline);
     NON_MOVABLE(TonemappingPipeline);
@@ -21,12 +24,12 @@ private:
 
     vk::DescriptorSetLayout _descriptorSetLayout;
     vk::PipelineLayout _pipelineLayout;
-    vk::Pipeline _pipeline;
+    CompiledPipeline _pipeline;
 
     std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT> _descriptorSets;
     vk::UniqueSampler _sampler;
 
-    void CreatePipeline();
+    void CreatePipeline(PipelineCompiler& compiler);
     void CreateDescriptorSetLayout();
     void CreateDescriptorSets();
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include "include.hpp"
+#include "mesh.hpp"
+#include <span>
+#include <unordered_map>
+
+class VulkanBrain;
+
+// Shares textures and materials with identical contents between models. Entries are reference counted through the
+// returned shared pointers, the GPU resources are destroyed as soon as the last model using them releases its handle.
+class ResourceCache
+{
+public:
+    explicit ResourceCache(const VulkanBrain& brain);
+
+    NON_COPYABLE(ResourceCache);
+    NON_MOVABLE(ResourceCache);
+
+    static uint64_t HashBytes(std::span<const std::byte> bytes);
+
+    // The key is the hash of the encoded image, so cached images don't need to be decoded again. A key of 0 is never cached.
+    // The encoded bytes are compared on a hit, so a hash collision can't bind the wrong texture.
+    std::shared_ptr<TextureHandle> FindTexture(uint64_t key, std::span<const std::byte> encoded) const;
+    // Takes ownership of the image and view. Keeps a copy of the encoded image to compare against, a texture whose key is
+    // already taken by a different image isn't cached.
+    std::shared_ptr<TextureHandle> AddTexture(uint64_t key, std::span<const std::byte> encoded, const TextureHandle& texture);
+
+    std::shared_ptr<MaterialHandle> FindMaterial(const MaterialHandle::MaterialInfo& info, const std::array<std::shared_ptr<TextureHandle>, MaterialHandle::TEXTURE_COUNT>& textures) const;
+    // Takes ownership of the uniform buffer.
+    std::shared_ptr<MaterialHandle> AddMaterial(const MaterialHandle::MaterialInfo& info, const MaterialHandle& material);
+
+    size_t TextureCount() const;
+    size_t MaterialCount() const;
+
+private:
+    struct MaterialKey
+    {
+        MaterialHandle::MaterialInfo info;
+        std::array<const TextureHandle*, MaterialHandle::TEXTURE_COUNT> textures;
+
+        bool operator==(const MaterialKey& other) const;
+    };
+
+    struct MaterialKeyHash
+    {
+        size_t operator()(const MaterialKey& key) const;
+    };
+
+    static MaterialKey MakeMaterialKey(const MaterialHandle::MaterialInfo& info, const std::array<std::shared_ptr<TextureHandle>, MaterialHandle::TEXTURE_COUNT>& textures);
+
+    const VulkanBrain& _brain;
+
+    struct TextureEntry
+    {
+        std::vector<std::byte> encoded;
+        // Weak, so the cache itself never keeps resources alive.
+        std::weak_ptr<TextureHandle> handle;
+    };
+
+    std::unordered_map<uint64_t, TextureEntry> _textures;
+    std::unordered_map<MaterialKey, std::weak_ptr<MaterialHandle>, MaterialKeyHash> _materials;
+};
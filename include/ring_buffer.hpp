@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <algorithm>
+
+// Fixed capacity buffer that overwrites its oldest element once full. Elements stay in one array, so plotting code can
+// read them in place by starting at Offset() and wrapping around.
+template <typename T, size_t N>
+class RingBuffer
+{
+public:
+    void Push(const T& value)
+    {
+        _data[_head] = value;
+        _head = (_head + 1) % N;
+        _size = std::min(_size + 1, N);
+    }
+
+    // Overwrites every element without changing the size or order.
+    void Fill(const T& value) { _data.fill(value); }
+
+    void Clear()
+    {
+        _head = 0;
+        _size = 0;
+    }
+
+    // Oldest element first.
+    const T& operator[](size_t index) const { return _data[(Offset() + index) % N]; }
+    const T& Front() const { return (*this)[0]; }
+    const T& Back() const { return (*this)[_size - 1]; }
+
+    size_t Size() const { return _size; }
+    bool Empty() const { return _size == 0; }
+    static constexpr size_t Capacity() { return N; }
+
+    const T* Data() const { return _data.data(); }
+    // Position of the oldest element in Data().
+    size_t Offset() const { return _size < N ? 0 : _head; }
+
+private:
+    std::array<T, N> _data{};
+    size_t _head{ 0 };
+    size_t _size{ 0 };
+};
+
+// Maximum of the last N pushed values in amortized O(1), by only keeping values that aren't dominated by a newer one.
+template <size_t N>
+class SlidingWindowMax
+{
+public:
+    void Push(float value)
+    {
+        while(_count > 0 && Back().value <= value)
+            --_count;
+
+        // Drops the entry leaving the window before writing, otherwise a full ring would overwrite its oldest entry.
+        if(_count > 0 && _pushed - _entries[_first].index >= N)
+        {
+            _first = (_first + 1) % N;
+            --_count;
+        }
+
+        _entries[(_first + _count) % N] = Entry{ _pushed, value };
+        ++_count;
+        ++_pushed;
+    }
+
+    float Max() const { return _count > 0 ? _entries[_first].value : 0.0f; }
+
+private:
+    struct Entry
+    {
+        size_t index;
+        float value;
+    };
+
+    Entry& Back() { return _entries[(_first + _count - 1) % N]; }
+
+    std::array<Entry, N> _entries{};
+    size_t _first{ 0 };
+    size_t _count{ 0 };
+    size_t _pushed{ 0 };
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+namespace shader
+{
+    // Set when the build found shaderc, the GLSL compiler that ships with the Vulkan SDK.
+#if defined(SHADER_HOT_RELOAD)
+    constexpr bool GLSL_COMPILER_AVAILABLE = true;
+#else
+    constexpr bool GLSL_COMPILER_AVAILABLE = false;
+#endif
+
+    // The SPIR-V file shader_comp.py writes for a GLSL source, nothing for files that aren't shaders.
+    std::optional<std::filesystem::path> SPIRVPath(const std::filesystem::path& source);
+    // Throws with the compiler's messages when the source has errors.
+    std::vector<uint32_t> CompileGLSL(const std::filesystem::path& source);
+}
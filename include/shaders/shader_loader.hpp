@@ -8,4 +8,6 @@ namespace shader
 {
     std::vector<std::byte> ReadFile(std::string_view filename);
     vk::ShaderModule CreateShaderModule(const std::vector<std::byte>& byteCode, const vk::Device& device);
+    // Whether the SPIR-V declares a specialization constant with the constant_id.
+    bool HasSpecializationConstant(const std::vector<std::byte>& byteCode, uint32_t constantId);
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Polls a directory of GLSL sources on a background thread. Changed sources are compiled and written to the SPIR-V file
+// next to them, which is picked up by the render thread with TakeRecompiled.
+class ShaderWatcher
+{
+public:
+    explicit ShaderWatcher(std::filesystem::path directory);
+    ~ShaderWatcher();
+
+    NON_COPYABLE(ShaderWatcher);
+    NON_MOVABLE(ShaderWatcher);
+
+    // SPIR-V files written since the last call, with forward slashes like the paths in pipeline descriptions.
+    std::vector<std::string> TakeRecompiled();
+
+private:
+    std::filesystem::path _directory;
+    // Last write time of every source, changes are compiled once. Only used by the watching thread.
+    std::map<std::filesystem::path, std::filesystem::file_time_type> _writeTimes;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _stopRequested;
+    std::vector<std::string> _recompiled;
+    bool _stopping{ false };
+
+    void WatchLoop();
+    // Returns the sources that changed since the last scan.
+    std::vector<std::filesystem::path> Scan();
+    void Recompile(const std::filesystem::path& source);
+};
@@ -7,6 +7,15 @@ class VulkanBrain;
 struct Texture;
 struct TextureHandle;
 
+// Pixels waiting in a staging buffer for SingleTimeCommands::CreateStagedImage.
+struct StagedImage
+{
+    vk::Buffer buffer;
+    VmaAllocation allocation;
+    uint32_t width, height;
+    vk::Format format;
+};
+
 class SingleTimeCommands
 {
 public:
@@ -15,6 +24,13 @@ public:
 
     void Submit();
     void CreateTextureImage(const Texture& texture, TextureHandle& textureHandle, bool generateMips);
+    // Streams a Radiance .hdr file into the staging buffer as RGBA16F, without keeping a decoded copy around.
+    void CreateHDRImage(std::string_view path, TextureHandle& textureHandle);
+    // Copies a staged image into a new image, the staging buffer is released with the other staging buffers.
+    void CreateStagedImage(const StagedImage& stagedImage, TextureHandle& textureHandle);
+
+    // Decodes a Radiance .hdr file into a new staging buffer as RGBA16F. Doesn't record anything, so it can run on any thread.
+    static StagedImage StageHDRImage(const VulkanBrain& brain, std::string_view path);
     void CreateLocalBuffer(const std::byte* vec, uint32_t count, vk::Buffer& buffer, VmaAllocation& allocation, vk::BufferUsageFlags usage, std::string_view name);
 
     template <typename T>
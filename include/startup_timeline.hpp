@@ -0,0 +1,62 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Records how long each stage of starting the engine took, relative to the moment the timeline was created. Stages can
+// overlap and may be recorded from worker threads. Milestones, like the first presented frame, are single points in time.
+class StartupTimeline
+{
+public:
+    StartupTimeline();
+
+    NON_COPYABLE(StartupTimeline);
+    NON_MOVABLE(StartupTimeline);
+
+    // Measures a stage from its construction until it goes out of scope.
+    class Stage
+    {
+    public:
+        Stage(StartupTimeline& timeline, std::string name);
+        ~Stage();
+
+        NON_COPYABLE(Stage);
+        NON_MOVABLE(Stage);
+
+    private:
+        StartupTimeline& _timeline;
+        std::string _name;
+        uint64_t _begin;
+    };
+
+    // Times on the CPUProfiler clock.
+    uint64_t Origin() const { return _origin; }
+    void AddStage(std::string name, uint64_t begin, uint64_t end);
+    void AddMilestone(std::string name);
+    bool HasMilestone(std::string_view name) const;
+
+    // Logs every stage and milestone in the order they started.
+    void Report() const;
+    bool ExportJSON(const std::filesystem::path& path) const;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        // Milliseconds since the timeline was created, milestones begin and end at the same time.
+        float begin;
+        float end;
+        bool milestone;
+    };
+
+    std::vector<Entry> SortedEntries() const;
+
+    uint64_t _origin;
+    mutable std::mutex _mutex;
+    std::vector<Entry> _entries;
+};
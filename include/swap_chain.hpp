@@ -2,11 +2,18 @@
 
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
+#include <filesystem>
 #include "class_decorations.hpp"
 #include "vulkan_brain.hpp"
 
 struct QueueFamilyIndices;
 
+// Amount of offscreen images rendered to in turn when running headless.
+constexpr uint32_t HEADLESS_IMAGE_COUNT = 3;
+
+// Presents to the surface of the brain, or renders into offscreen images with the same interface when the brain is
+// headless. Offscreen images end the frame in transfer source layout, so they can be read back.
+
 class SwapChain
 {
 public:
@@ -23,6 +30,13 @@ public:
     NON_COPYABLE(SwapChain);
 
     void Resize(const glm::uvec2& screenSize);
+    // Headless acquisition doesn't signal the semaphore and presenting doesn't wait on it, submissions shouldn't use them.
+    vk::Result AcquireNextImage(vk::Semaphore signalSemaphore, uint32_t& imageIndex);
+    vk::Result Present(vk::Semaphore waitSemaphore, uint32_t imageIndex);
+    // Headless only, copies the image into host memory. The image has to be in transfer source layout.
+    void RecordReadbackCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex) const;
+    // Headless only, writes the data copied by RecordReadbackCommands to a binary PPM file, once the copy finished.
+    void WriteReadback(uint32_t imageIndex, const std::filesystem::path& path) const;
     size_t GetImageCount() const { return _images.size(); };
     vk::SwapchainKHR GetSwapChain() const { return _swapChain; }
     vk::ImageView GetImageView(uint32_t index) const { return _imageViews[index]; }
@@ -44,7 +58,14 @@ private:
     std::vector<vk::ImageView> _imageViews;
     vk::Format _format;
 
+    std::vector<VmaAllocation> _imageAllocations;
+    std::vector<vk::Buffer> _readbackBuffers;
+    std::vector<VmaAllocation> _readbackAllocations;
+    std::vector<std::byte*> _readbackMapped;
+    uint32_t _nextImage{ 0 };
+
     void CreateSwapChain(const glm::uvec2& screenSize);
+    void CreateOffscreenImages(const glm::uvec2& screenSize);
     void CleanUpSwapChain();
     vk::SurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
     vk::PresentModeKHR ChoosePresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "class_decorations.hpp"
+#include "include.hpp"
+#include "mesh.hpp"
+
+class VulkanBrain;
+class SingleTimeCommands;
+
+constexpr uint32_t MAX_STREAMED_TEXTURES = 4096;
+constexpr vk::DeviceSize DEFAULT_TEXTURE_BUDGET = 512ull * 1024 * 1024;
+// Memory pressure never pushes the budget below this.
+constexpr vk::DeviceSize MIN_TEXTURE_BUDGET = 16ull * 1024 * 1024;
+// Mips that fit within this size are always resident, so every texture can be sampled right after loading.
+constexpr uint32_t STREAMING_MIP_TAIL_SIZE = 128;
+// Textures that weren't requested for this many frames fall back to their mip tail when memory is needed.
+constexpr uint32_t STREAMING_UNUSED_FRAMES = 120;
+// Upper bound on the texture data uploaded by a single streaming batch.
+constexpr vk::DeviceSize STREAMING_BATCH_SIZE = 32 * 1024 * 1024;
+
+// Keeps textures at the mip level the geometry pass asks for. Every texture starts with only its mip tail resident,
+// the fragment shader writes the most detailed mip it would sample into a feedback buffer, and higher mips are uploaded
+// from the full mip chain in system memory as long as the resident textures stay within the budget. When the budget runs
+// out the least recently requested textures are shrunk again.
+//
+// Residency changes replace the image of a texture, a batch of them is uploaded in the background and swapped in once
+// its fence signaled. Material descriptor sets are updated on swap, so the GPU can't be using them at that point.
+class TextureStreamer
+{
+public:
+    TextureStreamer(const VulkanBrain& brain, vk::DeviceSize budget);
+    ~TextureStreamer();
+
+    NON_COPYABLE(TextureStreamer);
+    NON_MOVABLE(TextureStreamer);
+
+    // Fills in the mips of a texture that can be streamed. Doesn't touch the streamer, so it's safe to call from the loader's
+    // worker threads.
+    static void BuildMips(Texture& texture);
+    // Creates the image with only the mip tail and takes over the full mip chain for streaming, it's built here if BuildMips
+    // wasn't called. Only 8 bit RGBA textures are supported, others are created fully resident.
+    void CreateTexture(Texture&& texture, TextureHandle& textureHandle, SingleTimeCommands& commands);
+    // Starts tracking a texture created by CreateTexture, it's dropped again as soon as the handle expires.
+    void TrackTexture(const std::shared_ptr<TextureHandle>& texture);
+    // Materials whose descriptor sets have to follow the images of streamed textures.
+    void TrackMaterial(const std::shared_ptr<MaterialHandle>& material);
+
+    // Call after waiting on the frame's fence. Reads the feedback of that frame and schedules new residency changes.
+    void Update(uint32_t currentFrame);
+    // True when a finished batch waits for ApplyPendingBatch.
+    bool BatchReady() const;
+    // Swaps the images of a finished batch in. The caller has to make sure no submitted frame is still running.
+    void ApplyPendingBatch();
+    // Copies this frame's feedback out of the buffer the shaders write to and clears it for the next frame.
+    void RecordFeedbackCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame);
+
+    vk::Buffer TextureSizeBuffer() const { return _textureSizeBuffer; }
+    vk::Buffer FeedbackBuffer() const { return _feedbackBuffer; }
+
+    vk::DeviceSize Budget() const { return _budget; }
+    void SetBudget(vk::DeviceSize budget) { _budget = budget; }
+    vk::DeviceSize ResidentBytes() const { return _residentBytes; }
+    size_t StreamedTextureCount() const { return _streamedTextureCount; }
+
+private:
+    struct StreamedTexture
+    {
+        std::weak_ptr<TextureHandle> handle;
+        // Full mip chain in system memory, level 0 first.
+        std::vector<std::vector<std::byte>> mips;
+        uint32_t width;
+        uint32_t height;
+        uint32_t tailMip;
+        uint32_t residentMip;
+        uint32_t requestedMip;
+        uint64_t lastRequestedFrame;
+        bool pending;
+        bool active;
+    };
+
+    struct Transition
+    {
+        uint32_t streamIndex;
+        uint32_t targetMip;
+        vk::Image image;
+        VmaAllocation allocation;
+        vk::ImageView imageView;
+    };
+
+    struct Batch
+    {
+        std::vector<Transition> transitions;
+        vk::CommandBuffer commandBuffer;
+        vk::Fence fence;
+        vk::Buffer stagingBuffer;
+        VmaAllocation stagingAllocation;
+    };
+
+    void ReleaseExpired();
+    void UploadMips(vk::CommandBuffer commandBuffer, const StreamedTexture& texture, uint32_t baseMip, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset, vk::Image image);
+    void SubmitBatch(std::vector<Transition> transitions);
+    vk::DeviceSize ResidentSize(const StreamedTexture& texture, uint32_t baseMip) const;
+
+    const VulkanBrain& _brain;
+
+    vk::Buffer _textureSizeBuffer;
+    VmaAllocation _textureSizeAllocation;
+    glm::vec2* _textureSizes;
+
+    vk::Buffer _feedbackBuffer;
+    VmaAllocation _feedbackAllocation;
+    std::array<vk::Buffer, MAX_FRAMES_IN_FLIGHT> _readbackBuffers;
+    std::array<VmaAllocation, MAX_FRAMES_IN_FLIGHT> _readbackAllocations;
+    std::array<uint32_t*, MAX_FRAMES_IN_FLIGHT> _readbackMapped;
+    // Readbacks of frames that haven't recorded their feedback copy yet hold no data.
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> _readbackValid{};
+
+    std::vector<StreamedTexture> _textures;
+    std::vector<uint32_t> _freeIndices;
+    std::vector<std::weak_ptr<MaterialHandle>> _materials;
+    std::optional<Batch> _pendingBatch;
+
+    vk::DeviceSize _budget;
+    vk::DeviceSize _residentBytes{ 0 };
+    size_t _streamedTextureCount{ 0 };
+    uint64_t _frameCounter{ 0 };
+};
@@ -2,8 +2,61 @@
 
 #include <span>
 #include <vector>
+#include <thread>
+#include <algorithm>
+#include <exception>
 
 namespace util
 {
+namespace detail
+{
+inline thread_local bool insideParallelFor = false;
+}
+
+// Splits [0, count) into chunks of at least minChunkSize and calls function(begin, end) for each of them on all hardware threads.
+// Blocks until every chunk is done and rethrows the first exception. Nested calls from a worker run on the calling thread,
+// so parallelizing both an outer and an inner loop doesn't oversubscribe the machine.
+template <typename F>
+void ParallelFor(size_t count, size_t minChunkSize, F&& function)
+{
+    size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t chunkCount = std::min(threadCount, (count + minChunkSize - 1) / std::max(minChunkSize, size_t{ 1 }));
+
+    if(chunkCount <= 1 || detail::insideParallelFor)
+    {
+        if(count > 0)
+            function(size_t{ 0 }, count);
+        return;
+    }
+
+    std::vector<std::exception_ptr> exceptions(chunkCount);
+    std::vector<std::thread> threads;
+    threads.reserve(chunkCount - 1);
+
+    auto runChunk = [&](size_t chunk)
+    {
+        detail::insideParallelFor = true;
+        try
+        {
+            function(count * chunk / chunkCount, count * (chunk + 1) / chunkCount);
+        }
+        catch(...)
+        {
+            exceptions[chunk] = std::current_exception();
+        }
+        detail::insideParallelFor = false;
+    };
+
+    for(size_t chunk = 1; chunk < chunkCount; ++chunk)
+        threads.emplace_back(runChunk, chunk);
+
+    runChunk(0);
+
+    for(auto& thread : threads)
+        thread.join();
 
-}
\ No newline at end of file
+    for(auto& exception : exceptions)
+        if(exception)
+            std::rethrow_exception(exception);
+}
+}
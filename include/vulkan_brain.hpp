@@ -38,6 +38,12 @@ public:
     VmaAllocator vmaAllocator;
     QueueFamilyIndices queueFamilyIndices;
     uint32_t minUniformBufferOffsetAlignment;
+    uint32_t minStorageBufferOffsetAlignment;
+    bool meshShadersSupported{ false };
+    // Lets VMA report the actual heap budgets of the driver instead of estimating them.
+    bool memoryBudgetSupported{ false };
+    // Rendering offscreen, there's no surface and no swap chain extension.
+    const bool headless;
 
 private:
     vk::DebugUtilsMessengerEXT _debugMessenger;
@@ -66,10 +72,19 @@ private:
         VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
     };
 
+    // Enabled on top of the required extensions when the device has them.
+    const std::vector<const char*> _meshShaderExtensions =
+    {
+        VK_EXT_MESH_SHADER_EXTENSION_NAME,
+        VK_KHR_SPIRV_1_4_EXTENSION_NAME,
+        VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
+    };
+
     void CreateInstance(const InitInfo& initInfo);
     void PickPhysicalDevice();
     uint32_t RateDeviceSuitability(const vk::PhysicalDevice &device);
-    bool ExtensionsSupported(const vk::PhysicalDevice& device);
+    bool ExtensionsSupported(const vk::PhysicalDevice& device, const std::vector<const char*>& extensions);
+    std::vector<const char*> RequiredDeviceExtensions() const;
     bool CheckValidationLayerSupport();
     std::vector<const char*> GetRequiredExtensions(const InitInfo& initInfo);
     void SetupDebugMessenger();
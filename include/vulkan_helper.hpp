@@ -22,7 +22,10 @@ namespace util
     vk::ImageView CreateImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t layer = 0, uint32_t mipCount = 1);
     uint32_t FindMemoryType(vk::PhysicalDevice physicalDevice, uint32_t typeFilter, vk::MemoryPropertyFlags properties);
     void CreateImage(VmaAllocator allocator, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::Image& image, VmaAllocation& allocation, std::string_view name, bool generateMips, VmaMemoryUsage memoryUsage, uint32_t numLayers = 1);
-    void CreateBuffer(const VulkanBrain& brain, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, bool mappable, VmaAllocation& allocation, VmaMemoryUsage memoryUsage, std::string_view name);
+    void CreateBuffer(const VulkanBrain& brain, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, bool mappable, VmaAllocation& allocation, VmaMemoryUsage memoryUsage, std::string_view name, VkMemoryPropertyFlags requiredFlags = 0);
+    // Counterparts of CreateImage and CreateBuffer, these also take the allocation out of its memory category.
+    void DestroyImage(VmaAllocator allocator, vk::Image image, VmaAllocation allocation);
+    void DestroyBuffer(VmaAllocator allocator, vk::Buffer buffer, VmaAllocation allocation);
     vk::CommandBuffer BeginSingleTimeCommands(const VulkanBrain& brain);
     void EndSingleTimeCommands(const VulkanBrain& brain, vk::CommandBuffer commandBuffer);
     void CopyBuffer(vk::CommandBuffer commandBuffer, vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
@@ -0,0 +1,27 @@
+#version 460
+
+layout(set = 0, binding = 0) uniform UBO
+{
+    mat4 model;
+} ubo;
+
+layout(set = 1, binding = 0) uniform CameraUBO
+{
+    mat4 VP;
+    mat4 view;
+    mat4 proj;
+
+    vec3 cameraPosition;
+} cameraUbo;
+
+layout(location = 0) in vec3 inPosition;
+
+// Has to match geom.vert exactly, the geometry pass tests for equal depth.
+invariant gl_Position;
+
+void main()
+{
+    vec3 position = (ubo.model * vec4(inPosition, 1.0)).xyz;
+
+    gl_Position = (cameraUbo.VP) * vec4(position, 1.0);
+}
@@ -10,6 +10,23 @@ layout(location = 1) out vec4 outNormalR;    // RGB: Normal,   A: Roughness
 layout(location = 2) out vec4 outEmissiveAO; // RGB: Emissive, A: AO
 layout(location = 3) out vec4 outPosition;   // RGB: Position, A: Unused
 
+layout(set = 0, binding = 1) readonly buffer StreamedTextureSizes
+{
+    vec2 streamedTextureSizes[];
+};
+layout(set = 0, binding = 2) buffer StreamingFeedback
+{
+    uint requestedMips[];
+};
+
+// Which maps the material samples, in the order of MaterialHandle::textures. The geometry pass compiles a pipeline for
+// every combination in use, so materials don't branch on them per fragment.
+layout(constant_id = 0) const bool useAlbedoMap = false;
+layout(constant_id = 1) const bool useMRMap = false;
+layout(constant_id = 2) const bool useNormalMap = false;
+layout(constant_id = 3) const bool useOcclusionMap = false;
+layout(constant_id = 4) const bool useEmissiveMap = false;
+
 layout(set = 2, binding = 0) uniform sampler imageSampler;
 layout(set = 2, binding = 1) uniform texture2D albedoImage;
 layout(set = 2, binding = 2) uniform texture2D mrImage;
@@ -26,15 +43,42 @@ layout(set = 2, binding = 6) uniform MaterialInfoUBO
     float occlusionStrength;
 
     vec3 emissiveFactor;
-    bool useEmissiveMap;
+    // Replaced by the specialization constants, kept so the layout matches MaterialInfo.
+    bool _useEmissiveMap;
 
-    bool useAlbedoMap;
-    bool useMRMap;
-    bool useNormalMap;
-    bool useOcclusionMap;
+    bool _useAlbedoMap;
+    bool _useMRMap;
+    bool _useNormalMap;
+    bool _useOcclusionMap;
     float _padding1;
+
+    uint albedoStreamIndex;
+    uint mrStreamIndex;
+    uint normalStreamIndex;
+    uint occlusionStreamIndex;
+
+    uint emissiveStreamIndex;
+    float _padding2;
+    float _padding3;
+    float _padding4;
 } materialInfoUBO;
 
+const uint NO_STREAM_INDEX = 0xFFFFFFFF;
+
+// Reports the most detailed mip this pixel would sample to the texture streamer.
+void RequestMip(uint streamIndex, vec2 uvDx, vec2 uvDy)
+{
+    if(streamIndex == NO_STREAM_INDEX)
+        return;
+
+    vec2 size = streamedTextureSizes[streamIndex];
+    vec2 dx = uvDx * size;
+    vec2 dy = uvDy * size;
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+
+    atomicMin(requestedMips[streamIndex], uint(max(lod, 0.0)));
+}
+
 void main()
 {
     vec4 albedoSample = pow(materialInfoUBO.albedoFactor, vec4(2.2));
@@ -44,25 +88,38 @@ void main()
 
     vec3 normal = normalIn;
 
-    if(materialInfoUBO.useAlbedoMap)
+    // Derivatives are taken before any branching. Only one pixel in every 4x4 block gives feedback, that's plenty
+    // to find the mips and keeps the atomics cheap.
+    vec2 uvDx = dFdx(texCoord);
+    vec2 uvDy = dFdy(texCoord);
+    if((uint(gl_FragCoord.x) & 3u) == 0 && (uint(gl_FragCoord.y) & 3u) == 0)
+    {
+        RequestMip(materialInfoUBO.albedoStreamIndex, uvDx, uvDy);
+        RequestMip(materialInfoUBO.mrStreamIndex, uvDx, uvDy);
+        RequestMip(materialInfoUBO.normalStreamIndex, uvDx, uvDy);
+        RequestMip(materialInfoUBO.occlusionStreamIndex, uvDx, uvDy);
+        RequestMip(materialInfoUBO.emissiveStreamIndex, uvDx, uvDy);
+    }
+
+    if(useAlbedoMap)
     {
         albedoSample *= pow(texture(sampler2D(albedoImage, imageSampler), texCoord), vec4(2.2));
     }
-    if(materialInfoUBO.useMRMap)
+    if(useMRMap)
     {
         mrSample *= texture(sampler2D(mrImage, imageSampler), texCoord);
     }
-    if(materialInfoUBO.useNormalMap)
+    if(useNormalMap)
     {
         vec4 normalSample = texture(sampler2D(normalImage, imageSampler), texCoord) * materialInfoUBO.normalScale;
         normal = normalSample.xyz * 2.0 - 1.0;
         normal = normalize(TBN * normal);
     }
-    if(materialInfoUBO.useOcclusionMap)
+    if(useOcclusionMap)
     {
         occlusionSample *= texture(sampler2D(occlusionImage, imageSampler), texCoord);
     }
-    if(materialInfoUBO.useEmissiveMap)
+    if(useEmissiveMap)
     {
         emissiveSample *= pow(texture(sampler2D(emissiveImage, imageSampler), texCoord), vec4(2.2));
     }
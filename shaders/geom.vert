@@ -25,6 +25,8 @@ layout(location = 1) out vec3 normal;
 layout(location = 2) out vec2 texCoord;
 layout(location = 3) out mat3 TBN;
 
+invariant gl_Position;
+
 void main()
 {
     position = (ubo.model * vec4(inPosition, 1.0)).xyz;
@@ -1,24 +1,45 @@
 import os
+import shutil
 import subprocess
 import sys
-from distutils.version import LooseVersion
 
 # Set the base directory to search for shader files
 base_dir = os.path.dirname(os.path.realpath(__file__))
 
-# Find the latest version of VulkanSDK in the C:/VulkanSDK/ directory
-vulkan_sdk_base = "C:/VulkanSDK/"
-available_versions = [d for d in os.listdir(vulkan_sdk_base) if os.path.isdir(os.path.join(vulkan_sdk_base, d))]
+glslc_name = "glslc.exe" if os.name == "nt" else "glslc"
 
-if not available_versions:
-    print("No VulkanSDK versions found.")
-    sys.exit(1)
+def version_key(version):
+    return [int(part) if part.isdigit() else 0 for part in version.split(".")]
+
+# Looks on the PATH and in the SDK pointed to by VULKAN_SDK first, the SDK installers set both up on every platform.
+# Falls back on the latest version in C:/VulkanSDK/ for Windows installs that don't.
+def find_glslc():
+    on_path = shutil.which(glslc_name)
+    if on_path:
+        return on_path
+
+    sdk = os.environ.get("VULKAN_SDK")
+    if sdk:
+        for bin_dir in ("Bin", "bin"):
+            candidate = os.path.join(sdk, bin_dir, glslc_name)
+            if os.path.exists(candidate):
+                return candidate
 
-latest_version = max(available_versions, key=LooseVersion)
-glslc_path = os.path.join(vulkan_sdk_base, latest_version, "Bin", "glslc.exe")
+    vulkan_sdk_base = "C:/VulkanSDK/"
+    if os.path.isdir(vulkan_sdk_base):
+        available_versions = [d for d in os.listdir(vulkan_sdk_base) if os.path.isdir(os.path.join(vulkan_sdk_base, d))]
+        if available_versions:
+            latest_version = max(available_versions, key=version_key)
+            candidate = os.path.join(vulkan_sdk_base, latest_version, "Bin", glslc_name)
+            if os.path.exists(candidate):
+                return candidate
 
-if not os.path.exists(glslc_path):
-    print(f"glslc compiler not found at {glslc_path}.")
+    return None
+
+glslc_path = find_glslc()
+
+if glslc_path is None:
+    print("glslc compiler not found, install the Vulkan SDK or add glslc to the PATH.")
     sys.exit(1)
 
 # List of shader extensions and their corresponding output suffixes
@@ -29,11 +50,18 @@ shader_types = {
     ".tesc": "-tc.spv",
     ".tese": "-te.spv",
     ".comp": "-c.spv",
+    ".task": "-t.spv",
+    ".mesh": "-m.spv",
 }
 
+# Mesh shading requires SPIR-V 1.4
+spirv_1_4_types = { ".task", ".mesh" }
+
 # Function to compile a shader file
 def compile_shader(shader_path, output_path):
     command = [glslc_path, shader_path, "-o", output_path]
+    if os.path.splitext(shader_path)[1] in spirv_1_4_types:
+        command.append("--target-spv=spv1.4")
     try:
         subprocess.run(command, check=True)
         print(f"Successfully compiled {shader_path} to {output_path}")
@@ -0,0 +1,249 @@
+#include "benchmark.hpp"
+#include "spdlog/spdlog.h"
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+glm::vec3 YawPitch(const CameraKey& key)
+{
+    return glm::vec3{ key.yaw, key.pitch, 0.0f };
+}
+
+void WriteStatisticsMap(std::ostream& stream, const std::map<std::string, FrameStatistics, std::less<>>& statistics)
+{
+    stream << "{";
+    bool first = true;
+    for(const auto& [name, zone] : statistics)
+    {
+        stream << (first ? "\n" : ",\n") << "    \"" << name << "\": ";
+        zone.WriteJSON(stream);
+        first = false;
+    }
+    stream << (first ? "}" : "\n  }");
+}
+}
+
+BenchmarkDescription BenchmarkDescription::Load(const std::filesystem::path& path)
+{
+    std::ifstream file{ path };
+    if(!file)
+        throw std::runtime_error("Failed opening benchmark " + path.string());
+
+    BenchmarkDescription description{};
+
+    std::string line;
+    uint32_t lineNumber = 0;
+    while(std::getline(file, line))
+    {
+        ++lineNumber;
+        std::istringstream stream{ line };
+        std::string command;
+        if(!(stream >> command) || command.front() == '#')
+            continue;
+
+        bool valid = true;
+        if(command == "warmup")
+            valid = static_cast<bool>(stream >> description.warmupFrames);
+        else if(command == "frames")
+            valid = static_cast<bool>(stream >> description.measuredFrames);
+        else if(command == "timestep")
+            valid = static_cast<bool>(stream >> description.timestep);
+        else if(command == "model")
+        {
+            BenchmarkModel model{};
+            valid = static_cast<bool>(stream >> model.path);
+
+            glm::vec3 translation{ 0.0f };
+            float scale = 1.0f;
+            float yaw = 0.0f;
+            if(stream >> translation.x >> translation.y >> translation.z)
+                if(stream >> scale)
+                    stream >> yaw;
+
+            model.transform = glm::translate(glm::mat4{ 1.0f }, translation) *
+                              glm::rotate(glm::mat4{ 1.0f }, glm::radians(yaw), glm::vec3{ 0.0f, 1.0f, 0.0f }) *
+                              glm::scale(glm::mat4{ 1.0f }, glm::vec3{ scale });
+            description.models.emplace_back(std::move(model));
+        }
+        else if(command == "key")
+        {
+            CameraKey key{};
+            valid = static_cast<bool>(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch);
+            description.cameraPath.emplace_back(key);
+        }
+        else
+            valid = false;
+
+        if(!valid)
+            throw std::runtime_error(fmt::format("Invalid line {} in benchmark {}: {}", lineNumber, path.string(), line));
+    }
+
+    if(description.cameraPath.empty())
+        throw std::runtime_error("Benchmark " + path.string() + " has no camera keys!");
+
+    std::stable_sort(description.cameraPath.begin(), description.cameraPath.end(), [](const CameraKey& a, const CameraKey& b) { return a.time < b.time; });
+
+    return description;
+}
+
+CameraPath::CameraPath(std::vector<CameraKey> keys) :
+    _keys(std::move(keys))
+{
+}
+
+void CameraPath::Apply(float time, Camera& camera) const
+{
+    if(_keys.empty())
+        return;
+
+    auto next = std::upper_bound(_keys.begin(), _keys.end(), time, [](float time, const CameraKey& key) { return time < key.time; });
+    size_t i1 = next == _keys.begin() ? 0 : std::distance(_keys.begin(), next) - 1;
+    size_t i2 = std::min(i1 + 1, _keys.size() - 1);
+    size_t i0 = i1 == 0 ? 0 : i1 - 1;
+    size_t i3 = std::min(i2 + 1, _keys.size() - 1);
+
+    float span = _keys[i2].time - _keys[i1].time;
+    float t = span > 0.0f ? std::clamp((time - _keys[i1].time) / span, 0.0f, 1.0f) : 0.0f;
+
+    camera.position = CatmullRom(_keys[i0].position, _keys[i1].position, _keys[i2].position, _keys[i3].position, t);
+    glm::vec3 angles = CatmullRom(YawPitch(_keys[i0]), YawPitch(_keys[i1]), YawPitch(_keys[i2]), YawPitch(_keys[i3]), t);
+
+    camera.rotation = glm::angleAxis(glm::radians(angles.x), glm::vec3{ 0.0f, 1.0f, 0.0f }) *
+                      glm::angleAxis(glm::radians(angles.y), glm::vec3{ 1.0f, 0.0f, 0.0f });
+}
+
+float CameraPath::Yaw(const glm::quat& rotation)
+{
+    glm::vec3 forward = rotation * glm::vec3{ 0.0f, 0.0f, -1.0f };
+    return glm::degrees(std::atan2(-forward.x, -forward.z));
+}
+
+float CameraPath::Pitch(const glm::quat& rotation)
+{
+    glm::vec3 forward = rotation * glm::vec3{ 0.0f, 0.0f, -1.0f };
+    return glm::degrees(std::asin(std::clamp(forward.y, -1.0f, 1.0f)));
+}
+
+CameraPathRecorder::CameraPathRecorder(float interval) :
+    _interval(interval)
+{
+}
+
+void CameraPathRecorder::Record(float deltaTime, const Camera& camera)
+{
+    if(!_keys.empty())
+    {
+        _time += deltaTime;
+        if(_time < _keys.back().time + _interval)
+            return;
+    }
+
+    CameraKey key{ _time, camera.position, CameraPath::Yaw(camera.rotation), CameraPath::Pitch(camera.rotation) };
+
+    // Keeps the yaw continuous, so interpolating doesn't spin the long way around when it wraps.
+    if(!_keys.empty())
+        key.yaw = _keys.back().yaw + std::remainder(key.yaw - _keys.back().yaw, 360.0f);
+
+    _keys.emplace_back(key);
+}
+
+bool CameraPathRecorder::Write(const std::filesystem::path& path) const
+{
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed opening {} for writing the camera path", path.string());
+        return false;
+    }
+
+    file << "# Recorded camera path, add model lines to turn it into a benchmark.\n";
+    for(const auto& key : _keys)
+        file << "key " << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " " << key.yaw << " " << key.pitch << "\n";
+
+    spdlog::info("Wrote {} camera keys to {}", _keys.size(), path.string());
+    return true;
+}
+
+Benchmark::Benchmark(BenchmarkDescription description, std::filesystem::path source) :
+    _description(std::move(description)),
+    _source(std::move(source)),
+    _cameraPath(_description.cameraPath)
+{
+    spdlog::info("Running benchmark {}: {} warm-up and {} measured frames at {:.2f}ms per frame", _source.string(),
+                 _description.warmupFrames, _description.measuredFrames, _description.timestep);
+}
+
+void Benchmark::UpdateCamera(Camera& camera) const
+{
+    uint32_t measuredFrame = _frame >= _description.warmupFrames ? _frame - _description.warmupFrames : 0;
+    _cameraPath.Apply(measuredFrame * _description.timestep / 1000.0f, camera);
+}
+
+void Benchmark::EndFrame(uint64_t frameStart, const std::vector<GPUTiming>& gpuTimings)
+{
+    if(Finished())
+        return;
+
+    bool measured = _frame >= _description.warmupFrames;
+    ++_frame;
+    if(!measured)
+        return;
+
+    _frameTimes.Add((CPUProfiler::Now() - frameStart) / 1000000.0f);
+
+    _events.clear();
+    CPUProfiler::Instance().CollectEvents(frameStart, _events);
+
+    // Zones that run more than once in a frame are added together.
+    _zoneTotals.clear();
+    for(const auto& event : _events)
+        _zoneTotals[event.name] += (event.end - event.begin) / 1000000.0f;
+
+    for(const auto& [name, duration] : _zoneTotals)
+    {
+        auto it = _cpuZones.find(name);
+        if(it == _cpuZones.end())
+            it = _cpuZones.emplace(std::string{ name }, FrameStatistics{}).first;
+        it->second.Add(duration);
+    }
+
+    for(const auto& timing : gpuTimings)
+        _gpuPasses[timing.name].Add(timing.milliseconds);
+}
+
+bool Benchmark::WriteReport(const std::filesystem::path& path, glm::uvec2 resolution) const
+{
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed opening {} for writing the benchmark report", path.string());
+        return false;
+    }
+
+    file << "{\n"
+         << "  \"benchmark\": \"" << _source.generic_string() << "\",\n"
+         << "  \"width\": " << resolution.x << ",\n"
+         << "  \"height\": " << resolution.y << ",\n"
+         << "  \"warmup_frames\": " << _description.warmupFrames << ",\n"
+         << "  \"measured_frames\": " << _description.measuredFrames << ",\n"
+         << "  \"timestep_ms\": " << _description.timestep << ",\n"
+         << "  \"frame_time\": ";
+    _frameTimes.WriteJSON(file);
+    file << ",\n  \"cpu_zones\": ";
+    WriteStatisticsMap(file, _cpuZones);
+    file << ",\n  \"gpu_passes\": ";
+    WriteStatisticsMap(file, _gpuPasses);
+    file << "\n}\n";
+
+    spdlog::info("Benchmark finished, frame time P50 {:.2f}ms, P99 {:.2f}ms, report written to {}",
+                 _frameTimes.Percentile(0.5f), _frameTimes.Percentile(0.99f), path.string());
+    return true;
+}
@@ -0,0 +1,165 @@
+#include "cpu_profiler.hpp"
+#include "spdlog/spdlog.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+void WriteEvent(std::ofstream& file, const ProfileEvent& event, uint32_t processId, bool& first)
+{
+    if(!first)
+        file << ",\n";
+    first = false;
+
+    // Chrome trace timestamps are in microseconds.
+    file << "{\"name\":\"";
+    CPUProfiler::WriteEscaped(file, event.name);
+    file << "\",\"ph\":\"X\",\"pid\":" << processId << ",\"tid\":" << event.threadId
+         << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+}
+
+void WriteName(std::ofstream& file, std::string_view metadata, uint32_t processId, uint32_t threadId, std::string_view name, bool& first)
+{
+    if(!first)
+        file << ",\n";
+    first = false;
+
+    file << "{\"name\":\"" << metadata << "\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":" << threadId
+         << ",\"args\":{\"name\":\"";
+    CPUProfiler::WriteEscaped(file, name);
+    file << "\"}}";
+}
+}
+
+CPUProfiler& CPUProfiler::Instance()
+{
+    static CPUProfiler profiler;
+    return profiler;
+}
+
+uint64_t CPUProfiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CPUProfiler::Record(std::string_view name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer& buffer = AcquireThreadBuffer();
+
+    // Only this thread writes the buffer, the release makes the event visible to exports reading the head.
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % CPU_PROFILER_EVENTS_PER_THREAD] = ProfileEvent{ name, begin, end, buffer.threadId };
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CPUProfiler::CollectEvents(uint64_t since, std::vector<ProfileEvent>& events) const
+{
+    std::scoped_lock lock{ _buffersMutex };
+    for(const auto& buffer : _buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t count = std::min<uint64_t>(head, CPU_PROFILER_EVENTS_PER_THREAD);
+
+        // Zones are stored in the order they end, every older zone ended even earlier than the first one ending before
+        // the given time, so none of them can have begun after it.
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            const ProfileEvent& event = buffer->events[(head - 1 - i) % CPU_PROFILER_EVENTS_PER_THREAD];
+            if(event.end < since)
+                break;
+
+            if(event.begin >= since)
+                events.emplace_back(event);
+        }
+    }
+}
+
+CPUProfiler::ThreadBufferOwner::~ThreadBufferOwner()
+{
+    if(buffer)
+        buffer->inUse.store(false, std::memory_order_release);
+}
+
+CPUProfiler::ThreadBuffer& CPUProfiler::AcquireThreadBuffer()
+{
+    static thread_local ThreadBufferOwner owner;
+    if(owner.buffer)
+        return *owner.buffer;
+
+    std::scoped_lock lock{ _buffersMutex };
+    for(auto& buffer : _buffers)
+    {
+        bool expected = false;
+        if(buffer->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            owner.buffer = buffer.get();
+            break;
+        }
+    }
+
+    if(!owner.buffer)
+        owner.buffer = _buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+
+    // A reused buffer keeps the events of its previous thread, they were recorded with that thread's id.
+    owner.buffer->threadId = _nextThreadId++;
+
+    return *owner.buffer;
+}
+
+bool CPUProfiler::ExportChromeTrace(const std::filesystem::path& path, std::span<const ProfileEvent> gpuEvents) const
+{
+    constexpr uint32_t CPU_PROCESS_ID = 1;
+    constexpr uint32_t GPU_PROCESS_ID = 2;
+
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed opening {} for writing the trace", path.string());
+        return false;
+    }
+
+    // Steady clock timestamps in microseconds need more digits than the default precision.
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[\n";
+
+    bool first = true;
+    WriteName(file, "process_name", CPU_PROCESS_ID, 0, "CPU", first);
+    WriteName(file, "process_name", GPU_PROCESS_ID, 0, "GPU", first);
+    WriteName(file, "thread_name", GPU_PROCESS_ID, 0, "Graphics queue", first);
+
+    size_t eventCount = 0;
+    {
+        std::scoped_lock lock{ _buffersMutex };
+        for(const auto& buffer : _buffers)
+        {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t count = std::min<uint64_t>(head, CPU_PROFILER_EVENTS_PER_THREAD);
+            for(uint64_t i = head - count; i < head; ++i)
+                WriteEvent(file, buffer->events[i % CPU_PROFILER_EVENTS_PER_THREAD], CPU_PROCESS_ID, first);
+
+            eventCount += count;
+        }
+    }
+
+    for(const auto& event : gpuEvents)
+        WriteEvent(file, event, GPU_PROCESS_ID, first);
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    spdlog::info("Wrote {} CPU and {} GPU zones to {}", eventCount, gpuEvents.size(), path.string());
+    return true;
+}
+
+void CPUProfiler::WriteEscaped(std::ostream& stream, std::string_view text)
+{
+    for(char c : text)
+    {
+        if(c == '"' || c == '\\')
+            stream << '\\' << c;
+        else if(static_cast<unsigned char>(c) < 0x20)
+            stream << fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+        else
+            stream << c;
+    }
+}
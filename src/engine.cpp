@@ -20,6 +20,7 @@
 #include "util.hpp"
 #include "mesh_primitives.hpp"
 #include "pipelines/geometry_pipeline.hpp"
+#include "pipelines/culling_pipeline.hpp"
 #include "pipelines/lighting_pipeline.hpp"
 #include "pipelines/skydome_pipeline.hpp"
 #include "pipelines/tonemapping_pipeline.hpp"
@@ -27,10 +28,36 @@
 #include "gbuffers.hpp"
 #include "application.hpp"
 #include "single_time_commands.hpp"
+#include "texture_streamer.hpp"
+#include "memory_manager.hpp"
+#include "frame_allocator.hpp"
+#include "gpu_profiler.hpp"
+#include "cpu_profiler.hpp"
+#include "benchmark.hpp"
+#include "pipeline_compiler.hpp"
+#include "shaders/shader_compiler.hpp"
+#include "shaders/shader_watcher.hpp"
+
+namespace
+{
+// Pipeline cache shared by every run, written when the engine shuts down.
+constexpr std::string_view PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+// GLSL sources watched for hot reloading, the SPIR-V next to them is what the pipelines load.
+constexpr std::string_view SHADER_DIRECTORY = "shaders";
+
+template <typename T>
+bool IsReady(const std::future<T>& future)
+{
+    return future.valid() && future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+}
+}
 
 Engine::Engine(const InitInfo& initInfo, std::shared_ptr<Application> application) :
     _brain(initInfo)
 {
+    _startupTimeline.AddStage("Vulkan device", _startupTimeline.Origin(), CPUProfiler::Now());
+    StartupTimeline::Stage constructorStage{ _startupTimeline, "Engine constructor" };
+
     auto path = std::filesystem::current_path();
     spdlog::info("Current path: {}", path.string());
 
@@ -42,41 +69,83 @@ Engine::Engine(const InitInfo& initInfo, std::shared_ptr<Application> applicatio
 
     _swapChain = std::make_unique<SwapChain>(_brain, glm::uvec2{ initInfo.width, initInfo.height });
 
+    if(_brain.headless && !initInfo.frameDumpDirectory.empty())
+    {
+        _frameDumpDirectory = initInfo.frameDumpDirectory;
+        std::filesystem::create_directories(_frameDumpDirectory);
+        spdlog::info("Writing rendered frames to {}", _frameDumpDirectory.string());
+    }
+
+    _frameAllocator = std::make_unique<FrameAllocator>(_brain);
+    _gpuProfiler = std::make_unique<GPUProfiler>(_brain);
+    _traceFile = initInfo.traceFile;
+    _exportTraceOnExit = !initInfo.traceFile.empty();
+    if(_traceFile.empty())
+        _traceFile = "trace.json";
+
+    _statisticsFile = initInfo.statisticsFile;
+    _performanceTracker.SetFrameLogEnabled(!_statisticsFile.empty());
+
+    if(!initInfo.benchmarkFile.empty())
+    {
+        _benchmark = std::make_unique<Benchmark>(BenchmarkDescription::Load(initInfo.benchmarkFile), initInfo.benchmarkFile);
+        _benchmarkReport = initInfo.benchmarkReport;
+    }
+
+    if(!initInfo.recordPathFile.empty())
+    {
+        _cameraRecorder = std::make_unique<CameraPathRecorder>();
+        _recordPathFile = initInfo.recordPathFile;
+    }
+
+    _startupReportFile = initInfo.startupReportFile;
+
     CreateDescriptorSetLayout();
     InitializeCameraUBODescriptors();
-    InitializeHDRTarget();
-    LoadEnvironmentMap();
 
-    _modelLoader = std::make_unique<ModelLoader>(_brain, _materialDescriptorSetLayout);
-
-    SingleTimeCommands commandBufferPrimitive{ _brain };
-    MeshPrimitiveHandle uvSphere = _modelLoader->LoadPrimitive(GenerateUVSphere(32, 32), commandBufferPrimitive);
-    commandBufferPrimitive.Submit();
+    // Decoding the environment map is the slowest part of starting up, it's staged while the first frames show up.
+    _pendingEnvironmentMap = std::async(std::launch::async, [this]()
+    {
+        StartupTimeline::Stage stage{ _startupTimeline, "Decode environment map" };
+        return SingleTimeCommands::StageHDRImage(_brain, "assets/hdri/industrial_sunset_02_puresky_4k.hdr");
+    });
+
+    _memoryManager = std::make_unique<MemoryManager>(_brain);
+    _textureStreamer = std::make_unique<TextureStreamer>(_brain, DEFAULT_TEXTURE_BUDGET);
+    // Streamed mips are the only memory that can be given back without visible artifacts beyond blurrier textures.
+    _memoryManager->AddPressureCallback([this](vk::DeviceSize bytesToFree)
+    {
+        vk::DeviceSize residentBytes = _textureStreamer->ResidentBytes();
+        vk::DeviceSize budget = std::max(residentBytes > bytesToFree ? residentBytes - bytesToFree : 0, MIN_TEXTURE_BUDGET);
+        if(budget >= _textureStreamer->Budget())
+            return;
 
-    _gBuffers = std::make_unique<GBuffers>(_brain, _swapChain->GetImageSize());
-    _geometryPipeline = std::make_unique<GeometryPipeline>(_brain, *_gBuffers, _materialDescriptorSetLayout, _cameraStructure);
-    _skydomePipeline = std::make_unique<SkydomePipeline>(_brain, std::move(uvSphere), _cameraStructure, _hdrTarget, _environmentMap);
-    _tonemappingPipeline = std::make_unique<TonemappingPipeline>(_brain, _hdrTarget, *_swapChain);
-    _iblPipeline = std::make_unique<IBLPipeline>(_brain, _environmentMap);
-    _lightingPipeline = std::make_unique<LightingPipeline>(_brain, *_gBuffers, _hdrTarget, _cameraStructure, _iblPipeline->IrradianceMap(), _iblPipeline->PrefilterMap(), _iblPipeline->BRDFLUTMap());
+        spdlog::warn("Lowering texture budget to {} MB due to memory pressure", budget / (1024 * 1024));
+        _textureStreamer->SetBudget(budget);
+    });
+    _modelLoader = std::make_unique<ModelLoader>(_brain, _materialDescriptorSetLayout, _textureStreamer.get());
 
-    SingleTimeCommands commandBufferIBL{ _brain };
-    _iblPipeline->RecordCommands(commandBufferIBL.CommandBuffer());
-    commandBufferIBL.Submit();
+    LoadScene();
 
-    CreateCommandBuffers();
-    CreateSyncObjects();
+    _gBuffers = std::make_unique<GBuffers>(_brain, _swapChain->GetImageSize(), initInfo.hdrPrecision);
 
-    _scene.models.emplace_back(std::make_shared<ModelHandle>(_modelLoader->Load("assets/models/DamagedHelmet.glb")));
-    _scene.models.emplace_back(std::make_shared<ModelHandle>(_modelLoader->Load("assets/models/ABeautifulGame/ABeautifulGame.gltf")));
+    // Pipelines compile on worker threads while the loading screen is shown, UpdateStartup waits for them.
+    _pipelineCompiler = std::make_unique<PipelineCompiler>(_brain, PIPELINE_CACHE_FILE, &_startupTimeline);
+    _cullingPipeline = std::make_unique<CullingPipeline>(_brain, *_pipelineCompiler, *_gBuffers, _cameraStructure, *_frameAllocator);
+    _geometryPipeline = std::make_unique<GeometryPipeline>(_brain, *_pipelineCompiler, *_gBuffers, _materialDescriptorSetLayout, _cameraStructure, *_cullingPipeline, *_textureStreamer, *_frameAllocator);
+    _tonemappingPipeline = std::make_unique<TonemappingPipeline>(_brain, *_pipelineCompiler, _gBuffers->HDR(), *_swapChain);
 
-    glm::vec3 scale{0.05f};
-    glm::mat4 rotation{glm::quat(glm::vec3(0.0f, 90.0f, 0.0f))};
-    glm::vec3 translate{-0.275f, 0.06f, -0.025f};
-    glm::mat4 transform = glm::translate(glm::mat4{1.0f}, translate) * rotation * glm::scale(glm::mat4{1.0f}, scale);
+    // Headless runs render a fixed set of frames, reloading would only make them differ from each other.
+    if(!_brain.headless)
+    {
+        if(shader::GLSL_COMPILER_AVAILABLE)
+            _shaderWatcher = std::make_unique<ShaderWatcher>(std::filesystem::path{ SHADER_DIRECTORY });
+        else
+            spdlog::info("Shader hot reloading is disabled, the build didn't find shaderc");
+    }
 
-    _scene.gameObjects.emplace_back(transform, _scene.models[0]);
-    _scene.gameObjects.emplace_back(glm::mat4{1.0f}, _scene.models[1]);
+    CreateCommandBuffers();
+    CreateSyncObjects();
 
     vk::Format format = _swapChain->GetFormat();
     vk::PipelineRenderingCreateInfoKHR pipelineRenderingCreateInfoKhr{};
@@ -116,11 +185,14 @@ Engine::Engine(const InitInfo& initInfo, std::shared_ptr<Application> applicatio
 
     _application->SetMouseHidden(true);
 
-    spdlog::info("Successfully initialized engine!");
+    spdlog::info("Successfully initialized engine, loading the scene in the background");
 }
 
 void Engine::Run()
 {
+    PROFILE_ZONE("Engine::Run");
+
+    uint64_t frameStart = CPUProfiler::Now();
     auto currentFrameTime = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float, std::milli> deltaTime = currentFrameTime - _lastFrameTime;
     _lastFrameTime = currentFrameTime;
@@ -134,55 +206,66 @@ void Engine::Run()
         return;
     }
 
+    // The previous frame is done with the device, so this is a frame boundary.
+    UpdateStartup();
+
     glm::ivec2 mousePos;
     _application->GetInputManager().GetMousePosition(mousePos.x, mousePos.y);
 
-    float yaw = (mousePos.x - _lastMousePos.x) * -0.1f;
-    float pitch = (_lastMousePos.y - mousePos.y) * 0.1f;
-    pitch = std::clamp(pitch, -89.0f, 89.0f);
+    if(_benchmark)
+        _benchmark->UpdateCamera(_scene.camera);
+    else
+        UpdateCameraFromInput(deltaTimeMS, mousePos);
 
-    glm::quat yawQuat = glm::angleAxis(glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-    glm::quat pitchQuat = glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
-    glm::quat rollQuat = glm::angleAxis(glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    if(_cameraRecorder)
+        _cameraRecorder->Record(deltaTimeMS / 1000.0f, _scene.camera);
 
-    _scene.camera.rotation = yawQuat * _scene.camera.rotation;
-    _scene.camera.rotation = _scene.camera.rotation * pitchQuat;
-    _scene.camera.rotation = rollQuat * _scene.camera.rotation;
+    if (_application->GetInputManager().IsKeyPressed(InputManager::Key::Escape))
+        Quit();
 
-    _scene.camera.rotation = glm::normalize(_scene.camera.rotation);
+    // Loading stages and pipeline compiles write zones from worker threads, the trace is only exported once those are done
+    // and the main thread is the only one writing zones.
+    if(_startupComplete && _pipelineCompiler->Idle() && _application->GetInputManager().IsKeyPressed(InputManager::Key::P))
+        ExportTrace();
 
-    const float speed = 0.0005f * deltaTimeMS;
-    glm::vec3 movement{ 0.0f };
-    if(_application->GetInputManager().IsKeyHeld(InputManager::Key::W))
-        movement += glm::vec3{0.0f, 0.0f, -1.0f};
-    else if(_application->GetInputManager().IsKeyHeld(InputManager::Key::S))
-        movement += glm::vec3{0.0f, 0.0f, 1.0f};
-    else if(_application->GetInputManager().IsKeyHeld(InputManager::Key::A))
-        movement += glm::vec3{-1.0f, 0.0f, 0.0f};
-    else if(_application->GetInputManager().IsKeyHeld(InputManager::Key::D))
-        movement += glm::vec3{1.0f, 0.0f, 0.0f};
+    {
+        PROFILE_ZONE("Wait for frame fence");
+        util::VK_ASSERT(_brain.device.waitForFences(1, &_inFlightFences[_currentFrame], vk::True, std::numeric_limits<uint64_t>::max()),
+                        "Failed waiting on in flight fence!");
+    }
 
-    _scene.camera.position += _scene.camera.rotation * movement * deltaTimeMS * speed;
+    _frameAllocator->Reset(_currentFrame);
 
-    if (_application->GetInputManager().IsKeyPressed(InputManager::Key::Escape))
-        Quit();
+    if(_shaderWatcher)
+        for(const auto& shaderPath : _shaderWatcher->TakeRecompiled())
+            _pipelineCompiler->Reload(shaderPath);
+    _pipelineCompiler->Update();
 
-    CameraUBO cameraUBO = CalculateCamera(_scene.camera);
-    std::memcpy(_cameraStructure.mappedPtrs[_currentFrame], &cameraUBO, sizeof(CameraUBO));
+    vk::DeviceSize cameraOffset;
+    *_frameAllocator->Allocate<CameraUBO>(_currentFrame, 1, cameraOffset) = CalculateCamera(_scene.camera);
+    _cameraStructure.offsets[_currentFrame] = static_cast<uint32_t>(cameraOffset);
 
-    util::VK_ASSERT(_brain.device.waitForFences(1, &_inFlightFences[_currentFrame], vk::True, std::numeric_limits<uint64_t>::max()),
-                    "Failed waiting on in flight fence!");
+    // Swapping streamed textures rewrites material descriptor sets, none of the other frames may still be using them. Every
+    // frame ends by waiting for the device to be idle, so nothing submitted is still running here.
+    if(_textureStreamer->BatchReady())
+    {
+        PROFILE_ZONE("Apply streaming batch");
+        _textureStreamer->ApplyPendingBatch();
+    }
+    {
+        PROFILE_ZONE("Update streaming and memory");
+        _textureStreamer->Update(_currentFrame);
+        _memoryManager->Update();
+    }
+    _performanceTracker.SetMemoryStatistics(_memoryManager->Statistics());
+    _performanceTracker.SetGPUTimings(_gpuProfiler->Timings());
 
     uint32_t imageIndex;
-    vk::Result result = _brain.device.acquireNextImageKHR(_swapChain->GetSwapChain(), std::numeric_limits<uint64_t>::max(),
-                                                    _imageAvailableSemaphores[_currentFrame], nullptr, &imageIndex);
+    vk::Result result = _swapChain->AcquireNextImage(_imageAvailableSemaphores[_currentFrame], imageIndex);
 
     if(result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
     {
-        _swapChain->Resize(_application->DisplaySize());
-        _gBuffers->Resize(_application->DisplaySize());
-        _lightingPipeline->UpdateGBufferViews();
-
+        Resize();
         return;
     } else
         util::VK_ASSERT(result, "Failed acquiring next image from swap chain!");
@@ -195,6 +278,41 @@ void Engine::Run()
 
     _performanceTracker.Render();
 
+    if(!_startupComplete)
+    {
+        ImGui::Begin("Loading");
+        ImGui::Text("Renderer: %s", RendererReady() ? "ready" : "loading");
+        ImGui::Text("Models left: %zu", _pendingModels.size());
+        ImGui::End();
+    }
+
+    if(RendererReady())
+    {
+        ImGui::Begin("Settings");
+        bool depthPrepass = _geometryPipeline->DepthPrepassEnabled();
+        if(ImGui::Checkbox("Depth pre-pass", &depthPrepass))
+            _geometryPipeline->SetDepthPrepassEnabled(depthPrepass);
+
+        ImGui::BeginDisabled(!_brain.meshShadersSupported);
+        bool meshShading = _geometryPipeline->MeshShadingEnabled();
+        if(ImGui::Checkbox("Mesh shading", &meshShading))
+            _geometryPipeline->SetMeshShadingEnabled(meshShading);
+        ImGui::EndDisabled();
+
+        int32_t budgetMB = _textureStreamer->Budget() / (1024 * 1024);
+        if(ImGui::SliderInt("Texture budget (MB)", &budgetMB, MIN_TEXTURE_BUDGET / (1024 * 1024), 4096))
+            _textureStreamer->SetBudget(static_cast<vk::DeviceSize>(budgetMB) * 1024 * 1024);
+        ImGui::Text("Streamed textures: %zu, resident %.1f MB", _textureStreamer->StreamedTextureCount(), _textureStreamer->ResidentBytes() / (1024.0f * 1024.0f));
+
+        ImGui::Text("HDR target: %s, error up to %.3f%%", vk::to_string(_gBuffers->HDR().format).c_str(), _gBuffers->HDRQuantizationError() * 100.0f);
+        ImGui::Text("Frame allocator: %.1f KB used in %s memory", _frameAllocator->UsedBytes(_currentFrame) / 1024.0f, _frameAllocator->DeviceLocal() ? "device local" : "host");
+
+        int32_t memoryBudgetMB = _memoryManager->BudgetOverride() / (1024 * 1024);
+        if(ImGui::SliderInt("VRAM budget override (MB)", &memoryBudgetMB, 0, 16384, memoryBudgetMB == 0 ? "Device budget" : "%d"))
+            _memoryManager->SetBudgetOverride(static_cast<vk::DeviceSize>(memoryBudgetMB) * 1024 * 1024);
+        ImGui::End();
+    }
+
     ImGui::Render();
 
     _commandBuffers[_currentFrame].reset();
@@ -204,36 +322,44 @@ void Engine::Run()
     vk::SubmitInfo submitInfo{};
     vk::Semaphore waitSemaphores[] = { _imageAvailableSemaphores[_currentFrame] };
     vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
-    submitInfo.waitSemaphoreCount = 1;
+    // Offscreen images are ready right away and nothing waits to present them.
+    submitInfo.waitSemaphoreCount = _brain.headless ? 0 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &_commandBuffers[_currentFrame];
 
     vk::Semaphore signalSemaphores[] = { _renderFinishedSemaphores[_currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = _brain.headless ? 0 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    util::VK_ASSERT(_brain.graphicsQueue.submit(1, &submitInfo, _inFlightFences[_currentFrame]), "Failed submitting to graphics queue!");
+    {
+        PROFILE_ZONE("Submit and present");
+        util::VK_ASSERT(_brain.graphicsQueue.submit(1, &submitInfo, _inFlightFences[_currentFrame]), "Failed submitting to graphics queue!");
+        _gpuProfiler->MarkSubmitted(_currentFrame);
 
-    vk::PresentInfoKHR presentInfo{};
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+        result = _swapChain->Present(_renderFinishedSemaphores[_currentFrame], imageIndex);
+    }
 
-    vk::SwapchainKHR swapchains[] = { _swapChain->GetSwapChain() };
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapchains;
-    presentInfo.pImageIndices = &imageIndex;
+    {
+        PROFILE_ZONE("Wait for device idle");
+        _brain.device.waitIdle();
+    }
+    // Read while the frame is still current, so the GPU timings belong to the same frame as the CPU timings.
+    _gpuProfiler->Update(_currentFrame);
 
-    result = _brain.presentQueue.presentKHR(&presentInfo);
+    if(!_firstFramePresented)
+    {
+        _firstFramePresented = true;
+        _startupTimeline.AddMilestone("First frame");
+    }
 
-    _brain.device.waitIdle();
+    if(!_frameDumpDirectory.empty())
+        _swapChain->WriteReadback(imageIndex, _frameDumpDirectory / fmt::format("frame_{:05}.ppm", _dumpedFrameCount++));
 
     if(result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || _swapChain->GetImageSize() != _application->DisplaySize())
     {
-        _swapChain->Resize(_application->DisplaySize());
-        _gBuffers->Resize(_application->DisplaySize());
-        _lightingPipeline->UpdateGBufferViews();
+        Resize();
     }
     else
     {
@@ -244,17 +370,212 @@ void Engine::Run()
 
     _performanceTracker.Update();
     _lastMousePos = mousePos;
+
+    // Frames of the loading screen aren't part of the benchmark.
+    if(_benchmark && _startupComplete)
+    {
+        _benchmark->EndFrame(frameStart, _gpuProfiler->Timings());
+        if(_benchmark->Finished())
+        {
+            _benchmark->WriteReport(_benchmarkReport, _swapChain->GetImageSize());
+            Quit();
+        }
+    }
+}
+
+void Engine::LoadScene()
+{
+    std::vector<BenchmarkModel> models;
+
+    // Benchmarks without models of their own run on the default scene.
+    if(_benchmark && !_benchmark->Description().models.empty())
+        models = _benchmark->Description().models;
+    else
+    {
+        glm::vec3 scale{0.05f};
+        glm::mat4 rotation{glm::quat(glm::vec3(0.0f, 90.0f, 0.0f))};
+        glm::vec3 translate{-0.275f, 0.06f, -0.025f};
+        glm::mat4 transform = glm::translate(glm::mat4{1.0f}, translate) * rotation * glm::scale(glm::mat4{1.0f}, scale);
+
+        models.emplace_back(BenchmarkModel{ "assets/models/DamagedHelmet.glb", transform });
+        models.emplace_back(BenchmarkModel{ "assets/models/ABeautifulGame/ABeautifulGame.gltf", glm::mat4{1.0f} });
+    }
+
+    // Every model is processed on a thread of its own, models listed more than once share their meshes and textures.
+    for(const auto& model : models)
+    {
+        auto it = std::find_if(_pendingModels.begin(), _pendingModels.end(), [&model](const auto& pending) { return pending.path == model.path; });
+        if(it != _pendingModels.end())
+        {
+            it->instances.emplace_back(model.transform);
+            continue;
+        }
+
+        PendingModel& pending = _pendingModels.emplace_back();
+        pending.path = model.path;
+        pending.instances.emplace_back(model.transform);
+        pending.processed = std::async(std::launch::async, [this, path = model.path]()
+        {
+            StartupTimeline::Stage stage{ _startupTimeline, "Process " + path };
+            return _modelLoader->Process(path, false);
+        });
+    }
+}
+
+void Engine::UpdateStartup()
+{
+    if(_startupComplete)
+        return;
+
+    // Headless runs render a fixed number of frames that should all show the scene, so they wait for everything at once.
+    // Otherwise one stage runs per frame, which keeps the loading screen responsive.
+    bool wait = _brain.headless;
+    while(AdvanceStartup(wait) && wait)
+    {
+    }
+}
+
+bool Engine::AdvanceStartup(bool wait)
+{
+    // Nothing is created before the first frame, so the window shows something as early as possible.
+    if(!_firstFramePresented && !wait)
+        return false;
+
+    if(wait && _pendingEnvironmentMap.valid())
+        _pendingEnvironmentMap.wait();
+
+    if(IsReady(_pendingEnvironmentMap))
+    {
+        StartupTimeline::Stage stage{ _startupTimeline, "Upload environment map" };
+        CreateEnvironmentPipelines(_pendingEnvironmentMap.get());
+        return true;
+    }
+
+    // Recording waits for pipelines that are still compiling, so the scene is only rendered once none are left.
+    if(!_rendererReady && _iblPipeline && (wait || _pipelineCompiler->Idle()))
+    {
+        StartupTimeline::Stage stage{ _startupTimeline, "Precompute IBL" };
+        // Frames wait for the device to be idle, so the precompute can't overlap with them and runs at this frame boundary.
+        SingleTimeCommands commandBuffer{ _brain };
+        _iblPipeline->RecordCommands(commandBuffer.CommandBuffer());
+        commandBuffer.Submit();
+
+        _rendererReady = true;
+        return true;
+    }
+
+    for(auto it = _pendingModels.begin(); it != _pendingModels.end(); ++it)
+    {
+        if(wait)
+            it->processed.wait();
+
+        if(!IsReady(it->processed))
+            continue;
+
+        StartupTimeline::Stage stage{ _startupTimeline, "Upload " + it->path };
+        auto& handle = _scene.models.emplace_back(std::make_shared<ModelHandle>(_modelLoader->Upload(it->processed.get())));
+        _geometryPipeline->PrepareVariants(*handle);
+        for(const auto& transform : it->instances)
+            _scene.gameObjects.emplace_back(transform, handle);
+
+        _pendingModels.erase(it);
+        return true;
+    }
+
+    if(!RendererReady() || !_pendingModels.empty())
+        return false;
+
+    _startupComplete = true;
+    _pipelineCompiler->SetTimeline(nullptr);
+    _startupTimeline.AddMilestone("Fully loaded");
+    _startupTimeline.Report();
+    if(!_startupReportFile.empty())
+        _startupTimeline.ExportJSON(_startupReportFile);
+
+    return false;
+}
+
+void Engine::Resize()
+{
+    _swapChain->Resize(_application->DisplaySize());
+    _gBuffers->Resize(_application->DisplaySize());
+
+    // The lighting pipeline waits for the environment map, it picks up the new size when it's created.
+    if(_lightingPipeline)
+        _lightingPipeline->UpdateGBufferViews();
+    _tonemappingPipeline->UpdateHDRView();
+    _cullingPipeline->RecreateDepthPyramid();
+}
+
+void Engine::UpdateCameraFromInput(float deltaTimeMS, glm::ivec2 mousePos)
+{
+    float yaw = (mousePos.x - _lastMousePos.x) * -0.1f;
+    float pitch = (_lastMousePos.y - mousePos.y) * 0.1f;
+    pitch = std::clamp(pitch, -89.0f, 89.0f);
+
+    glm::quat yawQuat = glm::angleAxis(glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::quat pitchQuat = glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::quat rollQuat = glm::angleAxis(glm::radians(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    _scene.camera.rotation = yawQuat * _scene.camera.rotation;
+    _scene.camera.rotation = _scene.camera.rotation * pitchQuat;
+    _scene.camera.rotation = rollQuat * _scene.camera.rotation;
+
+    _scene.camera.rotation = glm::normalize(_scene.camera.rotation);
+
+    const float speed = 0.0005f * deltaTimeMS;
+    glm::vec3 movement{ 0.0f };
+    if(_application->GetInputManager().IsKeyHeld(InputManager::Key::W))
+        movement += glm::vec3{0.0f, 0.0f, -1.0f};
+    else if(_application->GetInputManager().IsKeyHeld(InputManager::Key::S))
+        movement += glm::vec3{0.0f, 0.0f, 1.0f};
+    else if(_application->GetInputManager().IsKeyHeld(InputManager::Key::A))
+        movement += glm::vec3{-1.0f, 0.0f, 0.0f};
+    else if(_application->GetInputManager().IsKeyHeld(InputManager::Key::D))
+        movement += glm::vec3{1.0f, 0.0f, 0.0f};
+
+    _scene.camera.position += _scene.camera.rotation * movement * deltaTimeMS * speed;
 }
 
 Engine::~Engine()
 {
+    // Background loading still uses the model loader and the device.
+    for(auto& pending : _pendingModels)
+        if(pending.processed.valid())
+            pending.processed.wait();
+
+    if(_pendingEnvironmentMap.valid())
+    {
+        try
+        {
+            StagedImage stagedImage = _pendingEnvironmentMap.get();
+            util::DestroyBuffer(_brain.vmaAllocator, stagedImage.buffer, stagedImage.allocation);
+        }
+        catch(const std::exception& e)
+        {
+            spdlog::error(e.what());
+        }
+    }
+
+    if(_exportTraceOnExit)
+        ExportTrace();
+
+    if(_cameraRecorder)
+        _cameraRecorder->Write(_recordPathFile);
+
+    if(!_statisticsFile.empty())
+    {
+        _performanceTracker.ExportCSV(std::filesystem::path{ _statisticsFile }.replace_extension(".csv"));
+        _performanceTracker.ExportJSON(std::filesystem::path{ _statisticsFile }.replace_extension(".json"));
+    }
+
     _application->ShutdownImGui();
     ImGui_ImplVulkan_Shutdown();
     ImPlot::DestroyContext();
     ImGui::DestroyContext();
 
     _brain.device.destroy(_environmentMap.imageView);
-    vmaDestroyImage(_brain.vmaAllocator, _environmentMap.image, _environmentMap.imageAllocation);
+    util::DestroyImage(_brain.vmaAllocator, _environmentMap.image, _environmentMap.imageAllocation);
 
     for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
     {
@@ -269,30 +590,17 @@ Engine::~Engine()
         {
             for(auto& primitive : mesh->primitives)
             {
-                vmaDestroyBuffer(_brain.vmaAllocator, primitive.vertexBuffer, primitive.vertexBufferAllocation);
-                vmaDestroyBuffer(_brain.vmaAllocator, primitive.indexBuffer, primitive.indexBufferAllocation);
+                util::DestroyBuffer(_brain.vmaAllocator, primitive.vertexBuffer, primitive.vertexBufferAllocation);
+                util::DestroyBuffer(_brain.vmaAllocator, primitive.positionBuffer, primitive.positionBufferAllocation);
+                util::DestroyBuffer(_brain.vmaAllocator, primitive.meshletBuffer, primitive.meshletBufferAllocation);
+                util::DestroyBuffer(_brain.vmaAllocator, primitive.meshletVertexBuffer, primitive.meshletVertexBufferAllocation);
+                util::DestroyBuffer(_brain.vmaAllocator, primitive.meshletTriangleBuffer, primitive.meshletTriangleBufferAllocation);
+                util::DestroyBuffer(_brain.vmaAllocator, primitive.indexBuffer, primitive.indexBufferAllocation);
             }
         }
-        for(auto& texture : model->textures)
-        {
-            _brain.device.destroy(texture->imageView);
-            vmaDestroyImage(_brain.vmaAllocator, texture->image, texture->imageAllocation);
-        }
-        for(auto& material : model->materials)
-        {
-            vmaDestroyBuffer(_brain.vmaAllocator, material->materialUniformBuffer, material->materialUniformAllocation);
-        }
     }
 
-    _brain.device.destroy(_hdrTarget.imageViews);
-    vmaDestroyImage(_brain.vmaAllocator, _hdrTarget.images, _hdrTarget.allocations);
-
     _brain.device.destroy(_cameraStructure.descriptorSetLayout);
-    for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-    {
-        vmaUnmapMemory(_brain.vmaAllocator, _cameraStructure.allocations[i]);
-        vmaDestroyBuffer(_brain.vmaAllocator, _cameraStructure.buffers[i], _cameraStructure.allocations[i]);
-    }
 
     _swapChain.reset();
 
@@ -312,32 +620,122 @@ void Engine::CreateCommandBuffers()
 
 void Engine::RecordCommandBuffer(const vk::CommandBuffer &commandBuffer, uint32_t swapChainImageIndex)
 {
+    PROFILE_ZONE("Engine::RecordCommandBuffer");
+
     vk::CommandBufferBeginInfo commandBufferBeginInfo{};
     util::VK_ASSERT(commandBuffer.begin(&commandBufferBeginInfo), "Failed to begin recording command buffer!");
 
+    _gpuProfiler->RecordBeginFrame(commandBuffer, _currentFrame);
+
+    _textureStreamer->RecordFeedbackCommands(commandBuffer, _currentFrame);
+
     util::TransitionImageLayout(commandBuffer, _swapChain->GetImage(swapChainImageIndex), _swapChain->GetFormat(), vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
-    util::TransitionImageLayout(commandBuffer, _hdrTarget.images, _hdrTarget.format, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
+
+    if(RendererReady())
+        RecordSceneCommands(commandBuffer, swapChainImageIndex);
+    else
+        RecordLoadingCommands(commandBuffer, swapChainImageIndex);
+
+    if(_brain.headless)
+    {
+        util::TransitionImageLayout(commandBuffer, _swapChain->GetImage(swapChainImageIndex), _swapChain->GetFormat(), vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eTransferSrcOptimal);
+        if(!_frameDumpDirectory.empty())
+            _swapChain->RecordReadbackCommands(commandBuffer, swapChainImageIndex);
+    }
+    else
+        util::TransitionImageLayout(commandBuffer, _swapChain->GetImage(swapChainImageIndex), _swapChain->GetFormat(), vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
+
+    commandBuffer.end();
+}
+
+void Engine::RecordSceneCommands(vk::CommandBuffer commandBuffer, uint32_t swapChainImageIndex)
+{
     util::TransitionImageLayout(commandBuffer, _gBuffers->GBuffersImageArray(),
                                 _gBuffers->GBufferFormat(), vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal,
                                 DEFERRED_ATTACHMENT_COUNT);
+    _gBuffers->RecordBeginDepthCommands(commandBuffer);
+
+    {
+        PROFILE_ZONE("GeometryPipeline::PrepareDrawCalls");
+        _geometryPipeline->PrepareDrawCalls(_currentFrame, _scene);
+    }
 
-    _geometryPipeline->RecordCommands(commandBuffer, _currentFrame, _scene);
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Culling");
+    _cullingPipeline->RecordCommands(commandBuffer, _currentFrame, _geometryPipeline->DrawCalls(), CullingPhase::eEarly);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Geometry");
+    _geometryPipeline->RecordCommands(commandBuffer, _currentFrame, _scene, CullingPhase::eEarly);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
+
+    util::TransitionImageLayout(commandBuffer, _gBuffers->DepthImage(), _gBuffers->DepthFormat(), vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Depth pyramid");
+    _cullingPipeline->RecordDepthPyramidCommands(commandBuffer);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
+    util::TransitionImageLayout(commandBuffer, _gBuffers->DepthImage(), _gBuffers->DepthFormat(), vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+    // The late geometry pass loads the G-buffers written by the early pass.
+    vk::MemoryBarrier colorBarrier{};
+    colorBarrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    colorBarrier.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                  vk::DependencyFlags{ 0 }, 1, &colorBarrier, 0, nullptr, 0, nullptr);
+
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Culling");
+    _cullingPipeline->RecordCommands(commandBuffer, _currentFrame, _geometryPipeline->DrawCalls(), CullingPhase::eLate);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Geometry");
+    _geometryPipeline->RecordCommands(commandBuffer, _currentFrame, _scene, CullingPhase::eLate);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
 
 
     util::TransitionImageLayout(commandBuffer, _gBuffers->GBuffersImageArray(),
                                 _gBuffers->GBufferFormat(), vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
                                 DEFERRED_ATTACHMENT_COUNT);
 
+    // Depth isn't needed anymore, which frees the memory it shares with the HDR target.
+    _gBuffers->RecordBeginHDRCommands(commandBuffer);
+
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Skydome");
     _skydomePipeline->RecordCommands(commandBuffer, _currentFrame);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Lighting");
     _lightingPipeline->RecordCommands(commandBuffer, _currentFrame);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
 
-    util::TransitionImageLayout(commandBuffer, _hdrTarget.images, _hdrTarget.format, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    util::TransitionImageLayout(commandBuffer, _gBuffers->HDR().images, _gBuffers->HDR().format, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
 
+    _gpuProfiler->RecordBeginZone(commandBuffer, _currentFrame, "Tonemapping");
     _tonemappingPipeline->RecordCommands(commandBuffer, _currentFrame, swapChainImageIndex);
+    _gpuProfiler->RecordEndZone(commandBuffer, _currentFrame);
+}
 
-    util::TransitionImageLayout(commandBuffer, _swapChain->GetImage(swapChainImageIndex), _swapChain->GetFormat(), vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR);
+void Engine::RecordLoadingCommands(vk::CommandBuffer commandBuffer, uint32_t swapChainImageIndex) const
+{
+    vk::RenderingAttachmentInfoKHR colorAttachmentInfo{};
+    colorAttachmentInfo.imageView = _swapChain->GetImageView(swapChainImageIndex);
+    colorAttachmentInfo.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    colorAttachmentInfo.loadOp = vk::AttachmentLoadOp::eClear;
+    colorAttachmentInfo.storeOp = vk::AttachmentStoreOp::eStore;
+    colorAttachmentInfo.clearValue.color = vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 1.0f };
+
+    vk::RenderingInfoKHR renderingInfo{};
+    renderingInfo.renderArea.extent = _swapChain->GetExtent();
+    renderingInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachmentInfo;
+    renderingInfo.layerCount = 1;
+
+    // Only the ImGui windows, which show the loading progress.
+    util::BeginLabel(commandBuffer, "Loading screen", glm::vec3{ 128.0f, 128.0f, 128.0f } / 255.0f, _brain.dldi);
+    commandBuffer.beginRenderingKHR(&renderingInfo, _brain.dldi);
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+    commandBuffer.endRenderingKHR(_brain.dldi);
+    util::EndLabel(commandBuffer, _brain.dldi);
+}
 
-    commandBuffer.end();
+void Engine::ExportTrace() const
+{
+    CPUProfiler::Instance().ExportChromeTrace(_traceFile, _gpuProfiler->Events());
 }
 
 void Engine::CreateSyncObjects()
@@ -367,9 +765,11 @@ void Engine::CreateDescriptorSetLayout()
 
     vk::DescriptorSetLayoutBinding cameraUBODescriptorSetBinding{};
     cameraUBODescriptorSetBinding.binding = 0;
-    cameraUBODescriptorSetBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
+    cameraUBODescriptorSetBinding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
     cameraUBODescriptorSetBinding.descriptorCount = 1;
-    cameraUBODescriptorSetBinding.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+    cameraUBODescriptorSetBinding.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+    if(_brain.meshShadersSupported)
+        cameraUBODescriptorSetBinding.stageFlags |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
 
     vk::DescriptorSetLayoutCreateInfo cameraUBOCreateInfo{};
     cameraUBOCreateInfo.bindingCount = 1;
@@ -380,20 +780,6 @@ void Engine::CreateDescriptorSetLayout()
 
 void Engine::InitializeCameraUBODescriptors()
 {
-    vk::DeviceSize bufferSize = sizeof(CameraUBO);
-
-    // Create buffers.
-    for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-    {
-        util::CreateBuffer(_brain, bufferSize,
-                           vk::BufferUsageFlagBits::eUniformBuffer,
-                           _cameraStructure.buffers[i], true, _cameraStructure.allocations[i],
-                           VMA_MEMORY_USAGE_CPU_ONLY,
-                           "Uniform buffer");
-
-        util::VK_ASSERT(vmaMapMemory(_brain.vmaAllocator, _cameraStructure.allocations[i], &_cameraStructure.mappedPtrs[i]), "Failed mapping memory for UBO!");
-    }
-
     std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts{};
     std::for_each(layouts.begin(), layouts.end(), [this](auto& l)
     { l = _cameraStructure.descriptorSetLayout; });
@@ -414,7 +800,7 @@ void Engine::InitializeCameraUBODescriptors()
 void Engine::UpdateCameraDescriptorSet(uint32_t currentFrame)
 {
     vk::DescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = _cameraStructure.buffers[currentFrame];
+    bufferInfo.buffer = _frameAllocator->Buffer(currentFrame);
     bufferInfo.offset = 0;
     bufferInfo.range = sizeof(CameraUBO);
 
@@ -424,7 +810,7 @@ void Engine::UpdateCameraDescriptorSet(uint32_t currentFrame)
     bufferWrite.dstSet = _cameraStructure.descriptorSets[currentFrame];
     bufferWrite.dstBinding = 0;
     bufferWrite.dstArrayElement = 0;
-    bufferWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
+    bufferWrite.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
     bufferWrite.descriptorCount = 1;
     bufferWrite.pBufferInfo = &bufferInfo;
 
@@ -448,45 +834,16 @@ CameraUBO Engine::CalculateCamera(const Camera& camera)
     return ubo;
 }
 
-void Engine::InitializeHDRTarget()
+void Engine::CreateEnvironmentPipelines(const StagedImage& environmentMap)
 {
-    _hdrTarget.format = vk::Format::eR32G32B32A32Sfloat;
-    _hdrTarget.size = _swapChain->GetImageSize();
-
-    util::CreateImage(_brain.vmaAllocator, _hdrTarget.size.x, _hdrTarget.size.y, _hdrTarget.format,
-                      vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
-                      _hdrTarget.images, _hdrTarget.allocations, "HDR Target", false, VMA_MEMORY_USAGE_GPU_ONLY);
-    util::NameObject(_hdrTarget.images, "[IMAGE] HDR Target", _brain.device, _brain.dldi);
-
-    _hdrTarget.imageViews = util::CreateImageView(_brain.device, _hdrTarget.images, _hdrTarget.format, vk::ImageAspectFlagBits::eColor);
-    util::NameObject(_hdrTarget.imageViews, "HDR Target View", _brain.device, _brain.dldi);
-
-    vk::CommandBuffer cb = util::BeginSingleTimeCommands(_brain);
-    util::TransitionImageLayout(cb, _hdrTarget.images, _hdrTarget.format, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
-    util::EndSingleTimeCommands(_brain,cb);
-}
-
-void Engine::LoadEnvironmentMap()
-{
-    int32_t width, height, numChannels;
-    float* data = stbi_loadf("assets/hdri/industrial_sunset_02_puresky_4k.hdr", &width, &height, &numChannels, 4);
-
-    if(data == nullptr)
-        throw std::runtime_error("Failed loading HDRI!");
-
-    Texture texture{};
-    texture.width = width;
-    texture.height = height;
-    texture.numChannels = 4;
-    texture.isHDR = true;
-    texture.data.resize(width * height * texture.numChannels * sizeof(float));
-    std::memcpy(texture.data.data(), data, texture.data.size());
-
-    stbi_image_free(data);
-
     SingleTimeCommands commandBuffer{ _brain };
-    commandBuffer.CreateTextureImage(texture, _environmentMap, false);
+    commandBuffer.CreateStagedImage(environmentMap, _environmentMap);
+    MeshPrimitiveHandle uvSphere = _modelLoader->LoadPrimitive(GenerateUVSphere(32, 32), commandBuffer);
     commandBuffer.Submit();
 
     util::NameObject(_environmentMap.image, "Environment HDRI", _brain.device, _brain.dldi);
+
+    _skydomePipeline = std::make_unique<SkydomePipeline>(_brain, *_pipelineCompiler, std::move(uvSphere), _cameraStructure, _gBuffers->HDR(), _environmentMap);
+    _iblPipeline = std::make_unique<IBLPipeline>(_brain, *_pipelineCompiler, _environmentMap);
+    _lightingPipeline = std::make_unique<LightingPipeline>(_brain, *_pipelineCompiler, *_gBuffers, _gBuffers->HDR(), _cameraStructure, _iblPipeline->IrradianceMap(), _iblPipeline->PrefilterMap(), _iblPipeline->BRDFLUTMap());
 }
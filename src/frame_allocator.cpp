@@ -0,0 +1,57 @@
+#include "frame_allocator.hpp"
+#include "vulkan_brain.hpp"
+#include "vulkan_helper.hpp"
+
+FrameAllocator::FrameAllocator(const VulkanBrain& brain) :
+    _brain(brain)
+{
+    _alignment = std::max(_brain.minUniformBufferOffsetAlignment, _brain.minStorageBufferOffsetAlignment);
+
+    for(auto& frame : _frames)
+    {
+        // Preferring device memory while asking for sequential host writes picks the resizable BAR heap when there is one,
+        // and falls back to host memory otherwise. Allocations are written without flushing, so the memory has to be coherent.
+        util::CreateBuffer(_brain, FRAME_ALLOCATOR_SIZE,
+                           vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+                           frame.buffer, true, frame.allocation,
+                           VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+                           "Frame allocator buffer", VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        void* mapped;
+        util::VK_ASSERT(vmaMapMemory(_brain.vmaAllocator, frame.allocation, &mapped), "Failed mapping memory for frame allocator!");
+        frame.mapped = static_cast<std::byte*>(mapped);
+    }
+
+    VkMemoryPropertyFlags memoryProperties;
+    vmaGetAllocationMemoryProperties(_brain.vmaAllocator, _frames[0].allocation, &memoryProperties);
+    _deviceLocal = memoryProperties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    spdlog::info("Frame allocator uses {} memory", _deviceLocal ? "device local" : "host");
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    for(auto& frame : _frames)
+    {
+        vmaUnmapMemory(_brain.vmaAllocator, frame.allocation);
+        util::DestroyBuffer(_brain.vmaAllocator, frame.buffer, frame.allocation);
+    }
+}
+
+void FrameAllocator::Reset(uint32_t currentFrame)
+{
+    _frames[currentFrame].offset = 0;
+}
+
+FrameAllocation FrameAllocator::Allocate(uint32_t currentFrame, vk::DeviceSize size)
+{
+    Frame& frame = _frames[currentFrame];
+
+    vk::DeviceSize offset = (frame.offset + _alignment - 1) / _alignment * _alignment;
+    if(offset + size > FRAME_ALLOCATOR_SIZE)
+        throw std::runtime_error("Frame allocator ran out of memory!");
+
+    frame.offset = offset + size;
+
+    return FrameAllocation{ frame.buffer, offset, frame.mapped + offset };
+}
@@ -0,0 +1,101 @@
+#include "frame_statistics.hpp"
+#include <cmath>
+
+namespace
+{
+// Weight of the newest frame in the recent average hitches are compared against.
+constexpr float RECENT_AVERAGE_WEIGHT = 0.05f;
+// Frames needed before the recent average is trusted for relative hitches.
+constexpr uint64_t HITCH_WARMUP_FRAMES = 16;
+
+const float LOG_HISTOGRAM_MIN = std::log(FRAME_HISTOGRAM_MIN);
+const float LOG_HISTOGRAM_RANGE = std::log(FRAME_HISTOGRAM_MAX) - LOG_HISTOGRAM_MIN;
+}
+
+void FrameStatistics::Add(float frameDuration)
+{
+    ++_histogram[Bin(frameDuration)];
+
+    ++_count;
+    double delta = frameDuration - _mean;
+    _mean += delta / _count;
+    _m2 += delta * (frameDuration - _mean);
+
+    if(_count > 1)
+        _jitterSum += std::abs(frameDuration - _previous);
+    _previous = frameDuration;
+
+    _min = std::min(_min, frameDuration);
+    _max = std::max(_max, frameDuration);
+
+    // Seeded even when the first frame is a hitch, otherwise a slow start leaves nothing to compare against.
+    if(_count == 1)
+        _recentAverage = frameDuration;
+
+    bool hitch = frameDuration > _hitchThresholds.absolute ||
+                 (_count > HITCH_WARMUP_FRAMES && frameDuration > _recentAverage * _hitchThresholds.relative);
+    if(hitch)
+    {
+        ++_hitchCount;
+        _recentHitches.Push(Hitch{ _count - 1, frameDuration, _recentAverage });
+        return;
+    }
+
+    // Hitches are left out, so a single long frame doesn't hide the ones right after it.
+    _recentAverage += (frameDuration - _recentAverage) * RECENT_AVERAGE_WEIGHT;
+}
+
+void FrameStatistics::Reset()
+{
+    HitchThresholds thresholds = _hitchThresholds;
+    *this = FrameStatistics{};
+    _hitchThresholds = thresholds;
+}
+
+float FrameStatistics::Percentile(float percentile) const
+{
+    if(_count == 0)
+        return 0.0f;
+
+    auto target = static_cast<uint64_t>(std::ceil(percentile * _count));
+    target = std::clamp<uint64_t>(target, 1, _count);
+
+    uint64_t cumulative = 0;
+    for(uint32_t i = 0; i < FRAME_HISTOGRAM_BINS; ++i)
+    {
+        cumulative += _histogram[i];
+        if(cumulative >= target)
+            return std::clamp(BinCenter(i), _min, _max);
+    }
+
+    return _max;
+}
+
+float FrameStatistics::StandardDeviation() const
+{
+    return _count > 1 ? static_cast<float>(std::sqrt(_m2 / (_count - 1))) : 0.0f;
+}
+
+float FrameStatistics::Jitter() const
+{
+    return _count > 1 ? static_cast<float>(_jitterSum / (_count - 1)) : 0.0f;
+}
+
+void FrameStatistics::WriteJSON(std::ostream& stream) const
+{
+    stream << "{ \"count\": " << _count << ", \"mean_ms\": " << Mean() << ", \"stddev_ms\": " << StandardDeviation()
+           << ", \"min_ms\": " << Min() << ", \"max_ms\": " << Max() << ", \"p50_ms\": " << Percentile(0.5f)
+           << ", \"p95_ms\": " << Percentile(0.95f) << ", \"p99_ms\": " << Percentile(0.99f) << ", \"p999_ms\": " << Percentile(0.999f)
+           << ", \"jitter_ms\": " << Jitter() << ", \"hitches\": " << _hitchCount << " }";
+}
+
+uint32_t FrameStatistics::Bin(float frameDuration)
+{
+    float position = (std::log(std::max(frameDuration, FRAME_HISTOGRAM_MIN)) - LOG_HISTOGRAM_MIN) / LOG_HISTOGRAM_RANGE;
+    return std::min(static_cast<uint32_t>(position * FRAME_HISTOGRAM_BINS), FRAME_HISTOGRAM_BINS - 1);
+}
+
+float FrameStatistics::BinCenter(uint32_t bin)
+{
+    return std::exp(LOG_HISTOGRAM_MIN + (bin + 0.5f) / FRAME_HISTOGRAM_BINS * LOG_HISTOGRAM_RANGE);
+}
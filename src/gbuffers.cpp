@@ -1,6 +1,27 @@
 #include "gbuffers.hpp"
+#include "memory_manager.hpp"
 
-GBuffers::GBuffers(const VulkanBrain& brain, glm::uvec2 size) :
+namespace
+{
+vk::ImageCreateInfo RenderTargetCreateInfo(glm::uvec2 size, vk::Format format, vk::ImageUsageFlags usage)
+{
+    vk::ImageCreateInfo createInfo{};
+    createInfo.imageType = vk::ImageType::e2D;
+    createInfo.extent = vk::Extent3D{ size.x, size.y, 1 };
+    createInfo.mipLevels = 1;
+    createInfo.arrayLayers = 1;
+    createInfo.format = format;
+    createInfo.tiling = vk::ImageTiling::eOptimal;
+    createInfo.initialLayout = vk::ImageLayout::eUndefined;
+    createInfo.usage = usage;
+    createInfo.sharingMode = vk::SharingMode::eExclusive;
+    createInfo.samples = vk::SampleCountFlagBits::e1;
+
+    return createInfo;
+}
+}
+
+GBuffers::GBuffers(const VulkanBrain& brain, glm::uvec2 size, HDRPrecision hdrPrecision) :
         _brain(brain),
         _size(size)
 {
@@ -11,9 +32,12 @@ GBuffers::GBuffers(const VulkanBrain& brain, glm::uvec2 size) :
     assert(supportedDepthFormat.has_value() && "No supported depth format!");
 
     _depthFormat = supportedDepthFormat.value();
+    _hdrTarget.format = SelectHDRFormat(_brain.physicalDevice, hdrPrecision);
+    _hdrQuantizationError = MeasureHDRQuantizationError(_hdrTarget.format);
+    spdlog::info("HDR target format {}, relative quantization error up to {:.3f}%", vk::to_string(_hdrTarget.format), _hdrQuantizationError * 100.0f);
 
     CreateGBuffers();
-    CreateDepthResources();
+    CreateDepthAndHDRTarget();
     CreateViewportAndScissor();
 }
 
@@ -33,10 +57,54 @@ void GBuffers::Resize(glm::uvec2 size)
     _size = size;
 
     CreateGBuffers();
-    CreateDepthResources();
+    CreateDepthAndHDRTarget();
     CreateViewportAndScissor();
 }
 
+void GBuffers::RecordBeginDepthCommands(vk::CommandBuffer commandBuffer) const
+{
+    // Waits for the previous frame's depth pyramid and depth writes, and for the passes using the HDR target when it
+    // shares the memory.
+    vk::ImageMemoryBarrier barrier{};
+    barrier.oldLayout = vk::ImageLayout::eUndefined;
+    barrier.newLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+    barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+    barrier.image = _depthImage;
+    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
+    if(util::HasStencilComponent(_depthFormat))
+        barrier.subresourceRange.aspectMask |= vk::ImageAspectFlagBits::eStencil;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eColorAttachmentWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eComputeShader |
+                                  vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eFragmentShader,
+                                  vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                                  vk::DependencyFlags{ 0 }, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void GBuffers::RecordBeginHDRCommands(vk::CommandBuffer commandBuffer) const
+{
+    // Waits for the late geometry pass, the last one writing depth.
+    vk::ImageMemoryBarrier barrier{};
+    barrier.oldLayout = vk::ImageLayout::eUndefined;
+    barrier.newLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+    barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+    barrier.image = _hdrTarget.images;
+    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                  vk::DependencyFlags{ 0 }, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
 void GBuffers::CreateGBuffers()
 {
     auto format = GBufferFormat();
@@ -50,34 +118,78 @@ void GBuffers::CreateGBuffers()
         _gBufferViews[i] = util::CreateImageView(_brain.device, _gBuffersImageArray, format, vk::ImageAspectFlagBits::eColor, i);
         util::NameObject(_gBufferViews[i], _names[i], _brain.device, _brain.dldi);
     }
-
-    vk::CommandBuffer cb = util::BeginSingleTimeCommands(_brain);
-    util::TransitionImageLayout(cb, _gBuffersImageArray, format, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, DEFERRED_ATTACHMENT_COUNT);
-    util::EndSingleTimeCommands(_brain, cb);
 }
 
-void GBuffers::CreateDepthResources()
+void GBuffers::CreateDepthAndHDRTarget()
 {
-    util::CreateImage(_brain.vmaAllocator, _size.x, _size.y,
-                      _depthFormat, vk::ImageTiling::eOptimal,
-                      vk::ImageUsageFlagBits::eDepthStencilAttachment,
-                      _depthImage, _depthImageAllocation, "Depth image", false, VMA_MEMORY_USAGE_GPU_ONLY);
+    _hdrTarget.size = _size;
+
+    vk::ImageCreateInfo depthCreateInfo = RenderTargetCreateInfo(_size, _depthFormat, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled);
+    vk::ImageCreateInfo hdrCreateInfo = RenderTargetCreateInfo(_size, _hdrTarget.format, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled);
+    util::VK_ASSERT(_brain.device.createImage(&depthCreateInfo, nullptr, &_depthImage), "Failed creating depth image!");
+    util::VK_ASSERT(_brain.device.createImage(&hdrCreateInfo, nullptr, &_hdrTarget.images), "Failed creating HDR target!");
+
+    vk::MemoryRequirements depthRequirements = _brain.device.getImageMemoryRequirements(_depthImage);
+    vk::MemoryRequirements hdrRequirements = _brain.device.getImageMemoryRequirements(_hdrTarget.images);
+
+    // Some devices keep depth and color in different memory types, in which case they can't alias.
+    vk::MemoryRequirements sharedRequirements{};
+    sharedRequirements.size = std::max(depthRequirements.size, hdrRequirements.size);
+    sharedRequirements.alignment = std::max(depthRequirements.alignment, hdrRequirements.alignment);
+    sharedRequirements.memoryTypeBits = depthRequirements.memoryTypeBits & hdrRequirements.memoryTypeBits;
+    _depthAliasesHDR = sharedRequirements.memoryTypeBits != 0;
+
+    VmaAllocationCreateInfo allocationCreateInfo{};
+    allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+    const vk::MemoryRequirements& depthAllocationRequirements = _depthAliasesHDR ? sharedRequirements : depthRequirements;
+    util::VK_ASSERT(vmaAllocateMemory(_brain.vmaAllocator, reinterpret_cast<const VkMemoryRequirements*>(&depthAllocationRequirements),
+                                      &allocationCreateInfo, &_depthAllocation, nullptr),
+                    "Failed allocating depth image memory!");
+    MemoryManager::TrackAllocation(_brain.vmaAllocator, _depthAllocation, _depthAliasesHDR ? "Depth image and HDR target" : "Depth image");
+    util::VK_ASSERT(vmaBindImageMemory(_brain.vmaAllocator, _depthAllocation, _depthImage), "Failed binding depth image memory!");
+
+    if(_depthAliasesHDR)
+    {
+        _hdrTarget.allocations = nullptr;
+        util::VK_ASSERT(vmaBindImageMemory(_brain.vmaAllocator, _depthAllocation, _hdrTarget.images), "Failed binding HDR target memory!");
+    }
+    else
+    {
+        util::VK_ASSERT(vmaAllocateMemory(_brain.vmaAllocator, reinterpret_cast<const VkMemoryRequirements*>(&hdrRequirements),
+                                          &allocationCreateInfo, &_hdrTarget.allocations, nullptr),
+                        "Failed allocating HDR target memory!");
+        MemoryManager::TrackAllocation(_brain.vmaAllocator, _hdrTarget.allocations, "HDR target");
+        util::VK_ASSERT(vmaBindImageMemory(_brain.vmaAllocator, _hdrTarget.allocations, _hdrTarget.images), "Failed binding HDR target memory!");
+    }
 
-    _depthImageView = util::CreateImageView(_brain.device, _depthImage, _depthFormat, vk::ImageAspectFlagBits::eDepth);
+    util::NameObject(_depthImage, "[IMAGE] Depth", _brain.device, _brain.dldi);
+    util::NameObject(_hdrTarget.images, "[IMAGE] HDR Target", _brain.device, _brain.dldi);
 
-    vk::CommandBuffer commandBuffer = util::BeginSingleTimeCommands(_brain);
-    util::TransitionImageLayout(commandBuffer, _depthImage, _depthFormat, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal);
-    util::EndSingleTimeCommands(_brain, commandBuffer);
+    _depthImageView = util::CreateImageView(_brain.device, _depthImage, _depthFormat, vk::ImageAspectFlagBits::eDepth);
+    _hdrTarget.imageViews = util::CreateImageView(_brain.device, _hdrTarget.images, _hdrTarget.format, vk::ImageAspectFlagBits::eColor);
+    util::NameObject(_hdrTarget.imageViews, "HDR Target View", _brain.device, _brain.dldi);
 }
 
 void GBuffers::CleanUp()
 {
-    vmaDestroyImage(_brain.vmaAllocator, _gBuffersImageArray, _gBufferAllocation);
+    util::DestroyImage(_brain.vmaAllocator, _gBuffersImageArray, _gBufferAllocation);
     for(size_t i = 0; i < DEFERRED_ATTACHMENT_COUNT; ++i)
         _brain.device.destroy(_gBufferViews[i]);
 
     _brain.device.destroy(_depthImageView);
-    vmaDestroyImage(_brain.vmaAllocator, _depthImage, _depthImageAllocation);
+    _brain.device.destroy(_depthImage);
+    _brain.device.destroy(_hdrTarget.imageViews);
+    _brain.device.destroy(_hdrTarget.images);
+
+    MemoryManager::UntrackAllocation(_brain.vmaAllocator, _depthAllocation);
+    vmaFreeMemory(_brain.vmaAllocator, _depthAllocation);
+    if(!_depthAliasesHDR)
+    {
+        MemoryManager::UntrackAllocation(_brain.vmaAllocator, _hdrTarget.allocations);
+        vmaFreeMemory(_brain.vmaAllocator, _hdrTarget.allocations);
+    }
 }
 
 void GBuffers::CreateViewportAndScissor()
@@ -0,0 +1,130 @@
+#include "gpu_profiler.hpp"
+#include "vulkan_brain.hpp"
+#include "vulkan_helper.hpp"
+
+GPUProfiler::GPUProfiler(const VulkanBrain& brain) :
+    _brain(brain)
+{
+    vk::PhysicalDeviceProperties properties;
+    _brain.physicalDevice.getProperties(&properties);
+    _timestampPeriod = properties.limits.timestampPeriod;
+
+    std::vector<vk::QueueFamilyProperties> queueFamilies = _brain.physicalDevice.getQueueFamilyProperties();
+    uint32_t validBits = queueFamilies[_brain.queueFamilyIndices.graphicsFamily.value()].timestampValidBits;
+    _timestampMask = validBits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t{ 1 } << validBits) - 1;
+
+    _supported = validBits != 0 && _timestampPeriod > 0.0f;
+    if(!_supported)
+    {
+        spdlog::warn("The graphics queue doesn't support timestamps, GPU timings are unavailable");
+        return;
+    }
+
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.queryType = vk::QueryType::eTimestamp;
+    createInfo.queryCount = MAX_GPU_ZONES * 2;
+
+    for(auto& frame : _frames)
+    {
+        util::VK_ASSERT(_brain.device.createQueryPool(&createInfo, nullptr, &frame.queryPool), "Failed creating timestamp query pool!");
+        util::NameObject(frame.queryPool, "Timestamp Query Pool", _brain.device, _brain.dldi);
+        frame.zoneNames.reserve(MAX_GPU_ZONES);
+    }
+}
+
+GPUProfiler::~GPUProfiler()
+{
+    for(auto& frame : _frames)
+        _brain.device.destroy(frame.queryPool);
+}
+
+void GPUProfiler::Update(uint32_t currentFrame)
+{
+    Frame& frame = _frames[currentFrame];
+    if(!_supported || !frame.recorded || frame.zoneNames.empty())
+        return;
+
+    // The fence of this frame signaled, so every query is available and waiting is not needed.
+    std::array<uint64_t, MAX_GPU_ZONES * 2> timestamps;
+    vk::Result result = _brain.device.getQueryPoolResults(frame.queryPool, 0, frame.zoneNames.size() * 2,
+                                                          sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                                          vk::QueryResultFlagBits::e64);
+    if(result != vk::Result::eSuccess)
+        return;
+
+    for(auto& timing : _timings)
+        timing.milliseconds = 0.0f;
+
+    for(size_t i = 0; i < frame.zoneNames.size(); ++i)
+    {
+        uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & _timestampMask;
+        float milliseconds = ticks * _timestampPeriod / 1000000.0f;
+
+        ProfileEvent event{};
+        event.name = frame.zoneNames[i];
+        event.begin = frame.submitTime + static_cast<uint64_t>(((timestamps[i * 2] - timestamps[0]) & _timestampMask) * static_cast<double>(_timestampPeriod));
+        event.end = event.begin + static_cast<uint64_t>(ticks * static_cast<double>(_timestampPeriod));
+        if(_events.size() < MAX_GPU_PROFILE_EVENTS)
+            _events.emplace_back(event);
+        else
+            _events[_nextEvent] = event;
+        _nextEvent = (_nextEvent + 1) % MAX_GPU_PROFILE_EVENTS;
+
+        auto it = std::find_if(_timings.begin(), _timings.end(), [&](const GPUTiming& timing) { return timing.name == frame.zoneNames[i]; });
+        if(it == _timings.end())
+            _timings.emplace_back(GPUTiming{ std::string{ frame.zoneNames[i] }, milliseconds });
+        else
+            it->milliseconds += milliseconds;
+    }
+}
+
+void GPUProfiler::RecordBeginFrame(vk::CommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    Frame& frame = _frames[currentFrame];
+    frame.zoneNames.clear();
+    frame.openZones.clear();
+    frame.recorded = true;
+
+    if(_supported)
+        commandBuffer.resetQueryPool(frame.queryPool, 0, MAX_GPU_ZONES * 2);
+}
+
+void GPUProfiler::MarkSubmitted(uint32_t currentFrame)
+{
+    _frames[currentFrame].submitTime = CPUProfiler::Now();
+}
+
+void GPUProfiler::RecordBeginZone(vk::CommandBuffer commandBuffer, uint32_t currentFrame, std::string_view name)
+{
+    Frame& frame = _frames[currentFrame];
+    if(!_supported)
+        return;
+
+    // Zones past the limit still have to be matched by their end.
+    if(frame.zoneNames.size() >= MAX_GPU_ZONES)
+    {
+        frame.openZones.emplace_back(MAX_GPU_ZONES);
+        return;
+    }
+
+    uint32_t zone = frame.zoneNames.size();
+    frame.zoneNames.emplace_back(name);
+    frame.openZones.emplace_back(zone);
+
+    // Waiting on all earlier commands keeps the overlap with the previous pass out of this zone.
+    commandBuffer.writeTimestamp2KHR(vk::PipelineStageFlagBits2::eAllCommands, frame.queryPool, zone * 2, _brain.dldi);
+}
+
+void GPUProfiler::RecordEndZone(vk::CommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    Frame& frame = _frames[currentFrame];
+    if(!_supported || frame.openZones.empty())
+        return;
+
+    uint32_t zone = frame.openZones.back();
+    frame.openZones.pop_back();
+    if(zone == MAX_GPU_ZONES)
+        return;
+
+    commandBuffer.writeTimestamp2KHR(vk::PipelineStageFlagBits2::eAllCommands, frame.queryPool, zone * 2 + 1, _brain.dldi);
+}
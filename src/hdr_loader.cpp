@@ -0,0 +1,217 @@
+#include "hdr_loader.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HDR_LOADER_SSE2
+#endif
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+constexpr size_t FILE_BUFFER_SIZE = 1 << 16;
+constexpr float MAX_HALF = 65504.0f;
+
+uint16_t FloatToHalf(float value)
+{
+    value = std::min(value, MAX_HALF);
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    // Below the smallest normal half, the addition lines the mantissa up with the half denormal bits.
+    if(value < 6.103515625e-05f)
+    {
+        float denormal = value + 0.5f;
+        std::memcpy(&bits, &denormal, sizeof(bits));
+        return static_cast<uint16_t>(bits - 0x3F000000u);
+    }
+
+    return static_cast<uint16_t>((bits - ((127u - 15u) << 23) + 0x1000u) >> 13);
+}
+
+float RGBEScale(uint8_t exponent)
+{
+    return exponent == 0 ? 0.0f : std::ldexp(1.0f, static_cast<int32_t>(exponent) - (128 + 8));
+}
+
+#if defined(HDR_LOADER_SSE2)
+__m128i LoadChannel(const uint8_t* channel)
+{
+    int32_t bytes;
+    std::memcpy(&bytes, channel, sizeof(bytes));
+
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+}
+
+// Expects non-negative input, returns the halves in the low 16 bits of every lane.
+__m128i FloatToHalf(__m128 value)
+{
+    value = _mm_min_ps(value, _mm_set1_ps(MAX_HALF));
+
+#if defined(__F16C__)
+    return _mm_unpacklo_epi16(_mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT), _mm_setzero_si128());
+#else
+    __m128i bits = _mm_castps_si128(value);
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(bits, _mm_set1_epi32((127 - 15) << 23)), _mm_set1_epi32(0x1000)), 13);
+    __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, _mm_set1_ps(0.5f))), _mm_set1_epi32(0x3F000000));
+
+    __m128i isDenormal = _mm_castps_si128(_mm_cmplt_ps(value, _mm_set1_ps(6.103515625e-05f)));
+    return _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+#endif
+}
+#endif
+}
+
+HDRReader::HDRReader(std::string_view path) :
+    _fileBuffer(FILE_BUFFER_SIZE)
+{
+    _file.rdbuf()->pubsetbuf(_fileBuffer.data(), _fileBuffer.size());
+    _file.open(std::string{ path }, std::ios::binary);
+
+    if(!_file.is_open())
+        throw std::runtime_error("Failed opening HDR file!");
+
+    ReadHeader();
+
+    for(auto& channel : _channels)
+        channel.resize(_width);
+}
+
+void HDRReader::ReadHeader()
+{
+    std::string line;
+    std::getline(_file, line);
+    if(line != "#?RADIANCE" && line != "#?RGBE")
+        throw std::runtime_error("File is not a Radiance HDR file!");
+
+    // Header variables end with an empty line.
+    while(std::getline(_file, line) && !line.empty())
+    {
+        if(line.starts_with("FORMAT=") && line != "FORMAT=32-bit_rle_rgbe")
+            throw std::runtime_error("Only RGBE encoded HDR files are supported!");
+    }
+
+    std::getline(_file, line);
+
+    int32_t width, height;
+    if(std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+        throw std::runtime_error("Unsupported HDR resolution, only -Y H +X W is supported!");
+
+    _width = width;
+    _height = height;
+}
+
+void HDRReader::ReadScanline(uint16_t* destination)
+{
+    // Scanlines with run length encoding start with two 2 bytes, followed by the width.
+    std::array<uint8_t, 4> start{};
+    _file.read(reinterpret_cast<char*>(start.data()), start.size());
+
+    bool runLengthEncoded = _width >= 8 && _width < 0x8000 && start[0] == 2 && start[1] == 2 && (start[2] & 0x80) == 0;
+    if(runLengthEncoded)
+    {
+        if(((start[2] << 8) | start[3]) != _width)
+            throw std::runtime_error("HDR scanline width mismatch!");
+
+        ReadRunLengthScanline();
+    }
+    else
+    {
+        for(size_t i = 0; i < start.size(); ++i)
+            _channels[i][0] = start[i];
+
+        ReadFlatScanline();
+    }
+
+    if(!_file)
+        throw std::runtime_error("Unexpected end of HDR file!");
+
+    RGBEToHalf({ _channels[0].data(), _channels[1].data(), _channels[2].data(), _channels[3].data() }, destination, _width);
+}
+
+void HDRReader::ReadFlatScanline()
+{
+    for(uint32_t x = 1; x < _width; ++x)
+        for(auto& channel : _channels)
+            channel[x] = ReadByte();
+}
+
+void HDRReader::ReadRunLengthScanline()
+{
+    for(auto& channel : _channels)
+    {
+        uint32_t x = 0;
+        while(x < _width)
+        {
+            uint8_t count = ReadByte();
+            bool isRun = count > 128;
+            if(isRun)
+                count -= 128;
+
+            if(count == 0 || x + count > _width)
+                throw std::runtime_error("Corrupt HDR scanline!");
+
+            if(isRun)
+            {
+                std::memset(&channel[x], ReadByte(), count);
+            }
+            else
+            {
+                _file.read(reinterpret_cast<char*>(&channel[x]), count);
+            }
+
+            x += count;
+        }
+    }
+}
+
+uint8_t HDRReader::ReadByte()
+{
+    return static_cast<uint8_t>(_file.get());
+}
+
+void RGBEToHalf(const std::array<const uint8_t*, 4>& channels, uint16_t* destination, size_t pixelCount)
+{
+    size_t i = 0;
+
+#if defined(HDR_LOADER_SSE2)
+    const __m128i exponentBias = _mm_set1_epi32(128 + 8 - 127);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for(; i + 4 <= pixelCount; i += 4)
+    {
+        __m128i exponent = LoadChannel(channels[3] + i);
+
+        // Builds 2^(e - 136) directly from the exponent bits, exponents too small for a normal float become zero.
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(exponent, exponentBias), 23));
+        scale = _mm_and_ps(scale, _mm_castsi128_ps(_mm_cmpgt_epi32(exponent, exponentBias)));
+
+        __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(LoadChannel(channels[0] + i)), scale);
+        __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(LoadChannel(channels[1] + i)), scale);
+        __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(LoadChannel(channels[2] + i)), scale);
+        __m128 a = one;
+
+        // Rows become the RGBA values of single pixels.
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        __m128i first = _mm_packs_epi32(FloatToHalf(r), FloatToHalf(g));
+        __m128i second = _mm_packs_epi32(FloatToHalf(b), FloatToHalf(a));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), first);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4 + 8), second);
+    }
+#endif
+
+    for(; i < pixelCount; ++i)
+    {
+        float scale = RGBEScale(channels[3][i]);
+        destination[i * 4 + 0] = FloatToHalf(channels[0][i] * scale);
+        destination[i * 4 + 1] = FloatToHalf(channels[1][i] * scale);
+        destination[i * 4 + 2] = FloatToHalf(channels[2][i] * scale);
+        destination[i * 4 + 3] = FloatToHalf(1.0f);
+    }
+}
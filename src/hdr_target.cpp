@@ -0,0 +1,47 @@
+#include "hdr_target.hpp"
+#include "vulkan_helper.hpp"
+#include <glm/gtc/packing.hpp>
+
+vk::Format SelectHDRFormat(vk::PhysicalDevice physicalDevice, HDRPrecision precision)
+{
+    std::vector<vk::Format> candidates{ vk::Format::eR16G16B16A16Sfloat, vk::Format::eR32G32B32A32Sfloat };
+    if(precision == HDRPrecision::ePacked)
+        candidates.insert(candidates.begin(), vk::Format::eB10G11R11UfloatPack32);
+
+    auto format = util::FindSupportedFormat(physicalDevice, candidates, vk::ImageTiling::eOptimal,
+                                            vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+    if(!format.has_value())
+        throw std::runtime_error("No supported HDR target format!");
+
+    if(format.value() != candidates.front())
+        spdlog::warn("HDR target format {} isn't supported, falling back to {}", vk::to_string(candidates.front()), vk::to_string(format.value()));
+
+    return format.value();
+}
+
+float MeasureHDRQuantizationError(vk::Format format)
+{
+    // Log spaced samples, with each channel offset a bit so they don't all hit the same rounding.
+    constexpr uint32_t SAMPLE_COUNT = 4096;
+    const float minValue = glm::log2(0.001f);
+    const float maxValue = glm::log2(60000.0f);
+
+    float maxError = 0.0f;
+    for(uint32_t i = 0; i < SAMPLE_COUNT; ++i)
+    {
+        float t = minValue + (maxValue - minValue) * i / (SAMPLE_COUNT - 1);
+        glm::vec3 value = glm::exp2(glm::vec3{ t, t + 0.013f, t + 0.029f });
+        value = glm::min(value, glm::vec3{ 60000.0f });
+
+        glm::vec3 stored{ value };
+        if(format == vk::Format::eR16G16B16A16Sfloat)
+            stored = glm::unpackHalf4x16(glm::packHalf4x16(glm::vec4{ value, 1.0f }));
+        else if(format == vk::Format::eB10G11R11UfloatPack32)
+            stored = glm::unpackF2x11_1x10(glm::packF2x11_1x10(value));
+
+        glm::vec3 error = glm::abs(stored - value) / value;
+        maxError = std::max({ maxError, error.x, error.y, error.z });
+    }
+
+    return maxError;
+}
@@ -0,0 +1,81 @@
+#include "headless_app.hpp"
+#include "include.hpp"
+
+HeadlessApp::HeadlessApp(const CreateParameters& parameters, glm::uvec2 size, uint32_t frameCount) :
+    Application(parameters),
+    _frameCount(frameCount)
+{
+    _width = size.x;
+    _height = size.y;
+
+    _initInfo.width = size.x;
+    _initInfo.height = size.y;
+    _initInfo.headless = true;
+}
+
+HeadlessApp::~HeadlessApp() = default;
+
+InitInfo HeadlessApp::GetInitInfo()
+{
+    return _initInfo;
+}
+
+glm::uvec2 HeadlessApp::DisplaySize()
+{
+    return glm::uvec2{ _width, _height };
+}
+
+bool HeadlessApp::IsMinimized()
+{
+    return false;
+}
+
+void HeadlessApp::Run(std::function<bool()> updateLoop)
+{
+    uint32_t frame = 0;
+    while(_frameCount == 0 || frame < _frameCount)
+    {
+        _inputManager.Update();
+        ++frame;
+
+        if(updateLoop())
+            break;
+    }
+
+    spdlog::info("Headless run finished after {} frames", frame);
+}
+
+void HeadlessApp::InitImGui()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendPlatformName = "headless";
+    io.DisplaySize = ImVec2{ static_cast<float>(_width), static_cast<float>(_height) };
+
+    _lastFrameTime = std::chrono::high_resolution_clock::now();
+}
+
+void HeadlessApp::NewImGuiFrame()
+{
+    auto currentFrameTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<float> deltaTime = currentFrameTime - _lastFrameTime;
+    _lastFrameTime = currentFrameTime;
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2{ static_cast<float>(_width), static_cast<float>(_height) };
+    // ImGui asserts on a delta time of 0.
+    io.DeltaTime = std::max(deltaTime.count(), 1.0f / 1000.0f);
+}
+
+void HeadlessApp::ShutdownImGui()
+{
+    ImGui::GetIO().BackendPlatformName = nullptr;
+}
+
+const class InputManager& HeadlessApp::GetInputManager() const
+{
+    return _inputManager;
+}
+
+void HeadlessApp::SetMouseHidden(bool state)
+{
+}
@@ -1,19 +1,110 @@
 #include "engine.hpp"
 
 #include "sdl_app.hpp"
+#include "headless_app.hpp"
 
+#include <charconv>
 #include <memory>
+#include <optional>
 
 std::shared_ptr<Application> g_app;
 std::unique_ptr<Engine> g_engine;
 
-int main()
+namespace
+{
+constexpr std::string_view USAGE =
+    "Usage: ferrite [--headless] [--width <pixels>] [--height <pixels>] [--frames <count>] [--dump-frames <directory>]\n"
+    "               [--packed-hdr] [--trace <file>] [--stats <file>] [--benchmark <file>] [--benchmark-report <file>]\n"
+    "               [--record-path <file>] [--startup-report <file>]";
+
+// Nothing for text that isn't a whole number, or is zero when that isn't allowed.
+std::optional<uint32_t> ParseNumber(std::string_view text, bool allowZero)
+{
+    uint32_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if(error != std::errc{} || end != text.data() + text.size() || (value == 0 && !allowZero))
+        return std::nullopt;
+
+    return value;
+}
+}
+
+int main(int argc, char* argv[])
 {
     Application::CreateParameters parameters{ "Vulkan", true };
 
-    g_app = std::make_shared<SDLApp>(parameters);
+    bool headless = false;
+    glm::uvec2 headlessSize{ 1280, 720 };
+    uint32_t headlessFrameCount = 0;
+    std::string frameDumpDirectory;
+    std::string traceFile;
+    std::string statisticsFile;
+    std::string benchmarkFile;
+    std::string benchmarkReport;
+    std::string recordPathFile;
+    std::string startupReportFile;
+    bool packedHDR = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string_view argument{ argv[i] };
+        bool hasValue = i + 1 < argc;
+        if(argument == "--packed-hdr")
+            packedHDR = true;
+        else if(argument == "--headless")
+            headless = true;
+        else if((argument == "--width" || argument == "--height" || argument == "--frames") && hasValue)
+        {
+            // Zero frames keeps running until the application quits.
+            std::optional<uint32_t> value = ParseNumber(argv[++i], argument == "--frames");
+            if(!value)
+            {
+                spdlog::error("Invalid value {} for {}\n{}", argv[i], argument, USAGE);
+                return EXIT_FAILURE;
+            }
+
+            if(argument == "--width")
+                headlessSize.x = *value;
+            else if(argument == "--height")
+                headlessSize.y = *value;
+            else
+                headlessFrameCount = *value;
+        }
+        else if(argument == "--dump-frames" && hasValue)
+            frameDumpDirectory = argv[++i];
+        else if(argument == "--trace" && hasValue)
+            traceFile = argv[++i];
+        else if(argument == "--stats" && hasValue)
+            statisticsFile = argv[++i];
+        else if(argument == "--benchmark" && hasValue)
+            benchmarkFile = argv[++i];
+        else if(argument == "--benchmark-report" && hasValue)
+            benchmarkReport = argv[++i];
+        else if(argument == "--record-path" && hasValue)
+            recordPathFile = argv[++i];
+        else if(argument == "--startup-report" && hasValue)
+            startupReportFile = argv[++i];
+        else
+            spdlog::warn("Ignoring unknown argument {}", argument);
+    }
+
+    if(headless)
+        g_app = std::make_shared<HeadlessApp>(parameters, headlessSize, headlessFrameCount);
+    else
+        g_app = std::make_shared<SDLApp>(parameters);
+
+    InitInfo initInfo = g_app->GetInitInfo();
+    if(packedHDR)
+        initInfo.hdrPrecision = HDRPrecision::ePacked;
+    initInfo.frameDumpDirectory = frameDumpDirectory;
+    initInfo.traceFile = traceFile;
+    initInfo.statisticsFile = statisticsFile;
+    initInfo.benchmarkFile = benchmarkFile;
+    if(!benchmarkReport.empty())
+        initInfo.benchmarkReport = benchmarkReport;
+    initInfo.recordPathFile = recordPathFile;
+    initInfo.startupReportFile = startupReportFile;
 
-    g_engine = std::make_unique<Engine>(g_app->GetInitInfo(), g_app);
+    g_engine = std::make_unique<Engine>(initInfo, g_app);
 
     try
     {
@@ -0,0 +1,73 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+
+#if defined(WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#if defined(WINDOWS)
+    _file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(_file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Failed opening file for mapping: " + path.string());
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(_file, &size);
+    _size = static_cast<size_t>(size.QuadPart);
+
+    if(_size > 0)
+    {
+        _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(_mapping == nullptr)
+        {
+            CloseHandle(_file);
+            throw std::runtime_error("Failed mapping file: " + path.string());
+        }
+
+        _data = static_cast<const std::byte*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    _fileDescriptor = open(path.c_str(), O_RDONLY);
+    if(_fileDescriptor == -1)
+        throw std::runtime_error("Failed opening file for mapping: " + path.string());
+
+    struct stat status{};
+    fstat(_fileDescriptor, &status);
+    _size = static_cast<size_t>(status.st_size);
+
+    if(_size > 0)
+    {
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fileDescriptor, 0);
+        if(data == MAP_FAILED)
+        {
+            close(_fileDescriptor);
+            throw std::runtime_error("Failed mapping file: " + path.string());
+        }
+
+        // Buffers are mostly read front to back while extracting attributes.
+        madvise(data, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const std::byte*>(data);
+    }
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(WINDOWS)
+    if(_data != nullptr)
+        UnmapViewOfFile(_data);
+    if(_mapping != nullptr)
+        CloseHandle(_mapping);
+    CloseHandle(_file);
+#else
+    if(_data != nullptr)
+        munmap(const_cast<std::byte*>(_data), _size);
+    close(_fileDescriptor);
+#endif
+}
@@ -0,0 +1,137 @@
+#include "memory_manager.hpp"
+#include "vulkan_brain.hpp"
+#include "vk_mem_alloc.h"
+#include <atomic>
+
+namespace
+{
+bool Contains(std::string_view text, std::string_view part)
+{
+    return std::search(text.begin(), text.end(), part.begin(), part.end(), [](char a, char b) { return std::tolower(a) == std::tolower(b); }) != text.end();
+}
+
+// Running usage per category, allocations can be created and freed on any thread.
+std::array<std::atomic<vk::DeviceSize>, static_cast<size_t>(MemoryCategory::eCount)> categoryUsage{};
+}
+
+MemoryManager::MemoryManager(const VulkanBrain& brain) :
+    _brain(brain)
+{
+    if(!_brain.memoryBudgetSupported)
+        spdlog::warn("VK_EXT_memory_budget isn't supported, memory budgets are estimated");
+}
+
+void MemoryManager::Update()
+{
+    // VMA refreshes its budget once per frame index.
+    vmaSetCurrentFrameIndex(_brain.vmaAllocator, ++_frameIndex);
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(_brain.vmaAllocator, &memoryProperties);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetHeapBudgets(_brain.vmaAllocator, budgets.data());
+
+    _deviceUsage = 0;
+    _deviceBudget = 0;
+    for(uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i)
+    {
+        if(!(memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+            continue;
+
+        _deviceUsage += budgets[i].usage;
+        _deviceBudget += budgets[i].budget;
+    }
+
+    auto threshold = static_cast<vk::DeviceSize>(DeviceBudget() * MEMORY_PRESSURE_THRESHOLD);
+    if(_deviceUsage <= threshold || _frameIndex - _lastPressureFrame < MEMORY_PRESSURE_COOLDOWN_FRAMES)
+        return;
+
+    _lastPressureFrame = _frameIndex;
+    vk::DeviceSize bytesToFree = _deviceUsage - threshold;
+    spdlog::warn("Memory pressure: {} MB used of a {} MB budget, asking for {} MB back",
+                 _deviceUsage / (1024 * 1024), DeviceBudget() / (1024 * 1024), bytesToFree / (1024 * 1024));
+
+    for(auto& callback : _pressureCallbacks)
+        callback(bytesToFree);
+}
+
+void MemoryManager::AddPressureCallback(PressureCallback callback)
+{
+    _pressureCallbacks.emplace_back(std::move(callback));
+}
+
+vk::DeviceSize MemoryManager::DeviceBudget() const
+{
+    return _budgetOverride != 0 ? std::min(_deviceBudget, _budgetOverride) : _deviceBudget;
+}
+
+MemoryStatistics MemoryManager::Statistics() const
+{
+    MemoryStatistics statistics{};
+    statistics.deviceUsage = _deviceUsage;
+    statistics.deviceBudget = DeviceBudget();
+    for(size_t i = 0; i < categoryUsage.size(); ++i)
+        statistics.categories.emplace_back(std::string{ CategoryName(static_cast<MemoryCategory>(i)) }, categoryUsage[i].load());
+
+    return statistics;
+}
+
+MemoryCategory MemoryManager::Categorize(std::string_view allocationName)
+{
+    if(Contains(allocationName, "staging"))
+        return MemoryCategory::eStaging;
+    if(Contains(allocationName, "gbuffer") || Contains(allocationName, "depth") || Contains(allocationName, "target"))
+        return MemoryCategory::eRenderTargets;
+    if(Contains(allocationName, "vertex") || Contains(allocationName, "index") || Contains(allocationName, "position") || Contains(allocationName, "meshlet"))
+        return MemoryCategory::eMeshes;
+    if(Contains(allocationName, "texture") || Contains(allocationName, "image") || Contains(allocationName, "map") || Contains(allocationName, "lut"))
+        return MemoryCategory::eTextures;
+
+    return MemoryCategory::eOther;
+}
+
+std::string_view MemoryManager::CategoryName(MemoryCategory category)
+{
+    switch(category)
+    {
+    case MemoryCategory::eTextures: return "Textures";
+    case MemoryCategory::eMeshes: return "Meshes";
+    case MemoryCategory::eRenderTargets: return "Render targets";
+    case MemoryCategory::eStaging: return "Staging";
+    default: return "Other";
+    }
+}
+
+vk::DeviceSize MemoryManager::CategoryUsage(MemoryCategory category)
+{
+    return categoryUsage[static_cast<size_t>(category)];
+}
+
+void MemoryManager::TrackAllocation(VmaAllocator allocator, VmaAllocation allocation, std::string_view name)
+{
+    vmaSetAllocationName(allocator, allocation, name.data());
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    // Offset by one, so untracked allocations keep their null user data.
+    MemoryCategory category = Categorize(name);
+    vmaSetAllocationUserData(allocator, allocation, reinterpret_cast<void*>(static_cast<uintptr_t>(category) + 1));
+    categoryUsage[static_cast<size_t>(category)] += info.size;
+}
+
+void MemoryManager::UntrackAllocation(VmaAllocator allocator, VmaAllocation allocation)
+{
+    if(allocation == nullptr)
+        return;
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    if(info.pUserData == nullptr)
+        return;
+
+    auto category = reinterpret_cast<uintptr_t>(info.pUserData) - 1;
+    categoryUsage[category] -= info.size;
+    vmaSetAllocationUserData(allocator, allocation, nullptr);
+}
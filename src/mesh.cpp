@@ -42,4 +42,23 @@ std::array<vk::VertexInputAttributeDescription, 5> Vertex::GetAttributeDescripti
     return attributeDescriptions;
 }
 
+vk::VertexInputBindingDescription Vertex::GetPositionBindingDescription()
+{
+    vk::VertexInputBindingDescription bindingDesc;
+    bindingDesc.binding = 0;
+    bindingDesc.stride = sizeof(glm::vec3);
+    bindingDesc.inputRate = vk::VertexInputRate::eVertex;
+
+    return bindingDesc;
+}
 
+vk::VertexInputAttributeDescription Vertex::GetPositionAttributeDescription()
+{
+    vk::VertexInputAttributeDescription attributeDescription;
+    attributeDescription.binding = 0;
+    attributeDescription.location = 0;
+    attributeDescription.format = vk::Format::eR32G32B32Sfloat;
+    attributeDescription.offset = 0;
+
+    return attributeDescription;
+}
@@ -0,0 +1,403 @@
+#include "mesh_optimizer.hpp"
+#include <numeric>
+
+namespace
+{
+// Clusters smaller than this are merged with the next one, sorting tiny clusters costs more cache misses than it saves in overdraw.
+constexpr size_t MIN_CLUSTER_TRIANGLES = 64;
+constexpr uint32_t INVALID_VERTEX = std::numeric_limits<uint32_t>::max();
+
+std::vector<uint32_t> ReadIndices(const MeshPrimitive& primitive)
+{
+    uint32_t indexElementSize = (primitive.indexType == vk::IndexType::eUint16 ? 2 : 4);
+    std::vector<uint32_t> indices(primitive.indicesBytes.size() / indexElementSize);
+    for(size_t i = 0; i < indices.size(); ++i)
+        std::memcpy(&indices[i], &primitive.indicesBytes[i * indexElementSize], indexElementSize);
+
+    return indices;
+}
+
+void WriteIndices(MeshPrimitive& primitive, const std::vector<uint32_t>& indices)
+{
+    uint32_t indexElementSize = (primitive.indexType == vk::IndexType::eUint16 ? 2 : 4);
+    primitive.indicesBytes.resize(indices.size() * indexElementSize);
+    for(size_t i = 0; i < indices.size(); ++i)
+        std::memcpy(&primitive.indicesBytes[i * indexElementSize], &indices[i], indexElementSize);
+}
+}
+
+VertexCacheStatistics& VertexCacheStatistics::operator+=(const VertexCacheStatistics& other)
+{
+    transformedVertices += other.transformedVertices;
+    triangleCount += other.triangleCount;
+    vertexCount += other.vertexCount;
+
+    return *this;
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStatistics statistics{};
+    statistics.triangleCount = indices.size() / 3;
+
+    // A vertex is in the cache when it was inserted less than cacheSize insertions ago.
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    size_t timestamp = cacheSize + 1;
+
+    for(uint32_t index : indices)
+    {
+        if(!used[index])
+        {
+            used[index] = true;
+            ++statistics.vertexCount;
+        }
+
+        if(timestamp - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = timestamp++;
+            ++statistics.transformedVertices;
+        }
+    }
+
+    return statistics;
+}
+
+std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    clusters.clear();
+
+    // Vertex to triangle adjacency.
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for(uint32_t index : indices)
+        ++liveTriangles[index];
+
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for(size_t i = 0; i < vertexCount; ++i)
+        triangleOffsets[i + 1] = triangleOffsets[i] + liveTriangles[i];
+
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    std::vector<uint32_t> fill{ triangleOffsets.begin(), triangleOffsets.end() - 1 };
+    for(size_t i = 0; i < indices.size(); ++i)
+        vertexTriangles[fill[indices[i]]++] = i / 3;
+
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+
+    uint32_t timestamp = cacheSize + 1;
+    uint32_t cursor = 0;
+    uint32_t fanningVertex = 0;
+    size_t clusterStart = 0;
+
+    while(fanningVertex != INVALID_VERTEX)
+    {
+        candidates.clear();
+
+        for(uint32_t t = triangleOffsets[fanningVertex]; t < triangleOffsets[fanningVertex + 1]; ++t)
+        {
+            uint32_t triangle = vertexTriangles[t];
+            if(emitted[triangle])
+                continue;
+
+            for(size_t k = 0; k < 3; ++k)
+            {
+                uint32_t vertex = indices[triangle * 3 + k];
+                result.emplace_back(vertex);
+                deadEnds.emplace_back(vertex);
+                candidates.emplace_back(vertex);
+                --liveTriangles[vertex];
+
+                if(timestamp - cacheTimestamps[vertex] > cacheSize)
+                    cacheTimestamps[vertex] = timestamp++;
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that is still in the cache after fanning around it, and is the oldest of those.
+        fanningVertex = INVALID_VERTEX;
+        int32_t bestPriority = -1;
+        for(uint32_t vertex : candidates)
+        {
+            if(liveTriangles[vertex] == 0)
+                continue;
+
+            int32_t priority = 0;
+            if(timestamp - cacheTimestamps[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = timestamp - cacheTimestamps[vertex];
+
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanningVertex = vertex;
+            }
+        }
+
+        if(fanningVertex != INVALID_VERTEX)
+            continue;
+
+        // Dead end, the cache contents no longer matter much from here on, which makes it a cluster boundary.
+        if(result.size() / 3 - clusterStart >= MIN_CLUSTER_TRIANGLES)
+        {
+            clusters.emplace_back(clusterStart);
+            clusterStart = result.size() / 3;
+        }
+
+        while(!deadEnds.empty() && fanningVertex == INVALID_VERTEX)
+        {
+            uint32_t vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if(liveTriangles[vertex] > 0)
+                fanningVertex = vertex;
+        }
+
+        while(cursor < vertexCount && fanningVertex == INVALID_VERTEX)
+        {
+            if(liveTriangles[cursor] > 0)
+                fanningVertex = cursor;
+            ++cursor;
+        }
+    }
+
+    if(clusterStart < result.size() / 3)
+        clusters.emplace_back(clusterStart);
+
+    return result;
+}
+
+std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters)
+{
+    size_t triangleCount = indices.size() / 3;
+
+    struct Cluster
+    {
+        uint32_t start;
+        uint32_t end;
+        float sortKey;
+    };
+
+    glm::vec3 meshCentroid{ 0.0f };
+    float meshArea = 0.0f;
+    std::vector<Cluster> sortedClusters(clusters.size());
+    std::vector<glm::vec3> clusterCentroids(clusters.size());
+    std::vector<glm::vec3> clusterNormals(clusters.size());
+
+    for(size_t i = 0; i < clusters.size(); ++i)
+    {
+        sortedClusters[i].start = clusters[i];
+        sortedClusters[i].end = i + 1 < clusters.size() ? clusters[i + 1] : triangleCount;
+
+        glm::vec3 centroid{ 0.0f };
+        glm::vec3 normal{ 0.0f };
+        float area = 0.0f;
+        for(uint32_t t = sortedClusters[i].start; t < sortedClusters[i].end; ++t)
+        {
+            glm::vec3 p0 = vertices[indices[t * 3 + 0]].position;
+            glm::vec3 p1 = vertices[indices[t * 3 + 1]].position;
+            glm::vec3 p2 = vertices[indices[t * 3 + 2]].position;
+
+            glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(triangleNormal);
+
+            centroid += (p0 + p1 + p2) / 3.0f * triangleArea;
+            normal += triangleNormal;
+            area += triangleArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+
+        clusterCentroids[i] = area > 0.0f ? centroid / area : centroid;
+        clusterNormals[i] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+    }
+
+    if(meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    for(size_t i = 0; i < clusters.size(); ++i)
+        sortedClusters[i].sortKey = glm::dot(clusterCentroids[i] - meshCentroid, clusterNormals[i]);
+
+    std::stable_sort(sortedClusters.begin(), sortedClusters.end(), [](const Cluster& lhs, const Cluster& rhs) { return lhs.sortKey > rhs.sortKey; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for(const auto& cluster : sortedClusters)
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+
+    return result;
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for(uint32_t& index : indices)
+    {
+        if(remap[index] == INVALID_VERTEX)
+        {
+            remap[index] = result.size();
+            result.emplace_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+}
+
+void OptimizeMesh(MeshPrimitive& primitive, VertexCacheStatistics& before, VertexCacheStatistics& after)
+{
+    if(primitive.topology != vk::PrimitiveTopology::eTriangleList || primitive.indicesBytes.empty())
+        return;
+
+    std::vector<uint32_t> indices = ReadIndices(primitive);
+
+    std::vector<MeshLOD> lods = primitive.lods;
+    if(lods.empty())
+        lods.emplace_back(MeshLOD{ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+    for(size_t i = 0; i < lods.size(); ++i)
+    {
+        std::vector<uint32_t> lodIndices{ indices.begin() + lods[i].firstIndex, indices.begin() + lods[i].firstIndex + lods[i].indexCount };
+
+        if(i == 0)
+            before += AnalyzeVertexCache(lodIndices, primitive.vertices.size());
+
+        std::vector<uint32_t> clusters;
+        lodIndices = OptimizeVertexCache(lodIndices, primitive.vertices.size(), clusters);
+        lodIndices = OptimizeOverdraw(lodIndices, primitive.vertices, clusters);
+
+        std::copy(lodIndices.begin(), lodIndices.end(), indices.begin() + lods[i].firstIndex);
+    }
+
+    // All LODs share the vertex buffer, the full detail range comes first so it decides the vertex order.
+    OptimizeVertexFetch(primitive.vertices, indices);
+
+    after += AnalyzeVertexCache({ indices.begin(), indices.begin() + lods[0].indexCount }, primitive.vertices.size());
+
+    WriteIndices(primitive, indices);
+}
+
+void BuildMeshlets(MeshPrimitive& primitive)
+{
+    primitive.meshlets.clear();
+    primitive.meshletVertices.clear();
+    primitive.meshletTriangles.clear();
+
+    if(primitive.topology != vk::PrimitiveTopology::eTriangleList || primitive.indicesBytes.empty())
+        return;
+
+    std::vector<uint32_t> indices = ReadIndices(primitive);
+    if(!primitive.lods.empty())
+        indices.resize(primitive.lods[0].indexCount);
+
+    std::vector<uint8_t> localIndices(primitive.vertices.size(), 0xFF);
+    Meshlet meshlet{};
+
+    const auto finishMeshlet = [&]()
+    {
+        if(meshlet.triangleCount == 0)
+            return;
+
+        const uint32_t* vertexIndices = &primitive.meshletVertices[meshlet.vertexOffset];
+        const uint8_t* triangles = &primitive.meshletTriangles[meshlet.triangleOffset];
+
+        BoundingBox bounds{};
+        for(uint32_t i = 0; i < meshlet.vertexCount; ++i)
+        {
+            const glm::vec3& position = primitive.vertices[vertexIndices[i]].position;
+            bounds.min = glm::min(bounds.min, position);
+            bounds.max = glm::max(bounds.max, position);
+            localIndices[vertexIndices[i]] = 0xFF;
+        }
+
+        meshlet.center = (bounds.min + bounds.max) * 0.5f;
+        meshlet.radius = 0.0f;
+        for(uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, primitive.vertices[vertexIndices[i]].position));
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.triangleCount);
+        glm::vec3 axis{ 0.0f };
+        for(uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            glm::vec3 p0 = primitive.vertices[vertexIndices[triangles[t * 3 + 0]]].position;
+            glm::vec3 p1 = primitive.vertices[vertexIndices[triangles[t * 3 + 1]]].position;
+            glm::vec3 p2 = primitive.vertices[vertexIndices[triangles[t * 3 + 2]]].position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            normals.emplace_back(length > 0.0f ? normal / length : normal);
+            axis += normals.back();
+        }
+
+        // A cutoff of 1 never culls, used when the triangles face too many directions for a useful cone.
+        meshlet.coneAxis = glm::length(axis) > 0.0f ? glm::normalize(axis) : glm::vec3{ 0.0f, 0.0f, 1.0f };
+        meshlet.coneApex = meshlet.center;
+        meshlet.coneCutoff = 1.0f;
+
+        float minDot = 1.0f;
+        for(const auto& normal : normals)
+            if(glm::dot(normal, normal) > 0.0f)
+                minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normal));
+
+        if(glm::length(axis) > 0.0f && minDot > 0.1f)
+        {
+            // Move the apex back along the axis until it lies behind every triangle plane.
+            float maxT = 0.0f;
+            for(uint32_t t = 0; t < meshlet.triangleCount; ++t)
+            {
+                if(glm::dot(normals[t], normals[t]) == 0.0f)
+                    continue;
+
+                glm::vec3 p0 = primitive.vertices[vertexIndices[triangles[t * 3]]].position;
+                maxT = std::max(maxT, glm::dot(meshlet.center - p0, normals[t]) / glm::dot(meshlet.coneAxis, normals[t]));
+            }
+
+            meshlet.coneApex = meshlet.center - meshlet.coneAxis * maxT;
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+
+        primitive.meshlets.emplace_back(meshlet);
+
+        // The shaders read the triangles as 32 bit words.
+        primitive.meshletTriangles.resize((primitive.meshletTriangles.size() + 3) & ~size_t{ 3 }, 0);
+
+        meshlet = {};
+        meshlet.vertexOffset = primitive.meshletVertices.size();
+        meshlet.triangleOffset = primitive.meshletTriangles.size();
+    };
+
+    for(size_t i = 0; i < indices.size(); i += 3)
+    {
+        uint32_t newVertices = 0;
+        for(size_t k = 0; k < 3; ++k)
+            newVertices += localIndices[indices[i + k]] == 0xFF;
+
+        if(meshlet.vertexCount + newVertices > MAX_MESHLET_VERTICES || meshlet.triangleCount + 1 > MAX_MESHLET_TRIANGLES)
+            finishMeshlet();
+
+        for(size_t k = 0; k < 3; ++k)
+        {
+            uint32_t index = indices[i + k];
+            if(localIndices[index] == 0xFF)
+            {
+                localIndices[index] = meshlet.vertexCount++;
+                primitive.meshletVertices.emplace_back(index);
+            }
+
+            primitive.meshletTriangles.emplace_back(localIndices[index]);
+        }
+
+        ++meshlet.triangleCount;
+    }
+
+    finishMeshlet();
+}
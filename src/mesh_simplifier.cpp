@@ -0,0 +1,288 @@
+#include "mesh_simplifier.hpp"
+#include <unordered_map>
+#include <numeric>
+
+namespace
+{
+// Minimum amount of triangles a LOD should have, anything below that isn't worth another draw range.
+constexpr size_t MIN_LOD_TRIANGLES = 64;
+
+struct Quadric
+{
+    // Upper triangle of the symmetric 4x4 matrix.
+    std::array<double, 10> m{};
+    double weight{ 0.0 };
+
+    static Quadric FromPlane(glm::dvec3 normal, double distance, double weight)
+    {
+        Quadric q{};
+        q.m = { normal.x * normal.x, normal.x * normal.y, normal.x * normal.z, normal.x * distance,
+                normal.y * normal.y, normal.y * normal.z, normal.y * distance,
+                normal.z * normal.z, normal.z * distance,
+                distance * distance };
+        for(auto& value : q.m)
+            value *= weight;
+        q.weight = weight;
+
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        for(size_t i = 0; i < m.size(); ++i)
+            m[i] += other.m[i];
+        weight += other.weight;
+
+        return *this;
+    }
+
+    // Returns the area weighted mean squared distance of the point to all accumulated planes.
+    double Evaluate(glm::dvec3 p) const
+    {
+        double error = m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+                     + m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+                     + m[7] * p.z * p.z + 2.0 * m[8] * p.z
+                     + m[9];
+
+        return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+};
+
+struct PositionHash
+{
+    size_t operator()(const glm::vec3& p) const
+    {
+        // Adding zero turns -0.0 into 0.0, they compare equal so they have to hash the same.
+        glm::vec3 position = p + glm::vec3{ 0.0f };
+        std::array<uint32_t, 3> bits;
+        std::memcpy(bits.data(), &position, sizeof(bits));
+
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+}
+}
+
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error)
+{
+    std::vector<uint32_t> result = indices;
+    error = 0.0f;
+
+    // Vertices sharing a position but not their attributes lie on a seam, moving them would tear the mesh apart.
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> wedgeCounts;
+    for(const auto& vertex : vertices)
+        ++wedgeCounts[vertex.position];
+
+    std::vector<bool> locked(vertices.size());
+    for(size_t i = 0; i < vertices.size(); ++i)
+        locked[i] = wedgeCounts[vertices[i].position] > 1;
+
+    std::unordered_map<uint64_t, uint32_t> edgeUsage;
+    for(size_t i = 0; i < result.size(); i += 3)
+        for(size_t j = 0; j < 3; ++j)
+            ++edgeUsage[EdgeKey(result[i + j], result[i + (j + 1) % 3])];
+
+    for(const auto& [key, count] : edgeUsage)
+    {
+        if(count != 1)
+            continue;
+
+        locked[key >> 32] = true;
+        locked[key & 0xFFFFFFFF] = true;
+    }
+
+    std::vector<Quadric> quadrics(vertices.size());
+    for(size_t i = 0; i < result.size(); i += 3)
+    {
+        glm::dvec3 p0 = vertices[result[i + 0]].position;
+        glm::dvec3 p1 = vertices[result[i + 1]].position;
+        glm::dvec3 p2 = vertices[result[i + 2]].position;
+
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if(length == 0.0)
+            continue;
+
+        normal /= length;
+        Quadric quadric = Quadric::FromPlane(normal, -glm::dot(normal, p0), length * 0.5);
+
+        quadrics[result[i + 0]] += quadric;
+        quadrics[result[i + 1]] += quadric;
+        quadrics[result[i + 2]] += quadric;
+    }
+
+    double maxCost = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<bool> touched(vertices.size());
+    std::vector<uint32_t> triangleOffsets(vertices.size() + 1);
+    std::vector<uint32_t> vertexTriangles;
+
+    while(result.size() > targetIndexCount)
+    {
+        // Vertex to triangle adjacency of the current mesh.
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for(uint32_t index : result)
+            ++triangleOffsets[index + 1];
+        for(size_t i = 1; i < triangleOffsets.size(); ++i)
+            triangleOffsets[i] += triangleOffsets[i - 1];
+
+        vertexTriangles.resize(result.size());
+        std::vector<uint32_t> fill{ triangleOffsets.begin(), triangleOffsets.end() - 1 };
+        for(size_t i = 0; i < result.size(); ++i)
+            vertexTriangles[fill[result[i]]++] = i / 3;
+
+        collapses.clear();
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            for(size_t j = 0; j < 3; ++j)
+            {
+                uint32_t a = result[i + j];
+                uint32_t b = result[i + (j + 1) % 3];
+
+                Quadric quadric = quadrics[a];
+                quadric += quadrics[b];
+
+                if(!locked[a])
+                    collapses.emplace_back(Collapse{ a, b, quadric.Evaluate(vertices[b].position) });
+                if(!locked[b])
+                    collapses.emplace_back(Collapse{ b, a, quadric.Evaluate(vertices[a].position) });
+            }
+        }
+
+        if(collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t removedTriangles = 0;
+
+        for(const auto& collapse : collapses)
+        {
+            if(removedTriangles >= trianglesToRemove)
+                break;
+            if(touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Reject collapses that would flip any of the remaining triangles around the removed vertex.
+            bool flips = false;
+            size_t sharedTriangles = 0;
+            glm::vec3 target = vertices[collapse.to].position;
+            for(uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; ++t)
+            {
+                const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+                if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    ++sharedTriangles;
+                    continue;
+                }
+
+                std::array<glm::vec3, 3> before{ vertices[triangle[0]].position, vertices[triangle[1]].position, vertices[triangle[2]].position };
+                std::array<glm::vec3, 3> after = before;
+                for(size_t k = 0; k < 3; ++k)
+                    if(triangle[k] == collapse.from)
+                        after[k] = target;
+
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) < 0.0f;
+            }
+
+            if(flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxCost = std::max(maxCost, collapse.cost);
+            removedTriangles += sharedTriangles;
+
+            // Everything around the collapse changed, so other collapses touching it have outdated costs this pass.
+            for(uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; ++t)
+                for(size_t k = 0; k < 3; ++k)
+                    touched[result[vertexTriangles[t] * 3 + k]] = true;
+        }
+
+        if(removedTriangles == 0)
+            break;
+
+        size_t writeIndex = 0;
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t i0 = remap[result[i + 0]];
+            uint32_t i1 = remap[result[i + 1]];
+            uint32_t i2 = remap[result[i + 2]];
+
+            if(i0 == i1 || i1 == i2 || i2 == i0)
+                continue;
+
+            result[writeIndex++] = i0;
+            result[writeIndex++] = i1;
+            result[writeIndex++] = i2;
+        }
+        result.resize(writeIndex);
+    }
+
+    error = static_cast<float>(std::sqrt(maxCost));
+
+    return result;
+}
+
+void GenerateLODs(MeshPrimitive& primitive)
+{
+    if(primitive.topology != vk::PrimitiveTopology::eTriangleList || primitive.indicesBytes.empty())
+        return;
+
+    uint32_t indexElementSize = (primitive.indexType == vk::IndexType::eUint16 ? 2 : 4);
+    size_t indexCount = primitive.indicesBytes.size() / indexElementSize;
+
+    std::vector<uint32_t> indices(indexCount);
+    for(size_t i = 0; i < indexCount; ++i)
+        std::memcpy(&indices[i], &primitive.indicesBytes[i * indexElementSize], indexElementSize);
+
+    primitive.lods.clear();
+    primitive.lods.emplace_back(MeshLOD{ 0, static_cast<uint32_t>(indexCount), 0.0f });
+
+    std::vector<uint32_t> allIndices = indices;
+    float accumulatedError = 0.0f;
+
+    while(primitive.lods.size() < MAX_LOD_COUNT)
+    {
+        size_t targetIndexCount = indices.size() / 6 * 3;
+        if(targetIndexCount < MIN_LOD_TRIANGLES * 3)
+            break;
+
+        float error;
+        std::vector<uint32_t> simplified = SimplifyMesh(primitive.vertices, indices, targetIndexCount, error);
+
+        // Locked seams and borders can prevent any meaningful reduction.
+        if(simplified.size() > indices.size() * 9 / 10)
+            break;
+
+        // Every LOD is simplified from the previous one, so errors stack up.
+        accumulatedError += error;
+        primitive.lods.emplace_back(MeshLOD{ static_cast<uint32_t>(allIndices.size()), static_cast<uint32_t>(simplified.size()), accumulatedError });
+
+        allIndices.insert(allIndices.end(), simplified.begin(), simplified.end());
+        indices = std::move(simplified);
+    }
+
+    // Simplification never introduces new vertices, so the original index type is still large enough.
+    primitive.indicesBytes.resize(allIndices.size() * indexElementSize);
+    for(size_t i = 0; i < allIndices.size(); ++i)
+        std::memcpy(&primitive.indicesBytes[i * indexElementSize], &allIndices[i], indexElementSize);
+}
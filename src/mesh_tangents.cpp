@@ -0,0 +1,141 @@
+#include "mesh_tangents.hpp"
+#include "util.hpp"
+
+namespace
+{
+// Triangles per parallel chunk, small meshes aren't worth spinning up threads for.
+constexpr size_t TRIANGLES_PER_CHUNK = 4096;
+constexpr float TANGENT_EPSILON = 1e-12f;
+
+template <typename T>
+void DecodeIndices(const std::vector<std::byte>& bytes, std::vector<uint32_t>& indices)
+{
+    const T* source = reinterpret_cast<const T*>(bytes.data());
+    for(size_t i = 0; i < indices.size(); ++i)
+        indices[i] = source[i];
+}
+
+// Any unit vector perpendicular to the normal, used when the UVs don't define a tangent direction.
+glm::vec3 Perpendicular(glm::vec3 normal)
+{
+    glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3{ 1.0f, 0.0f, 0.0f } : glm::vec3{ 0.0f, 1.0f, 0.0f };
+    glm::vec3 perpendicular = glm::cross(normal, axis);
+    float lengthSquared = glm::dot(perpendicular, perpendicular);
+
+    return lengthSquared > TANGENT_EPSILON ? perpendicular / std::sqrt(lengthSquared) : glm::vec3{ 1.0f, 0.0f, 0.0f };
+}
+
+glm::vec3 ProjectOntoPlane(glm::vec3 v, glm::vec3 normal)
+{
+    glm::vec3 projected = v - normal * glm::dot(normal, v);
+    float lengthSquared = glm::dot(projected, projected);
+
+    return lengthSquared > TANGENT_EPSILON ? projected / std::sqrt(lengthSquared) : glm::vec3{ 0.0f };
+}
+}
+
+void CalculateTangents(MeshPrimitive& primitive)
+{
+    std::vector<Vertex>& vertices = primitive.vertices;
+    if(vertices.empty())
+        return;
+
+    std::vector<uint32_t> indices;
+    if(!primitive.indicesBytes.empty())
+    {
+        uint32_t indexElementSize = (primitive.indexType == vk::IndexType::eUint16 ? 2 : 4);
+        indices.resize(primitive.indicesBytes.size() / indexElementSize);
+
+        if(indexElementSize == 2)
+            DecodeIndices<uint16_t>(primitive.indicesBytes, indices);
+        else
+            DecodeIndices<uint32_t>(primitive.indicesBytes, indices);
+    }
+    else
+    {
+        indices.resize(vertices.size());
+        for(size_t i = 0; i < indices.size(); ++i)
+            indices[i] = i;
+    }
+
+    size_t triangleCount = indices.size() / 3;
+    size_t cornerCount = triangleCount * 3;
+
+    // Per corner tangent and bitangent, weighted by the corner angle like MikkTSpace does.
+    std::vector<glm::vec3> cornerTangents(cornerCount);
+    std::vector<glm::vec3> cornerBitangents(cornerCount);
+
+    util::ParallelFor(triangleCount, TRIANGLES_PER_CHUNK, [&](size_t begin, size_t end)
+    {
+        for(size_t t = begin; t < end; ++t)
+        {
+            const uint32_t* triangle = &indices[t * 3];
+            const Vertex& v0 = vertices[triangle[0]];
+            const Vertex& v1 = vertices[triangle[1]];
+            const Vertex& v2 = vertices[triangle[2]];
+
+            glm::vec3 e1 = v1.position - v0.position;
+            glm::vec3 e2 = v2.position - v0.position;
+            glm::vec2 d1 = v1.texCoord - v0.texCoord;
+            glm::vec2 d2 = v2.texCoord - v0.texCoord;
+
+            // The sign of the UV area flips the directions on mirrored triangles, the magnitude is dropped since
+            // the vectors are normalized anyway.
+            float area = d1.x * d2.y - d2.x * d1.y;
+            float orientation = area < 0.0f ? -1.0f : 1.0f;
+            bool degenerate = std::abs(area) <= TANGENT_EPSILON;
+
+            glm::vec3 sdir = degenerate ? glm::vec3{ 0.0f } : (e1 * d2.y - e2 * d1.y) * orientation;
+            glm::vec3 tdir = degenerate ? glm::vec3{ 0.0f } : (e2 * d1.x - e1 * d2.x) * orientation;
+
+            for(size_t corner = 0; corner < 3; ++corner)
+            {
+                const Vertex& vertex = vertices[triangle[corner]];
+                glm::vec3 previous = vertices[triangle[(corner + 2) % 3]].position - vertex.position;
+                glm::vec3 next = vertices[triangle[(corner + 1) % 3]].position - vertex.position;
+
+                glm::vec3 edgeA = ProjectOntoPlane(next, vertex.normal);
+                glm::vec3 edgeB = ProjectOntoPlane(previous, vertex.normal);
+                float angle = std::acos(std::clamp(glm::dot(edgeA, edgeB), -1.0f, 1.0f));
+
+                cornerTangents[t * 3 + corner] = ProjectOntoPlane(sdir, vertex.normal) * angle;
+                cornerBitangents[t * 3 + corner] = ProjectOntoPlane(tdir, vertex.normal) * angle;
+            }
+        }
+    });
+
+    // Vertex to corner adjacency, so every vertex can be finalized independently without atomics.
+    std::vector<uint32_t> cornerOffsets(vertices.size() + 1);
+    for(size_t i = 0; i < cornerCount; ++i)
+        ++cornerOffsets[indices[i] + 1];
+    for(size_t i = 1; i < cornerOffsets.size(); ++i)
+        cornerOffsets[i] += cornerOffsets[i - 1];
+
+    std::vector<uint32_t> vertexCorners(cornerCount);
+    std::vector<uint32_t> fill{ cornerOffsets.begin(), cornerOffsets.end() - 1 };
+    for(size_t i = 0; i < cornerCount; ++i)
+        vertexCorners[fill[indices[i]]++] = i;
+
+    util::ParallelFor(vertices.size(), TRIANGLES_PER_CHUNK * 3, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 tangent{ 0.0f };
+            glm::vec3 bitangent{ 0.0f };
+            for(uint32_t c = cornerOffsets[i]; c < cornerOffsets[i + 1]; ++c)
+            {
+                tangent += cornerTangents[vertexCorners[c]];
+                bitangent += cornerBitangents[vertexCorners[c]];
+            }
+
+            glm::vec3 normal = vertices[i].normal;
+            tangent = ProjectOntoPlane(tangent, normal);
+            if(tangent == glm::vec3{ 0.0f })
+                tangent = Perpendicular(normal);
+
+            // Only the handedness is stored, shaders reconstruct the bitangent as cross(normal, tangent) * w.
+            float w = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+            vertices[i].tangent = glm::vec4{ tangent, w };
+        }
+    });
+}
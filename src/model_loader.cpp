@@ -5,11 +5,161 @@
 #include "stb_image.h"
 #include "vulkan_helper.hpp"
 #include "single_time_commands.hpp"
+#include "mesh_simplifier.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_tangents.hpp"
+#include "util.hpp"
+#include "texture_streamer.hpp"
+#include "mapped_file.hpp"
+#include "cpu_profiler.hpp"
+
+namespace
+{
+const std::byte* BufferData(const fastgltf::Buffer& buffer)
+{
+    // External buffers are mapped by Load, GLB buffers either view the mapped file or were loaded into an array.
+    if(const auto* byteView = std::get_if<fastgltf::sources::ByteView>(&buffer.data))
+        return byteView->bytes.data();
+    if(const auto* array = std::get_if<fastgltf::sources::Array>(&buffer.data))
+        return array->bytes.data();
+
+    throw std::runtime_error("Unsupported buffer data source!");
+}
+
+// Returns the encoded bytes of an image, or nothing if they aren't in memory.
+std::span<const std::byte> EncodedImageBytes(const fastgltf::Image& image, const fastgltf::Asset& gltf)
+{
+    if(const auto* byteView = std::get_if<fastgltf::sources::ByteView>(&image.data))
+        return byteView->bytes;
+    if(const auto* array = std::get_if<fastgltf::sources::Array>(&image.data))
+        return array->bytes;
+    if(const auto* view = std::get_if<fastgltf::sources::BufferView>(&image.data))
+    {
+        auto& bufferView = gltf.bufferViews[view->bufferViewIndex];
+        return { BufferData(gltf.buffers[bufferView.bufferIndex]) + bufferView.byteOffset, bufferView.byteLength };
+    }
+
+    return {};
+}
+
+// Points a URI data source at a mapping of the file it refers to, the mapping is added to mappedFiles to keep it alive.
+template <typename T>
+void MapURISource(T& data, size_t byteLength, const std::filesystem::path& directory, std::vector<std::unique_ptr<MappedFile>>& mappedFiles)
+{
+    const auto* uri = std::get_if<fastgltf::sources::URI>(&data);
+    if(uri == nullptr || !uri->uri.isLocalPath())
+        return;
+
+    const auto& mappedFile = mappedFiles.emplace_back(std::make_unique<MappedFile>(directory / uri->uri.fspath()));
+    std::span<const std::byte> bytes = mappedFile->Data().subspan(uri->fileByteOffset);
+    if(byteLength != 0)
+        bytes = bytes.first(std::min(byteLength, bytes.size()));
+
+    fastgltf::sources::ByteView byteView{};
+    byteView.bytes = fastgltf::span<const std::byte>{ bytes.data(), bytes.size() };
+    byteView.mimeType = uri->mimeType;
+    data = byteView;
+}
+
+const std::byte* AccessorData(const fastgltf::Accessor& accessor, const fastgltf::Asset& gltf)
+{
+    if(!accessor.bufferViewIndex.has_value())
+        throw std::runtime_error("Failed retrieving buffer view index from accessor!");
+    auto& bufferView = gltf.bufferViews[accessor.bufferViewIndex.value()];
+
+    return BufferData(gltf.buffers[bufferView.bufferIndex]) + bufferView.byteOffset + accessor.byteOffset;
+}
+
+template <typename Component, bool Normalized>
+float ComponentToFloat(Component value)
+{
+    if constexpr(std::is_floating_point_v<Component> || !Normalized)
+        return static_cast<float>(value);
+    else
+        return std::max(static_cast<float>(value) / static_cast<float>(std::numeric_limits<Component>::max()), -1.0f);
+}
+
+// Writes Components converted components of every element into the attribute at offset of each vertex.
+// Tightly packed data passes its stride as a template argument, so all addressing is constant and the loop vectorizes,
+// a Stride of 0 reads the stride at runtime instead.
+template <typename Component, size_t Components, size_t Stride, bool Normalized>
+void CopyAttribute(const std::byte* source, size_t runtimeStride, size_t count, Vertex* vertices, size_t offset)
+{
+    const size_t stride = Stride == 0 ? runtimeStride : Stride;
+    for(size_t i = 0; i < count; ++i)
+    {
+        const std::byte* element = source + i * stride;
+        float* target = reinterpret_cast<float*>(reinterpret_cast<std::byte*>(vertices + i) + offset);
+
+        for(size_t c = 0; c < Components; ++c)
+        {
+            Component value;
+            std::memcpy(&value, element + c * sizeof(Component), sizeof(Component));
+            target[c] = ComponentToFloat<Component, Normalized>(value);
+        }
+    }
+}
+
+template <typename Component, size_t Components>
+void CopyAttribute(const std::byte* source, size_t stride, size_t count, bool normalized, Vertex* vertices, size_t offset)
+{
+    constexpr size_t packedStride = sizeof(Component) * Components;
+    if(normalized)
+    {
+        if(stride == packedStride)
+            CopyAttribute<Component, Components, packedStride, true>(source, stride, count, vertices, offset);
+        else
+            CopyAttribute<Component, Components, 0, true>(source, stride, count, vertices, offset);
+    }
+    else
+    {
+        if(stride == packedStride)
+            CopyAttribute<Component, Components, packedStride, false>(source, stride, count, vertices, offset);
+        else
+            CopyAttribute<Component, Components, 0, false>(source, stride, count, vertices, offset);
+    }
+}
+
+template <typename Component>
+void CopyAttribute(const std::byte* source, size_t stride, size_t count, size_t components, bool normalized, Vertex* vertices, size_t offset)
+{
+    switch(components)
+    {
+    case 2: CopyAttribute<Component, 2>(source, stride, count, normalized, vertices, offset); break;
+    case 3: CopyAttribute<Component, 3>(source, stride, count, normalized, vertices, offset); break;
+    case 4: CopyAttribute<Component, 4>(source, stride, count, normalized, vertices, offset); break;
+    default: throw std::runtime_error("Unsupported vertex attribute component count!");
+    }
+}
+
+// Converts an accessor to float and writes at most targetComponents of it into the attribute at offset of each vertex.
+void CopyAttribute(const fastgltf::Accessor& accessor, const fastgltf::Asset& gltf, std::vector<Vertex>& vertices, size_t offset, size_t targetComponents)
+{
+    const std::byte* source = AccessorData(accessor, gltf);
+    auto& bufferView = gltf.bufferViews[accessor.bufferViewIndex.value()];
 
-ModelLoader::ModelLoader(const VulkanBrain& brain, vk::DescriptorSetLayout materialDescriptorSetLayout) :
+    size_t stride = bufferView.byteStride.has_value() ? bufferView.byteStride.value() : fastgltf::getElementByteSize(accessor.type, accessor.componentType);
+    size_t components = std::min<size_t>(fastgltf::getNumComponents(accessor.type), targetComponents);
+    size_t count = std::min(accessor.count, vertices.size());
+
+    switch(accessor.componentType)
+    {
+    case fastgltf::ComponentType::Float: CopyAttribute<float>(source, stride, count, components, accessor.normalized, vertices.data(), offset); break;
+    case fastgltf::ComponentType::UnsignedByte: CopyAttribute<uint8_t>(source, stride, count, components, accessor.normalized, vertices.data(), offset); break;
+    case fastgltf::ComponentType::Byte: CopyAttribute<int8_t>(source, stride, count, components, accessor.normalized, vertices.data(), offset); break;
+    case fastgltf::ComponentType::UnsignedShort: CopyAttribute<uint16_t>(source, stride, count, components, accessor.normalized, vertices.data(), offset); break;
+    case fastgltf::ComponentType::Short: CopyAttribute<int16_t>(source, stride, count, components, accessor.normalized, vertices.data(), offset); break;
+    default: throw std::runtime_error("Unsupported vertex attribute component type!");
+    }
+}
+}
+
+ModelLoader::ModelLoader(const VulkanBrain& brain, vk::DescriptorSetLayout materialDescriptorSetLayout, TextureStreamer* textureStreamer, bool optimizeMeshes) :
     _brain(brain),
-    _parser(),
-    _materialDescriptorSetLayout(materialDescriptorSetLayout)
+    _materialDescriptorSetLayout(materialDescriptorSetLayout),
+    _resourceCache(brain),
+    _textureStreamer(textureStreamer),
+    _optimizeMeshes(optimizeMeshes)
 {
 
     _sampler = util::CreateSampler(_brain, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerAddressMode::eRepeat,
@@ -35,60 +185,154 @@ ModelLoader::ModelLoader(const VulkanBrain& brain, vk::DescriptorSetLayout mater
 
 ModelLoader::~ModelLoader()
 {
-    vmaDestroyBuffer(_brain.vmaAllocator, _defaultMaterial->materialUniformBuffer, _defaultMaterial->materialUniformAllocation);
+    util::DestroyBuffer(_brain.vmaAllocator, _defaultMaterial->materialUniformBuffer, _defaultMaterial->materialUniformAllocation);
 
-    vmaDestroyImage(_brain.vmaAllocator, _defaultMaterial->textures[0]->image, _defaultMaterial->textures[0]->imageAllocation);
+    util::DestroyImage(_brain.vmaAllocator, _defaultMaterial->textures[0]->image, _defaultMaterial->textures[0]->imageAllocation);
     _brain.device.destroy(_defaultMaterial->textures[0]->imageView);
 }
 
 ModelHandle ModelLoader::Load(std::string_view path)
 {
-    fastgltf::GltfFileStream fileStream{ path };
+    PROFILE_ZONE("ModelLoader::Load");
+
+    return Upload(Process(path, true));
+}
+
+ProcessedModel ModelLoader::Process(std::string_view path, bool skipCachedImages) const
+{
+    PROFILE_ZONE("ModelLoader::Process");
+
+    ProcessedModel model{};
+    model.path = path;
 
-    if(!fileStream.isOpen())
+    // The glTF or GLB file itself is mapped, external buffers and images are mapped below, so nothing gets copied to the heap
+    // before it is processed. Everything stays mapped until the model is uploaded.
+    auto mappedFile = ProcessedModel::File::FromPath(path);
+    if(!mappedFile)
         throw std::runtime_error("Path not found!");
+    model.file = std::make_unique<ProcessedModel::File>(std::move(mappedFile.get()));
 
-    std::string_view directory = path.substr(0, path.find_last_of('/'));
-    auto loadedGltf = _parser.loadGltf(fileStream, directory, fastgltf::Options::DecomposeNodeMatrices | fastgltf::Options::LoadExternalBuffers | fastgltf::Options::LoadExternalImages);
+    // Parsers keep state between loads, every call gets its own so models can be processed concurrently.
+    fastgltf::Parser parser{};
+    std::filesystem::path directory = std::filesystem::path{ path }.parent_path();
+    auto loadedGltf = parser.loadGltf(*model.file, directory, fastgltf::Options::DecomposeNodeMatrices);
 
     if(!loadedGltf)
         throw std::runtime_error(getErrorMessage(loadedGltf.error()).data());
 
-    fastgltf::Asset& gltf = loadedGltf.get();
+    model.gltf = std::make_unique<fastgltf::Asset>(std::move(loadedGltf.get()));
+    fastgltf::Asset& gltf = *model.gltf;
+
+    for(auto& buffer : gltf.buffers)
+        MapURISource(buffer.data, buffer.byteLength, directory, model.mappedFiles);
+    for(auto& image : gltf.images)
+        MapURISource(image.data, 0, directory, model.mappedFiles);
 
     if(gltf.scenes.size() > 1)
         spdlog::warn("GLTF contains more than one scene, but we only load one scene!");
 
-    std::vector<Mesh> meshes;
-    std::vector<Texture> textures;
-    std::vector<Material> materials;
+    // Meshes are independent, so they're processed in parallel. Tangent generation inside runs inline on each worker.
+    model.meshes.resize(gltf.meshes.size());
+    std::vector<ProcessTimings> meshTimings(gltf.meshes.size());
+    util::ParallelFor(gltf.meshes.size(), 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+            model.meshes[i] = ProcessMesh(gltf.meshes[i], gltf, meshTimings[i]);
+    });
+
+    ProcessTimings timings{};
+    for(const auto& meshTiming : meshTimings)
+        timings += meshTiming;
+
+    spdlog::info("Processed meshes of {}: attributes {:.2f}ms, tangents {:.2f}ms, LODs {:.2f}ms (summed over threads)",
+                 path, timings.attributes.count(), timings.tangents.count(), timings.lods.count());
 
-    for(auto& mesh : gltf.meshes)
-        meshes.emplace_back(ProcessMesh(mesh, gltf));
+    if(_optimizeMeshes)
+    {
+        PROFILE_ZONE("ModelLoader::OptimizeMeshes");
+
+        VertexCacheStatistics before{};
+        VertexCacheStatistics after{};
+        for(auto& mesh : model.meshes)
+            for(auto& primitive : mesh.primitives)
+                OptimizeMesh(primitive, before, after);
+
+        spdlog::info("Optimized meshes of {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", path, before.ACMR(), after.ACMR(), before.ATVR(), after.ATVR());
+    }
+
+    // Built after optimizing, so the meshlets follow the cache friendly triangle order.
+    {
+        PROFILE_ZONE("ModelLoader::BuildMeshlets");
+        for(auto& mesh : model.meshes)
+            for(auto& primitive : mesh.primitives)
+                BuildMeshlets(primitive);
+    }
 
+    // Images already uploaded by this or an earlier model aren't decoded again.
+    std::vector<bool> cachedImages;
     for(auto& image : gltf.images)
-        textures.emplace_back(ProcessImage(image, gltf));
+    {
+        std::span<const std::byte> bytes = EncodedImageBytes(image, gltf);
+        uint64_t key = bytes.empty() ? 0 : ResourceCache::HashBytes(bytes);
+        model.imageKeys.emplace_back(key);
+        cachedImages.emplace_back(skipCachedImages && _resourceCache.FindTexture(key, bytes) != nullptr);
+    }
+
+    // Images are decoded in parallel, together with the mip chains the streamer uploads from, so Upload only copies them.
+    model.textures.resize(gltf.images.size());
+    util::ParallelFor(gltf.images.size(), 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+        {
+            if(cachedImages[i])
+                continue;
+
+            model.textures[i] = ProcessImage(gltf.images[i], gltf);
+            if(_textureStreamer != nullptr)
+                TextureStreamer::BuildMips(model.textures[i]);
+        }
+    });
 
     for(auto& material : gltf.materials)
-        materials.emplace_back(ProcessMaterial(material, gltf));
+        model.materials.emplace_back(ProcessMaterial(material, gltf));
+
+    return model;
+}
+
+ModelHandle ModelLoader::Upload(ProcessedModel&& model)
+{
+    ModelHandle modelHandle = LoadModel(model.meshes, std::move(model.textures), model.imageKeys, model.materials, *model.gltf);
+
+    spdlog::info("Loaded model: {}, {} unique textures and {} unique materials cached", model.path, _resourceCache.TextureCount(), _resourceCache.MaterialCount());
+
+    return modelHandle;
+}
 
-    spdlog::info("Loaded model: {}", path);
+ModelLoader::ProcessTimings& ModelLoader::ProcessTimings::operator+=(const ProcessTimings& other)
+{
+    attributes += other.attributes;
+    tangents += other.tangents;
+    lods += other.lods;
 
-    return LoadModel(meshes, textures, materials, gltf);
+    return *this;
 }
 
-Mesh ModelLoader::ProcessMesh(const fastgltf::Mesh& gltfMesh, const fastgltf::Asset& gltf)
+Mesh ModelLoader::ProcessMesh(const fastgltf::Mesh& gltfMesh, const fastgltf::Asset& gltf, ProcessTimings& timings)
 {
+    PROFILE_ZONE("ModelLoader::ProcessMesh");
+
     Mesh mesh{};
 
     for(auto& primitive : gltfMesh.primitives)
-        mesh.primitives.emplace_back(ProcessPrimitive(primitive, gltf));
+        mesh.primitives.emplace_back(ProcessPrimitive(primitive, gltf, timings));
 
     return mesh;
 }
 
-MeshPrimitive ModelLoader::ProcessPrimitive(const fastgltf::Primitive& gltfPrimitive, const fastgltf::Asset& gltf)
+MeshPrimitive ModelLoader::ProcessPrimitive(const fastgltf::Primitive& gltfPrimitive, const fastgltf::Asset& gltf, ProcessTimings& timings)
 {
+    auto start = std::chrono::steady_clock::now();
+
     MeshPrimitive primitive{};
 
     primitive.topology = MapGltfTopology(gltfPrimitive.type);
@@ -102,60 +346,34 @@ MeshPrimitive ModelLoader::ProcessPrimitive(const fastgltf::Primitive& gltfPrimi
     for(auto& attribute : gltfPrimitive.attributes)
     {
         auto& accessor = gltf.accessors[attribute.accessorIndex];
-        if(!accessor.bufferViewIndex.has_value())
-            throw std::runtime_error("Failed retrieving buffer view index from accessor!");
-        auto& bufferView = gltf.bufferViews[accessor.bufferViewIndex.value()];
-        auto& buffer = gltf.buffers[bufferView.bufferIndex];
-        auto& bufferBytes = std::get<fastgltf::sources::Array>(buffer.data);
-
-        const std::byte* attributeBufferStart = bufferBytes.bytes.data() + bufferView.byteOffset + accessor.byteOffset;
 
         // Make sure the mesh primitive has enough space allocated.
         if(!verticesReserved)
         { primitive.vertices = std::vector<Vertex>(accessor.count); verticesReserved = true; }
 
-        std::uint32_t offset;
         if(attribute.name == "POSITION")
-            offset = offsetof(Vertex, position);
+            CopyAttribute(accessor, gltf, primitive.vertices, offsetof(Vertex, position), 3);
         else if(attribute.name == "NORMAL")
-            offset = offsetof(Vertex, normal);
+            CopyAttribute(accessor, gltf, primitive.vertices, offsetof(Vertex, normal), 3);
         else if(attribute.name == "TANGENT")
-        { offset = offsetof(Vertex, tangent); tangentFound = true; }
+        { CopyAttribute(accessor, gltf, primitive.vertices, offsetof(Vertex, tangent), 4); tangentFound = true; }
         else if(attribute.name == "TEXCOORD_0")
-        { offset = offsetof(Vertex, texCoord); texCoordFound = true; }
+        { CopyAttribute(accessor, gltf, primitive.vertices, offsetof(Vertex, texCoord), 2); texCoordFound = true; }
+        // Colors can have an alpha channel, which the vertex format drops.
         else if(attribute.name == "COLOR_0")
-            offset = offsetof(Vertex, color);
-        else
-            continue;
-
-        for(size_t i = 0; i < accessor.count; ++i)
-        {
-            const std::byte* element;
-            if(bufferView.byteStride.has_value())
-                element = attributeBufferStart + i * bufferView.byteStride.value();
-            else
-                element = attributeBufferStart + i * fastgltf::getElementByteSize(accessor.type, accessor.componentType);
-
-            std::byte* writeTarget = reinterpret_cast<std::byte*>(&primitive.vertices[i]) + offset;
-            std::memcpy(writeTarget, element, fastgltf::getElementByteSize(accessor.type, accessor.componentType));
-        }
+            CopyAttribute(accessor, gltf, primitive.vertices, offsetof(Vertex, color), 3);
     }
 
     if(gltfPrimitive.indicesAccessor.has_value())
     {
         auto& accessor = gltf.accessors[gltfPrimitive.indicesAccessor.value()];
-        if(!accessor.bufferViewIndex.has_value())
-            throw std::runtime_error("Failed retrieving buffer view index from accessor!");
+        const std::byte* attributeBufferStart = AccessorData(accessor, gltf);
         auto& bufferView = gltf.bufferViews[accessor.bufferViewIndex.value()];
-        auto& buffer = gltf.buffers[bufferView.bufferIndex];
-        auto& bufferBytes = std::get<fastgltf::sources::Array>(buffer.data);
 
         uint32_t indexTypeSize = fastgltf::getElementByteSize(accessor.type, accessor.componentType);
         primitive.indexType = MapIndexType(accessor.componentType);
         primitive.indicesBytes = std::vector<std::byte>(accessor.count * indexTypeSize);
 
-        const std::byte* attributeBufferStart = bufferBytes.bytes.data() + bufferView.byteOffset + accessor.byteOffset;
-
         if(!bufferView.byteStride.has_value() || bufferView.byteStride.value() == 0)
         {
             std::memcpy(primitive.indicesBytes.data(), attributeBufferStart, primitive.indicesBytes.size());
@@ -164,21 +382,33 @@ MeshPrimitive ModelLoader::ProcessPrimitive(const fastgltf::Primitive& gltfPrimi
         {
             for(size_t i = 0; i < accessor.count; ++i)
             {
-                const std::byte* element = attributeBufferStart + bufferView.byteStride.value() + i * indexTypeSize;
+                const std::byte* element = attributeBufferStart + i * bufferView.byteStride.value();
                 std::byte* indexPtr = primitive.indicesBytes.data() + i * indexTypeSize;
                 std::memcpy(indexPtr, element, indexTypeSize);
             }
         }
     }
 
+    auto attributesEnd = std::chrono::steady_clock::now();
+    timings.attributes += attributesEnd - start;
+
     if(!tangentFound && texCoordFound)
         CalculateTangents(primitive);
 
+    auto tangentsEnd = std::chrono::steady_clock::now();
+    timings.tangents += tangentsEnd - attributesEnd;
+
+    GenerateLODs(primitive);
+
+    timings.lods += std::chrono::steady_clock::now() - tangentsEnd;
+
     return primitive;
 }
 
 Texture ModelLoader::ProcessImage(const fastgltf::Image& gltfImage, const fastgltf::Asset& gltf)
 {
+    PROFILE_ZONE("ModelLoader::ProcessImage");
+
     Texture texture{};
 
     std::visit(fastgltf::visitor {
@@ -200,6 +430,18 @@ Texture ModelLoader::ProcessImage(const fastgltf::Image& gltfImage, const fastgl
 
                 stbi_image_free(data);
             },
+            [&](const fastgltf::sources::ByteView& view) {
+                int32_t width, height, nrChannels;
+                stbi_uc* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(view.bytes.data()), static_cast<int32_t>(view.bytes.size()), &width, &height, &nrChannels, 4);
+
+                texture.data = std::vector<std::byte>(width * height * 4);
+                std::memcpy(texture.data.data(), reinterpret_cast<std::byte*>(data), texture.data.size());
+                texture.width = width;
+                texture.height = height;
+                texture.numChannels = 4;
+
+                stbi_image_free(data);
+            },
             [&](const fastgltf::sources::Array& vector) {
                 int32_t width, height, nrChannels;
                 stbi_uc* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(vector.bytes.data()), static_cast<int32_t>(vector.bytes.size()), &width, &height, &nrChannels, 4);
@@ -216,24 +458,19 @@ Texture ModelLoader::ProcessImage(const fastgltf::Image& gltfImage, const fastgl
                 auto& bufferView = gltf.bufferViews[view.bufferViewIndex];
                 auto& buffer = gltf.buffers[bufferView.bufferIndex];
 
-                std::visit(fastgltf::visitor {
-                        // We only care about VectorWithMime here, because we specify LoadExternalBuffers, meaning
-                        // all buffers are already loaded into a vector.
-                        [](auto& arg) {},
-                        [&](const fastgltf::sources::Array& vector) {
-                            int32_t width, height, nrChannels;
-                            stbi_uc* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(vector.bytes.data() + bufferView.byteOffset),
-                                                                        static_cast<int32_t>(bufferView.byteLength), &width, &height, &nrChannels, 4);
-
-                            texture.data = std::vector<std::byte>(width * height * 4);
-                            std::memcpy(texture.data.data(), reinterpret_cast<std::byte*>(data), texture.data.size());
-                            texture.width = width;
-                            texture.height = height;
-                            texture.numChannels = 4;
-
-                            stbi_image_free(data);
-                        }
-                }, buffer.data);
+                // Buffers are either mapped by Load or were loaded into an array.
+                const std::byte* bytes = BufferData(buffer) + bufferView.byteOffset;
+
+                int32_t width, height, nrChannels;
+                stbi_uc* data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(bytes), static_cast<int32_t>(bufferView.byteLength), &width, &height, &nrChannels, 4);
+
+                texture.data = std::vector<std::byte>(width * height * 4);
+                std::memcpy(texture.data.data(), reinterpret_cast<std::byte*>(data), texture.data.size());
+                texture.width = width;
+                texture.height = height;
+                texture.numChannels = 4;
+
+                stbi_image_free(data);
             },
     }, gltfImage.data);
 
@@ -295,89 +532,41 @@ uint32_t ModelLoader::MapTextureIndexToImageIndex(uint32_t textureIndex, const f
     return gltf.textures[textureIndex].imageIndex.value();
 }
 
-void ModelLoader::CalculateTangents(MeshPrimitive& primitive)
+ModelHandle ModelLoader::LoadModel(const std::vector<Mesh>& meshes, std::vector<Texture>&& textures, const std::vector<uint64_t>& imageKeys, const std::vector<Material>& materials, const fastgltf::Asset& gltf)
 {
-    uint32_t indexElementSize = (primitive.indexType == vk::IndexType::eUint16 ? 2 : 4);
-    uint32_t triangleCount = primitive.indicesBytes.size() > 0 ? primitive.indicesBytes.size() / indexElementSize / 3 : primitive.vertices.size() / 3;
-    for(size_t i = 0; i < triangleCount; ++i)
-    {
-        std::array<Vertex*, 3> triangle = {};
-        if(primitive.indicesBytes.size() > 0)
-        {
-            std::array<uint32_t, 3> indices = {};
-            std::memcpy(&indices[0], &primitive.indicesBytes[(i * 3 + 0) * indexElementSize], indexElementSize);
-            std::memcpy(&indices[1], &primitive.indicesBytes[(i * 3 + 1) * indexElementSize], indexElementSize);
-            std::memcpy(&indices[2], &primitive.indicesBytes[(i * 3 + 2) * indexElementSize], indexElementSize);
-
-            triangle = {
-                    &primitive.vertices[indices[0]],
-                    &primitive.vertices[indices[1]],
-                    &primitive.vertices[indices[2]]
-            };
-        }
-        else
-        {
-            triangle = {
-                    &primitive.vertices[i * 3 + 0],
-                    &primitive.vertices[i * 3 + 1],
-                    &primitive.vertices[i * 3 + 2]
-            };
-        }
+    PROFILE_ZONE("ModelLoader::LoadModel");
 
-
-        glm::vec4 tangent = CalculateTangent(triangle[0]->position, triangle[1]->position, triangle[2]->position,
-                                             triangle[0]->texCoord, triangle[1]->texCoord, triangle[2]->texCoord,
-                                             triangle[0]->normal);
-
-        triangle[0]->tangent += tangent;
-        triangle[1]->tangent += tangent;
-        triangle[2]->tangent += tangent;
-    }
-
-    for(size_t i = 0; i < primitive.vertices.size(); ++i)
-        primitive.vertices[i].tangent = glm::normalize(primitive.vertices[i].tangent);
-}
-
-glm::vec4 ModelLoader::CalculateTangent(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec2 uv0, glm::vec2 uv1, glm::vec2 uv2, glm::vec3 normal)
-{
-    glm::vec3 e1 = p1 - p0;
-    glm::vec3 e2 = p2 - p0;
-
-    float deltaU1 = uv1.x - uv0.x;
-    float deltaV1 = uv1.y - uv0.y;
-    float deltaU2 = uv2.x - uv0.x;
-    float deltaV2 = uv2.y - uv0.y;
-
-    float f = 1.0f / (deltaU1 * deltaV2 - deltaU2 * deltaV1);
-
-    glm::vec3 tangent;
-    tangent = f * (deltaV2 * e1 - deltaV1 * e2);
-
-    tangent = glm::normalize(tangent);
-
-    glm::vec3 bitangent = glm::normalize(glm::cross(normal, tangent));
-    float w = (glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f) ? -1.0f : 1.0f;
-
-    return glm::vec4(tangent.x, tangent.y, tangent.z, w);
-}
-
-ModelHandle ModelLoader::LoadModel(const std::vector<Mesh>& meshes, const std::vector<Texture>& textures, const std::vector<Material>& materials, const fastgltf::Asset& gltf)
-{
     SingleTimeCommands commandBuffer{ _brain };
 
     ModelHandle modelHandle{};
 
     // Load textures
-    for(const auto& texture : textures)
+    for(size_t i = 0; i < textures.size(); ++i)
     {
+        // Also catches duplicate images within the same model, those were decoded but are only uploaded once.
+        std::span<const std::byte> encoded = EncodedImageBytes(gltf.images[i], gltf);
+        if(auto cached = _resourceCache.FindTexture(imageKeys[i], encoded))
+        {
+            modelHandle.textures.emplace_back(cached);
+            continue;
+        }
+
+        Texture& texture = textures[i];
         TextureHandle textureHandle{};
         textureHandle.format = texture.GetFormat();
         textureHandle.width = texture.width;
         textureHandle.height = texture.height;
 
-        commandBuffer.CreateTextureImage(texture, textureHandle, true);
+        if(_textureStreamer != nullptr)
+            _textureStreamer->CreateTexture(std::move(texture), textureHandle, commandBuffer);
+        else
+            commandBuffer.CreateTextureImage(texture, textureHandle, true);
+
+        std::shared_ptr<TextureHandle> handle = _resourceCache.AddTexture(imageKeys[i], encoded, textureHandle);
+        if(_textureStreamer != nullptr)
+            _textureStreamer->TrackTexture(handle);
 
-        modelHandle.textures.emplace_back(std::make_shared<TextureHandle>(textureHandle));
+        modelHandle.textures.emplace_back(handle);
     }
 
     // Load materials
@@ -404,7 +593,22 @@ ModelHandle ModelLoader::LoadModel(const std::vector<Mesh>& meshes, const std::v
         info.occlusionStrength = material.occlusionStrength;
         info.emissiveFactor = material.emissiveFactor;
 
-        modelHandle.materials.emplace_back(std::make_shared<MaterialHandle>(util::CreateMaterial(_brain, textures, info, *_sampler, _materialDescriptorSetLayout, _defaultMaterial)));
+        auto streamIndex = [](const std::shared_ptr<TextureHandle>& texture) { return texture != nullptr ? texture->streamIndex : NO_STREAM_INDEX; };
+        info.albedoStreamIndex = streamIndex(textures[0]);
+        info.mrStreamIndex = streamIndex(textures[1]);
+        info.normalStreamIndex = streamIndex(textures[2]);
+        info.occlusionStreamIndex = streamIndex(textures[3]);
+        info.emissiveStreamIndex = streamIndex(textures[4]);
+
+        std::shared_ptr<MaterialHandle> materialHandle = _resourceCache.FindMaterial(info, textures);
+        if(materialHandle == nullptr)
+        {
+            materialHandle = _resourceCache.AddMaterial(info, util::CreateMaterial(_brain, textures, info, *_sampler, _materialDescriptorSetLayout, _defaultMaterial));
+            if(_textureStreamer != nullptr)
+                _textureStreamer->TrackMaterial(materialHandle);
+        }
+
+        modelHandle.materials.emplace_back(materialHandle);
     }
 
     // Load meshes
@@ -418,8 +622,7 @@ ModelHandle ModelLoader::LoadModel(const std::vector<Mesh>& meshes, const std::v
         modelHandle.meshes.emplace_back(std::make_shared<MeshHandle>(meshHandle));
     }
 
-    for(size_t i = 0; i < gltf.scenes[0].nodeIndices.size(); ++i)
-        RecurseHierarchy(gltf.nodes[gltf.scenes[0].nodeIndices[i]], modelHandle, gltf, glm::mat4{1.0f});
+    BuildHierarchy(modelHandle, gltf);
 
     commandBuffer.Submit();
 
@@ -428,18 +631,55 @@ ModelHandle ModelLoader::LoadModel(const std::vector<Mesh>& meshes, const std::v
 
 MeshPrimitiveHandle ModelLoader::LoadPrimitive(const MeshPrimitive& primitive, SingleTimeCommands& commandBuffer, std::shared_ptr<MaterialHandle> material)
 {
-    MeshPrimitiveHandle primitiveHandle{};
+    MeshPrimitiveHandle primitiveHandle = DescribePrimitive(primitive);
     primitiveHandle.material = material == nullptr ? _defaultMaterial : material;
+
+    std::vector<glm::vec3> positions(primitive.vertices.size());
+    for(size_t i = 0; i < primitive.vertices.size(); ++i)
+        positions[i] = primitive.vertices[i].position;
+
+    // Mesh shaders fetch the vertices themselves.
+    commandBuffer.CreateLocalBuffer(primitive.vertices, primitiveHandle.vertexBuffer, primitiveHandle.vertexBufferAllocation, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, "Vertex buffer");
+    commandBuffer.CreateLocalBuffer(positions, primitiveHandle.positionBuffer, primitiveHandle.positionBufferAllocation, vk::BufferUsageFlagBits::eVertexBuffer, "Position buffer");
+    commandBuffer.CreateLocalBuffer(primitive.indicesBytes, primitiveHandle.indexBuffer, primitiveHandle.indexBufferAllocation, vk::BufferUsageFlagBits::eIndexBuffer, "Index buffer");
+
+    if(!primitive.meshlets.empty())
+    {
+        primitiveHandle.meshletCount = primitive.meshlets.size();
+        commandBuffer.CreateLocalBuffer(primitive.meshlets, primitiveHandle.meshletBuffer, primitiveHandle.meshletBufferAllocation, vk::BufferUsageFlagBits::eStorageBuffer, "Meshlet buffer");
+        commandBuffer.CreateLocalBuffer(primitive.meshletVertices, primitiveHandle.meshletVertexBuffer, primitiveHandle.meshletVertexBufferAllocation, vk::BufferUsageFlagBits::eStorageBuffer, "Meshlet vertex buffer");
+        commandBuffer.CreateLocalBuffer(primitive.meshletTriangles, primitiveHandle.meshletTriangleBuffer, primitiveHandle.meshletTriangleBufferAllocation, vk::BufferUsageFlagBits::eStorageBuffer, "Meshlet triangle buffer");
+    }
+
+    return primitiveHandle;
+}
+
+MeshPrimitiveHandle ModelLoader::DescribePrimitive(const MeshPrimitive& primitive)
+{
+    MeshPrimitiveHandle primitiveHandle{};
     primitiveHandle.topology = primitive.topology;
     primitiveHandle.indexType = primitive.indexType;
-    primitiveHandle.indexCount = primitive.indicesBytes.size() / (primitiveHandle.indexType == vk::IndexType::eUint16 ? 2 : 4);
+    if(primitive.lods.empty())
+        primitiveHandle.lods.emplace_back(MeshLOD{ 0, static_cast<uint32_t>(primitive.indicesBytes.size() / (primitiveHandle.indexType == vk::IndexType::eUint16 ? 2 : 4)), 0.0f });
+    else
+        primitiveHandle.lods = primitive.lods;
+    primitiveHandle.indexCount = primitiveHandle.lods[0].indexCount;
 
-    commandBuffer.CreateLocalBuffer(primitive.vertices, primitiveHandle.vertexBuffer, primitiveHandle.vertexBufferAllocation, vk::BufferUsageFlagBits::eVertexBuffer, "Vertex buffer");
-    commandBuffer.CreateLocalBuffer(primitive.indicesBytes, primitiveHandle.indexBuffer, primitiveHandle.indexBufferAllocation, vk::BufferUsageFlagBits::eIndexBuffer, "Index buffer");
+    for(const auto& vertex : primitive.vertices)
+    {
+        primitiveHandle.boundingBox.min = glm::min(primitiveHandle.boundingBox.min, vertex.position);
+        primitiveHandle.boundingBox.max = glm::max(primitiveHandle.boundingBox.max, vertex.position);
+    }
 
     return primitiveHandle;
 }
 
+void ModelLoader::BuildHierarchy(ModelHandle& modelHandle, const fastgltf::Asset& gltf)
+{
+    for(size_t i = 0; i < gltf.scenes[0].nodeIndices.size(); ++i)
+        RecurseHierarchy(gltf.nodes[gltf.scenes[0].nodeIndices[i]], modelHandle, gltf, glm::mat4{1.0f});
+}
+
 void ModelLoader::RecurseHierarchy(const fastgltf::Node& gltfNode, ModelHandle& modelHandle, const fastgltf::Asset& gltf, glm::mat4 matrix)
 {
     Hierarchy::Node node{};
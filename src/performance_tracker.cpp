@@ -1,88 +1,91 @@
 #include "performance_tracker.hpp"
 #include "imgui.h"
 #include "implot.h"
+#include "spdlog/spdlog.h"
 #include <algorithm>
-#include <iostream>
+#include <fstream>
 #include <string>
 
 PerformanceTracker::PerformanceTracker()
 {
-    _totalTime = 0;
-    _fpsValues.reserve(MAX_SAMPLES);
-    _frameDurations.reserve(MAX_SAMPLES);
-    _timePoints.reserve(MAX_SAMPLES);
     _lastFrameTime = std::chrono::steady_clock::now();
 }
 
 void PerformanceTracker::Update()
 {
     auto currentTime = std::chrono::steady_clock::now();
-    float deltaTime = std::chrono::duration<float>(currentTime - _lastFrameTime).count();
+    float deltaTime = std::chrono::duration<float, std::milli>(currentTime - _lastFrameTime).count();
     _lastFrameTime = currentTime;
 
-    float fps = 1.0f / deltaTime;
-    float frameDuration = deltaTime * 1000.0f;
-    _totalTime += deltaTime;
+    Record(deltaTime);
+}
+
+void PerformanceTracker::Record(float frameDuration)
+{
+    float fps = 1000.0f / frameDuration;
+    _totalTime += frameDuration / 1000.0f;
 
-    if(_frameCounter < 4)
+    if(_frameCounter < WARMUP_FRAMES)
     {
         ++_frameCounter;
         return;
     }
 
-    if(fps >= _highestFps)
+    // Zones showing up for the first time had no duration in earlier samples. They copy the samples of the zone below
+    // them, or the shape of the frame durations for the first zone, so every history stays aligned with the time points.
+    for(const auto& timing : _gpuTimings)
     {
-        _highestFps = fps;
-        _highestFpsRecordIndex = _frameCounter;
+        auto it = std::find_if(_gpuZones.begin(), _gpuZones.end(), [&](const GPUZoneHistory& zone) { return zone.name == timing.name; });
+        if(it != _gpuZones.end())
+            continue;
+
+        GPUZoneHistory zone{ timing.name, _gpuZones.empty() ? _frameDurations : _gpuZones.back().stackedDurations };
+        if(_gpuZones.empty())
+            zone.stackedDurations.Fill(0.0f);
+        _gpuZones.emplace_back(std::move(zone));
     }
-    if(frameDuration >= _highestFrameDuration)
-    {
-        _highestFrameDuration = frameDuration;
-        _highestFrameDurationRecordIndex = _frameCounter;
-    }
-    if(_frameCounter - _highestFpsRecordIndex > MAX_SAMPLES)
-    {
-        auto it = std::max_element(_fpsValues.begin(), _fpsValues.end());
-        _highestFps = *it;
-        _highestFpsRecordIndex = _frameCounter - std::distance(_fpsValues.begin(), it);
-    }
-    if(_frameCounter - _highestFrameDurationRecordIndex > MAX_SAMPLES)
+
+    float stackedDuration = 0.0f;
+    for(auto& zone : _gpuZones)
     {
-        auto it = std::max_element(_frameDurations.begin(), _frameDurations.end());
-        _highestFrameDuration = *it;
-        _highestFrameDurationRecordIndex = _frameCounter - std::distance(_frameDurations.begin(), it);
+        auto it = std::find_if(_gpuTimings.begin(), _gpuTimings.end(), [&](const GPUTiming& timing) { return timing.name == zone.name; });
+        if(it != _gpuTimings.end())
+            stackedDuration += it->milliseconds;
+
+        zone.stackedDurations.Push(stackedDuration);
     }
 
-    _fpsValues.emplace_back(fps);
-    _frameDurations.emplace_back(frameDuration);
+    _fpsValues.Push(fps);
+    _frameDurations.Push(frameDuration);
+    _timePoints.Push(_totalTime);
+    _highestFps.Push(fps);
+    _highestFrameDuration.Push(frameDuration);
 
-    _timePoints.emplace_back(_totalTime);
-
-    if(_fpsValues.size() > MAX_SAMPLES)
-    {
-        _fpsValues.erase(_fpsValues.begin());
-        _frameDurations.erase(_frameDurations.begin());
-        _timePoints.erase(_timePoints.begin());
-    }
+    _statistics.Add(frameDuration);
+    if(_frameLogEnabled)
+        _frameLog.emplace_back(frameDuration);
 
     ++_frameCounter;
 }
 
 void PerformanceTracker::Render()
 {
-    if(_timePoints.empty())
+    if(_timePoints.Empty())
         return;
 
     ImGui::Begin("Performance metrics");
 
+    int count = static_cast<int>(_timePoints.Size());
+    int offset = static_cast<int>(_timePoints.Offset());
+
     if(ImPlot::BeginPlot("FPS"))
     {
         ImPlot::SetupAxes("Time (s)", "Value", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-        ImPlot::SetupAxisLimits(ImAxis_X1, _timePoints.front(), _timePoints.back(), ImGuiCond_Always);
-        ImPlot::SetupAxisLimits(ImAxis_Y1, 0, _highestFps * 1.05f, ImGuiCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_X1, _timePoints.Front(), _timePoints.Back(), ImGuiCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_Y1, 0, _highestFps.Max() * 1.05f, ImGuiCond_Always);
 
         ImPlot::PushStyleColor(ImPlotCol_Line, 0xFF24ac3d);
-        ImPlot::PlotLine("FPS", _timePoints.data(), _fpsValues.data(), _fpsValues.size());
+        ImPlot::PlotLine("FPS", _timePoints.Data(), _fpsValues.Data(), count, 0, offset);
         ImPlot::PopStyleColor();
 
         ImPlot::EndPlot();
@@ -90,18 +93,120 @@ void PerformanceTracker::Render()
     if(ImPlot::BeginPlot("Frame Duration"))
     {
         ImPlot::SetupAxes("Time (s)", "Value (ms)", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
-        ImPlot::SetupAxisLimits(ImAxis_X1, _timePoints.front(), _timePoints.back(), ImGuiCond_Always);
-        ImPlot::SetupAxisLimits(ImAxis_Y1, 0, _highestFrameDuration * 1.05f, ImGuiCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_X1, _timePoints.Front(), _timePoints.Back(), ImGuiCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_Y1, 0, _highestFrameDuration.Max() * 1.05f, ImGuiCond_Always);
 
         ImPlot::PushStyleVar(ImPlotStyleVar_FillAlpha, 0.25f);
-        ImPlot::PlotShaded("Frame Duration (ms)", _timePoints.data(), _frameDurations.data(), _frameDurations.size());
+        ImPlot::PlotShaded("Frame Duration (ms)", _timePoints.Data(), _frameDurations.Data(), count, 0.0, 0, offset);
 
-        ImPlot::PlotLine("Frame Duration (ms)", _timePoints.data(), _frameDurations.data(), _frameDurations.size());
+        ImPlot::PlotLine("Frame Duration (ms)", _timePoints.Data(), _frameDurations.Data(), count, 0, offset);
+        ImPlot::PopStyleVar();
 
+        ImPlot::EndPlot();
+    }
 
+    if(!_gpuZones.empty() && ImPlot::BeginPlot("GPU Passes"))
+    {
+        ImPlot::SetupAxes("Time (s)", "Value (ms)", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        ImPlot::SetupAxisLimits(ImAxis_X1, _timePoints.Front(), _timePoints.Back(), ImGuiCond_Always);
+
+        ImPlot::PushStyleVar(ImPlotStyleVar_FillAlpha, 0.5f);
+        for(size_t i = 0; i < _gpuZones.size(); ++i)
+        {
+            const auto& zone = _gpuZones[i];
+            if(i == 0)
+                ImPlot::PlotShaded(zone.name.c_str(), _timePoints.Data(), zone.stackedDurations.Data(), count, 0.0, 0, offset);
+            else
+                ImPlot::PlotShaded(zone.name.c_str(), _timePoints.Data(), _gpuZones[i - 1].stackedDurations.Data(), zone.stackedDurations.Data(), count, 0, offset);
+        }
+        ImPlot::PopStyleVar();
 
         ImPlot::EndPlot();
     }
 
+    for(const auto& timing : _gpuTimings)
+        ImGui::Text("%s: %.3f ms", timing.name.c_str(), timing.milliseconds);
+
+    ImGui::Text("P50 %.2f ms, P95 %.2f ms, P99 %.2f ms, P99.9 %.2f ms", _statistics.Percentile(0.5f), _statistics.Percentile(0.95f),
+                _statistics.Percentile(0.99f), _statistics.Percentile(0.999f));
+    ImGui::Text("Mean %.2f ms, deviation %.2f ms, jitter %.2f ms", _statistics.Mean(), _statistics.StandardDeviation(), _statistics.Jitter());
+    ImGui::Text("Hitches: %llu of %llu frames", static_cast<unsigned long long>(_statistics.HitchCount()), static_cast<unsigned long long>(_statistics.Count()));
+
+    HitchThresholds thresholds = _statistics.GetHitchThresholds();
+    bool thresholdsChanged = ImGui::SliderFloat("Hitch threshold (ms)", &thresholds.absolute, 1.0f, 500.0f);
+    thresholdsChanged |= ImGui::SliderFloat("Hitch threshold (x average)", &thresholds.relative, 1.1f, 10.0f);
+    if(thresholdsChanged)
+        _statistics.SetHitchThresholds(thresholds);
+    if(ImGui::Button("Reset statistics"))
+        _statistics.Reset();
+
+    if(_memoryStatistics.deviceBudget != 0)
+    {
+        constexpr float MB = 1024.0f * 1024.0f;
+        float usage = _memoryStatistics.deviceUsage / MB;
+        float budget = _memoryStatistics.deviceBudget / MB;
+
+        std::string overlay = std::to_string(static_cast<uint32_t>(usage)) + " / " + std::to_string(static_cast<uint32_t>(budget)) + " MB";
+        ImGui::Text("Device memory");
+        ImGui::ProgressBar(usage / budget, ImVec2{ -1.0f, 0.0f }, overlay.c_str());
+
+        for(const auto& [name, bytes] : _memoryStatistics.categories)
+            ImGui::Text("%s: %.1f MB", name.c_str(), bytes / MB);
+    }
+
     ImGui::End();
 }
+
+bool PerformanceTracker::ExportCSV(const std::filesystem::path& path) const
+{
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed opening {} for writing frame times", path.string());
+        return false;
+    }
+
+    file << "frame,frame_time_ms\n";
+    for(size_t i = 0; i < _frameLog.size(); ++i)
+        file << i << "," << _frameLog[i] << "\n";
+
+    return true;
+}
+
+bool PerformanceTracker::ExportJSON(const std::filesystem::path& path) const
+{
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed opening {} for writing frame statistics", path.string());
+        return false;
+    }
+
+    const HitchThresholds& thresholds = _statistics.GetHitchThresholds();
+    file << "{\n"
+         << "  \"frames\": " << _statistics.Count() << ",\n"
+         << "  \"mean_ms\": " << _statistics.Mean() << ",\n"
+         << "  \"stddev_ms\": " << _statistics.StandardDeviation() << ",\n"
+         << "  \"min_ms\": " << _statistics.Min() << ",\n"
+         << "  \"max_ms\": " << _statistics.Max() << ",\n"
+         << "  \"p50_ms\": " << _statistics.Percentile(0.5f) << ",\n"
+         << "  \"p95_ms\": " << _statistics.Percentile(0.95f) << ",\n"
+         << "  \"p99_ms\": " << _statistics.Percentile(0.99f) << ",\n"
+         << "  \"p999_ms\": " << _statistics.Percentile(0.999f) << ",\n"
+         << "  \"jitter_ms\": " << _statistics.Jitter() << ",\n"
+         << "  \"hitch_threshold_ms\": " << thresholds.absolute << ",\n"
+         << "  \"hitch_threshold_relative\": " << thresholds.relative << ",\n"
+         << "  \"hitch_count\": " << _statistics.HitchCount() << ",\n"
+         << "  \"recent_hitches\": [";
+
+    const auto& hitches = _statistics.RecentHitches();
+    for(size_t i = 0; i < hitches.Size(); ++i)
+    {
+        file << (i == 0 ? "\n" : ",\n")
+             << "    { \"frame\": " << hitches[i].frame << ", \"duration_ms\": " << hitches[i].duration
+             << ", \"expected_ms\": " << hitches[i].expected << " }";
+    }
+    file << (hitches.Empty() ? "]\n" : "\n  ]\n") << "}\n";
+
+    return true;
+}
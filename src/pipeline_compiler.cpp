@@ -0,0 +1,460 @@
+#include "pipeline_compiler.hpp"
+#include "shaders/shader_loader.hpp"
+#include "vulkan_helper.hpp"
+#include "cpu_profiler.hpp"
+#include "startup_timeline.hpp"
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+// Compiling is mostly single threaded driver work, more threads than pipelines in a pass don't help.
+constexpr uint32_t MAX_COMPILER_THREADS = 8;
+
+// Drivers should ignore cache data of other devices, but not all of them check it.
+bool CacheMatchesDevice(const std::vector<std::byte>& data, const vk::PhysicalDeviceProperties& properties)
+{
+    VkPipelineCacheHeaderVersionOne header{};
+    if(data.size() < sizeof(header))
+        return false;
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+// Waits for the pipeline, failures were logged by the worker that compiled it.
+bool Succeeded(const std::shared_future<vk::Pipeline>& pipeline)
+{
+    try
+    {
+        pipeline.get();
+        return true;
+    }
+    catch(const std::exception&)
+    {
+        return false;
+    }
+}
+}
+
+CompiledPipeline::CompiledPipeline(std::shared_ptr<State> state) :
+    _state(std::move(state))
+{
+}
+
+bool CompiledPipeline::Ready() const
+{
+    return _state && _state->current.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+}
+
+void CompiledPipeline::Destroy(vk::Device device)
+{
+    if(!_state)
+        return;
+
+    for(auto* future : { &_state->current, &_state->replacement })
+    {
+        if(!future->valid())
+            continue;
+
+        try
+        {
+            device.destroy(future->get());
+        }
+        catch(const std::exception&)
+        {
+            // Logged by the compiler when it failed.
+        }
+    }
+
+    // The compiler only holds on to it weakly, so this stops it from being reloaded.
+    _state.reset();
+}
+
+PipelineCompiler::PipelineCompiler(const VulkanBrain& brain, std::filesystem::path cacheFile, StartupTimeline* timeline) :
+    _brain(brain),
+    _cacheFile(std::move(cacheFile)),
+    _timeline(timeline)
+{
+    LoadCache();
+
+    uint32_t threadCount = std::clamp(std::max(std::thread::hardware_concurrency(), 2u) - 1, 1u, MAX_COMPILER_THREADS);
+    for(uint32_t i = 0; i < threadCount; ++i)
+        _workers.emplace_back([this]() { WorkerLoop(); });
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+    {
+        std::scoped_lock lock{ _mutex };
+        _stopping = true;
+    }
+    _queueChanged.notify_all();
+
+    for(auto& worker : _workers)
+        worker.join();
+
+    for(const auto& retired : _retiredPipelines)
+        _brain.device.destroy(retired.pipeline);
+
+    SaveCache();
+    _brain.device.destroy(_cache);
+}
+
+CompiledPipeline PipelineCompiler::Compile(GraphicsPipelineDescription description)
+{
+    std::string name = description.name;
+    std::vector<std::string> shaderPaths;
+    for(const auto& shader : description.shaders)
+        shaderPaths.emplace_back(shader.path);
+
+    return Register(std::move(name), std::move(shaderPaths), [this, description = std::move(description)]() { return CreatePipeline(description); });
+}
+
+CompiledPipeline PipelineCompiler::Compile(ComputePipelineDescription description)
+{
+    std::string name = description.name;
+    std::vector<std::string> shaderPaths{ description.shaderPath };
+    return Register(std::move(name), std::move(shaderPaths), [this, description = std::move(description)]() { return CreatePipeline(description); });
+}
+
+bool PipelineCompiler::Idle() const
+{
+    std::scoped_lock lock{ _mutex };
+    return _queue.empty() && _compilingCount == 0;
+}
+
+void PipelineCompiler::Reload(const std::string& shaderPath)
+{
+    for(const auto& weakState : _pipelines)
+    {
+        std::shared_ptr<CompiledPipeline::State> state = weakState.lock();
+        if(state && std::find(state->shaderPaths.begin(), state->shaderPaths.end(), shaderPath) != state->shaderPaths.end())
+            state->stale = true;
+    }
+}
+
+void PipelineCompiler::Update()
+{
+    ++_frameCount;
+
+    // Frames wait on the fence of the frame that used the same resources MAX_FRAMES_IN_FLIGHT frames ago.
+    std::erase_if(_retiredPipelines, [this](const RetiredPipeline& retired)
+    {
+        if(_frameCount < retired.frame + MAX_FRAMES_IN_FLIGHT)
+            return false;
+
+        _brain.device.destroy(retired.pipeline);
+        return true;
+    });
+
+    std::erase_if(_pipelines, [](const auto& weakState) { return weakState.expired(); });
+    for(const auto& weakState : _pipelines)
+    {
+        std::shared_ptr<CompiledPipeline::State> state = weakState.lock();
+
+        if(state->replacement.valid() && state->replacement.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready)
+        {
+            std::shared_future<vk::Pipeline> replacement = std::exchange(state->replacement, {});
+            if(Succeeded(replacement))
+            {
+                // The first compile may have failed, then there is nothing to retire.
+                if(Succeeded(state->current))
+                    _retiredPipelines.push_back({ state->current.get(), _frameCount });
+
+                state->current = std::move(replacement);
+                spdlog::info("Reloaded the {} pipeline", state->name);
+            }
+            // Otherwise the old pipeline stays in use until the shader is fixed, the error was already logged.
+        }
+
+        if(state->stale && !state->replacement.valid())
+        {
+            state->replacement = Enqueue(state->name, state->create);
+            state->stale = false;
+        }
+    }
+}
+
+CompiledPipeline PipelineCompiler::Register(std::string name, std::vector<std::string> shaderPaths, std::function<vk::Pipeline()> create)
+{
+    auto state = std::make_shared<CompiledPipeline::State>();
+    state->name = std::move(name);
+    state->shaderPaths = std::move(shaderPaths);
+    state->create = std::move(create);
+    state->current = Enqueue(state->name, state->create);
+
+    _pipelines.emplace_back(state);
+    return CompiledPipeline{ std::move(state) };
+}
+
+std::shared_future<vk::Pipeline> PipelineCompiler::Enqueue(std::string name, std::function<vk::Pipeline()> create)
+{
+    std::packaged_task<vk::Pipeline()> task{ [this, name = std::move(name), create = std::move(create)]()
+    {
+        uint64_t begin = CPUProfiler::Now();
+        try
+        {
+            vk::Pipeline pipeline = create();
+            if(StartupTimeline* timeline = _timeline.load())
+                timeline->AddStage("Compile " + name + " pipeline", begin, CPUProfiler::Now());
+
+            return pipeline;
+        }
+        catch(const std::exception& e)
+        {
+            spdlog::error("Failed compiling the {} pipeline: {}", name, e.what());
+            throw;
+        }
+    } };
+
+    std::shared_future<vk::Pipeline> pipeline = task.get_future().share();
+    {
+        std::scoped_lock lock{ _mutex };
+        _queue.emplace_back(std::move(task));
+    }
+    _queueChanged.notify_one();
+
+    return pipeline;
+}
+
+void PipelineCompiler::WorkerLoop()
+{
+    while(true)
+    {
+        std::packaged_task<vk::Pipeline()> task;
+        {
+            std::unique_lock lock{ _mutex };
+            _queueChanged.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+
+            // Only stops once everything queued is compiled, nothing waiting on a pipeline is left hanging.
+            if(_queue.empty())
+                return;
+
+            task = std::move(_queue.front());
+            _queue.pop_front();
+            ++_compilingCount;
+        }
+
+        {
+            PROFILE_ZONE("PipelineCompiler::Compile");
+            task();
+        }
+
+        std::scoped_lock lock{ _mutex };
+        --_compilingCount;
+    }
+}
+
+vk::Pipeline PipelineCompiler::CreatePipeline(const GraphicsPipelineDescription& description) const
+{
+    // Read before creating any module, so a missing file doesn't leak the others.
+    std::vector<std::vector<std::byte>> byteCodes;
+    for(const auto& shader : description.shaders)
+    {
+        byteCodes.emplace_back(shader::ReadFile(shader.path));
+
+        // Vulkan ignores constants the shader doesn't declare, so an outdated binary would make every variant the same.
+        for(uint32_t id = 0; id < shader.specializationConstants.size(); ++id)
+        {
+            if(!shader::HasSpecializationConstant(byteCodes.back(), id))
+                throw std::runtime_error(fmt::format("{} has no specialization constant {}, the binary is outdated", shader.path, id));
+        }
+    }
+
+    // Sized up front, the stages point into these.
+    std::vector<std::vector<vk::SpecializationMapEntry>> specializationEntries(description.shaders.size());
+    std::vector<vk::SpecializationInfo> specializationInfos(description.shaders.size());
+
+    std::vector<vk::ShaderModule> modules;
+    std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
+    bool meshShading = false;
+    for(size_t i = 0; i < description.shaders.size(); ++i)
+    {
+        modules.emplace_back(shader::CreateShaderModule(byteCodes[i], _brain.device));
+
+        vk::PipelineShaderStageCreateInfo& shaderStage = shaderStages.emplace_back();
+        shaderStage.stage = description.shaders[i].stage;
+        shaderStage.module = modules.back();
+        shaderStage.pName = "main";
+
+        const std::vector<uint32_t>& constants = description.shaders[i].specializationConstants;
+        if(!constants.empty())
+        {
+            for(uint32_t id = 0; id < constants.size(); ++id)
+                specializationEntries[i].emplace_back(id, id * sizeof(uint32_t), sizeof(uint32_t));
+
+            specializationInfos[i].mapEntryCount = specializationEntries[i].size();
+            specializationInfos[i].pMapEntries = specializationEntries[i].data();
+            specializationInfos[i].dataSize = constants.size() * sizeof(uint32_t);
+            specializationInfos[i].pData = constants.data();
+            shaderStage.pSpecializationInfo = &specializationInfos[i];
+        }
+
+        meshShading |= shaderStage.stage == vk::ShaderStageFlagBits::eMeshEXT;
+    }
+
+    vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = description.vertexBindings.size();
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = description.vertexBindings.data();
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = description.vertexAttributes.size();
+    vertexInputStateCreateInfo.pVertexAttributeDescriptions = description.vertexAttributes.data();
+
+    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
+    inputAssemblyStateCreateInfo.topology = description.topology;
+    inputAssemblyStateCreateInfo.primitiveRestartEnable = vk::False;
+
+    std::array<vk::DynamicState, 2> dynamicStates = {
+            vk::DynamicState::eViewport,
+            vk::DynamicState::eScissor,
+    };
+
+    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+    vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.scissorCount = 1;
+
+    vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
+    rasterizationStateCreateInfo.depthClampEnable = vk::False;
+    rasterizationStateCreateInfo.rasterizerDiscardEnable = vk::False;
+    rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
+    rasterizationStateCreateInfo.lineWidth = 1.0f;
+    rasterizationStateCreateInfo.cullMode = description.cullMode;
+    rasterizationStateCreateInfo.frontFace = description.frontFace;
+    rasterizationStateCreateInfo.depthBiasEnable = vk::False;
+
+    vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
+    multisampleStateCreateInfo.sampleShadingEnable = vk::False;
+    multisampleStateCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
+    multisampleStateCreateInfo.minSampleShading = 1.0f;
+    multisampleStateCreateInfo.pSampleMask = nullptr;
+    multisampleStateCreateInfo.alphaToCoverageEnable = vk::False;
+    multisampleStateCreateInfo.alphaToOneEnable = vk::False;
+
+    std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachmentStates(description.colorFormats.size());
+    for(auto& blendAttachmentState : colorBlendAttachmentStates)
+    {
+        blendAttachmentState.blendEnable = vk::False;
+        blendAttachmentState.colorWriteMask =
+                vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
+                vk::ColorComponentFlagBits::eA;
+    }
+
+    vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
+    colorBlendStateCreateInfo.logicOpEnable = vk::False;
+    colorBlendStateCreateInfo.attachmentCount = colorBlendAttachmentStates.size();
+    colorBlendStateCreateInfo.pAttachments = colorBlendAttachmentStates.data();
+
+    vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
+    depthStencilStateCreateInfo.depthTestEnable = description.depthTest;
+    depthStencilStateCreateInfo.depthWriteEnable = description.depthWrite;
+    depthStencilStateCreateInfo.depthCompareOp = description.depthCompareOp;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = false;
+    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
+    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
+    depthStencilStateCreateInfo.stencilTestEnable = false;
+
+    // Mesh pipelines have no vertex input or input assembly state.
+    vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.stageCount = shaderStages.size();
+    pipelineCreateInfo.pStages = shaderStages.data();
+    pipelineCreateInfo.pVertexInputState = meshShading ? nullptr : &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = meshShading ? nullptr : &inputAssemblyStateCreateInfo;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.layout = description.layout;
+    pipelineCreateInfo.subpass = 0;
+    pipelineCreateInfo.basePipelineHandle = nullptr;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    vk::PipelineRenderingCreateInfoKHR pipelineRenderingCreateInfoKhr{};
+    pipelineRenderingCreateInfoKhr.colorAttachmentCount = description.colorFormats.size();
+    pipelineRenderingCreateInfoKhr.pColorAttachmentFormats = description.colorFormats.data();
+    pipelineRenderingCreateInfoKhr.depthAttachmentFormat = description.depthFormat;
+
+    pipelineCreateInfo.pNext = &pipelineRenderingCreateInfoKhr;
+    pipelineCreateInfo.renderPass = nullptr; // Using dynamic rendering.
+
+    auto result = _brain.device.createGraphicsPipeline(_cache, pipelineCreateInfo, nullptr);
+
+    for(auto module : modules)
+        _brain.device.destroy(module);
+
+    util::VK_ASSERT(result.result, "Failed creating the " + description.name + " pipeline!");
+    return result.value;
+}
+
+vk::Pipeline PipelineCompiler::CreatePipeline(const ComputePipelineDescription& description) const
+{
+    auto byteCode = shader::ReadFile(description.shaderPath);
+    vk::ShaderModule module = shader::CreateShaderModule(byteCode, _brain.device);
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipelineCreateInfo.stage.module = module;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = description.layout;
+
+    auto result = _brain.device.createComputePipeline(_cache, pipelineCreateInfo, nullptr);
+
+    _brain.device.destroy(module);
+
+    util::VK_ASSERT(result.result, "Failed creating the " + description.name + " pipeline!");
+    return result.value;
+}
+
+void PipelineCompiler::LoadCache()
+{
+    std::vector<std::byte> data;
+    std::ifstream file{ _cacheFile, std::ios::ate | std::ios::binary };
+    if(file.is_open())
+    {
+        data.resize(file.tellg());
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+    }
+
+    if(!data.empty() && !CacheMatchesDevice(data, _brain.physicalDevice.getProperties()))
+    {
+        spdlog::info("Ignoring pipeline cache {}, it was created by another device or driver", _cacheFile.string());
+        data.clear();
+    }
+
+    vk::PipelineCacheCreateInfo createInfo{};
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.data();
+    util::VK_ASSERT(_brain.device.createPipelineCache(&createInfo, nullptr, &_cache), "Failed creating pipeline cache!");
+
+    if(!data.empty())
+        spdlog::info("Loaded pipeline cache {}, {} KB", _cacheFile.string(), data.size() / 1024);
+}
+
+void PipelineCompiler::SaveCache() const
+{
+    size_t size = 0;
+    if(_brain.device.getPipelineCacheData(_cache, &size, nullptr) != vk::Result::eSuccess)
+        return;
+
+    std::vector<std::byte> data(size);
+    if(_brain.device.getPipelineCacheData(_cache, &size, data.data()) != vk::Result::eSuccess)
+        return;
+
+    std::ofstream file{ _cacheFile, std::ios::binary };
+    if(!file)
+    {
+        spdlog::warn("Failed writing pipeline cache to {}", _cacheFile.string());
+        return;
+    }
+
+    file.write(reinterpret_cast<const char*>(data.data()), size);
+}
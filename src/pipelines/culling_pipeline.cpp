@@ -0,0 +1,428 @@
+#include "pipelines/culling_pipeline.hpp"
+#include <bit>
+
+CullingPipeline::CullingPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const GBuffers& gBuffers, const CameraStructure& camera, FrameAllocator& frameAllocator) :
+    _brain(brain),
+    _gBuffers(gBuffers),
+    _camera(camera),
+    _frameAllocator(frameAllocator)
+{
+    _sampler = util::CreateSampler(_brain, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerAddressMode::eClampToEdge, vk::SamplerMipmapMode::eNearest, 16);
+
+    CreateDescriptorSetLayouts();
+    for(size_t i = 0; i < _frameData.size(); ++i)
+        CreateBuffers(i);
+    CreateDepthPyramid();
+    CreateDescriptorSets();
+    CreateCullingPipeline(compiler);
+    CreateDepthPyramidPipeline(compiler);
+}
+
+CullingPipeline::~CullingPipeline()
+{
+    _cullingPipeline.Destroy(_brain.device);
+    _brain.device.destroy(_cullingPipelineLayout);
+    _depthPyramidPipeline.Destroy(_brain.device);
+    _brain.device.destroy(_depthPyramidPipelineLayout);
+
+    DestroyDepthPyramid();
+
+    for(size_t i = 0; i < _frameData.size(); ++i)
+        DestroyBuffers(i);
+
+    _brain.device.destroy(_cullingDescriptorSetLayout);
+    _brain.device.destroy(_depthPyramidDescriptorSetLayout);
+}
+
+void CullingPipeline::RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const std::vector<DrawCall>& drawCalls, CullingPhase phase)
+{
+    auto drawCount = static_cast<uint32_t>(drawCalls.size());
+
+    // Both phases cull the same draws, so the data only has to be uploaded once.
+    if(phase == CullingPhase::eEarly)
+    {
+        if(drawCount > _frameData[currentFrame].drawCapacity)
+            GrowBuffers(currentFrame, drawCount);
+
+        // The descriptor range covers the capacity, so that much has to be allocated. It's at most twice the draw count
+        // once the buffers grew.
+        DrawInfo* drawInfos = _frameAllocator.Allocate<DrawInfo>(currentFrame, _frameData[currentFrame].drawCapacity, _frameData[currentFrame].drawInfoOffset);
+        for(size_t i = 0; i < drawCount; ++i)
+        {
+            const DrawCall& drawCall = drawCalls[i];
+            drawInfos[i].model = drawCall.transform;
+            drawInfos[i].boundingBoxMin = glm::vec4{ drawCall.primitive->boundingBox.min, 1.0f };
+            drawInfos[i].boundingBoxMax = glm::vec4{ drawCall.primitive->boundingBox.max, 1.0f };
+            drawInfos[i].indexCount = drawCall.primitive->lods[drawCall.lod].indexCount;
+            drawInfos[i].firstIndex = drawCall.primitive->lods[drawCall.lod].firstIndex;
+            drawInfos[i].vertexOffset = 0;
+            // Task shaders cull MESHLETS_PER_TASK meshlets per workgroup.
+            drawInfos[i].taskCount = (drawCall.primitive->meshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK;
+        }
+    }
+
+    util::BeginLabel(commandBuffer, phase == CullingPhase::eEarly ? "Early culling" : "Late culling", glm::vec3{ 239.0f, 71.0f, 111.0f } / 255.0f, _brain.dldi);
+
+    // Wait for the previous culling pass and the draws that read its commands.
+    vk::MemoryBarrier memoryBarrier{};
+    memoryBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eIndirectCommandRead;
+    memoryBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eComputeShader,
+                                  vk::DependencyFlags{ 0 }, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, _cullingPipeline.Get());
+    uint32_t drawInfoOffset = static_cast<uint32_t>(_frameData[currentFrame].drawInfoOffset);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _cullingPipelineLayout, 0, 1, &_frameData[currentFrame].descriptorSet, 1, &drawInfoOffset);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _cullingPipelineLayout, 1, 1, &_camera.descriptorSets[currentFrame], 1, &_camera.offsets[currentFrame]);
+
+    CullingPushConstants pushConstants{};
+    pushConstants.phase = static_cast<uint32_t>(phase);
+    pushConstants.drawCount = drawCount;
+    pushConstants.commandOffset = CommandOffset(currentFrame, phase);
+    pushConstants.pyramidValid = _depthPyramidValid;
+    pushConstants.pyramidSize = glm::vec2{ _depthPyramidSize };
+    commandBuffer.pushConstants(_cullingPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullingPushConstants), &pushConstants);
+
+    commandBuffer.dispatch((drawCount + 63) / 64, 1, 1);
+
+    memoryBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    memoryBarrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+                                  vk::DependencyFlags{ 0 }, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    util::EndLabel(commandBuffer, _brain.dldi);
+}
+
+void CullingPipeline::RecordDepthPyramidCommands(vk::CommandBuffer commandBuffer)
+{
+    util::BeginLabel(commandBuffer, "Depth pyramid", glm::vec3{ 17.0f, 138.0f, 178.0f } / 255.0f, _brain.dldi);
+
+    // A new pyramid is transitioned in the frame that first builds it, so recreating it doesn't stall the queue. Nothing
+    // reads it before, the early culling phase skips the occlusion test until it's valid.
+    if(!_depthPyramidValid)
+        util::TransitionImageLayout(commandBuffer, _depthPyramid, vk::Format::eR32Sfloat, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, 1, 0, _depthPyramidMipCount);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, _depthPyramidPipeline.Get());
+
+    glm::uvec2 inputSize = _gBuffers.Size();
+    for(uint32_t i = 0; i < _depthPyramidMipCount; ++i)
+    {
+        glm::uvec2 outputSize = glm::max(_depthPyramidSize >> i, glm::uvec2{ 1 });
+
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _depthPyramidPipelineLayout, 0, 1, &_depthPyramidDescriptorSets[i], 0, nullptr);
+
+        DepthPyramidPushConstants pushConstants{ inputSize, outputSize };
+        commandBuffer.pushConstants(_depthPyramidPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(DepthPyramidPushConstants), &pushConstants);
+
+        commandBuffer.dispatch((outputSize.x + 7) / 8, (outputSize.y + 7) / 8, 1);
+
+        // The next mip reads from this one, the late culling pass reads from all of them.
+        vk::ImageMemoryBarrier barrier{};
+        barrier.oldLayout = vk::ImageLayout::eGeneral;
+        barrier.newLayout = vk::ImageLayout::eGeneral;
+        barrier.srcQueueFamilyIndex = vk::QueueFamilyIgnored;
+        barrier.dstQueueFamilyIndex = vk::QueueFamilyIgnored;
+        barrier.image = _depthPyramid;
+        barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        barrier.subresourceRange.baseMipLevel = i;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                                      vk::DependencyFlags{ 0 }, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        inputSize = outputSize;
+    }
+
+    util::EndLabel(commandBuffer, _brain.dldi);
+
+    _depthPyramidValid = true;
+}
+
+void CullingPipeline::RecreateDepthPyramid()
+{
+    DestroyDepthPyramid();
+    CreateDepthPyramid();
+
+    for(size_t i = 0; i < _frameData.size(); ++i)
+        UpdateCullingDescriptorSet(i);
+}
+
+void CullingPipeline::CreateDepthPyramid()
+{
+    glm::uvec2 size = _gBuffers.Size();
+    _depthPyramidSize = glm::uvec2{ std::bit_floor(size.x), std::bit_floor(size.y) };
+    _depthPyramidMipCount = static_cast<uint32_t>(floor(log2(std::max(_depthPyramidSize.x, _depthPyramidSize.y))) + 1);
+    _depthPyramidValid = false;
+
+    util::CreateImage(_brain.vmaAllocator, _depthPyramidSize.x, _depthPyramidSize.y, vk::Format::eR32Sfloat,
+                      vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage,
+                      _depthPyramid, _depthPyramidAllocation, "Depth pyramid", true, VMA_MEMORY_USAGE_GPU_ONLY);
+    util::NameObject(_depthPyramid, "[IMAGE] Depth pyramid", _brain.device, _brain.dldi);
+
+    _depthPyramidView = util::CreateImageView(_brain.device, _depthPyramid, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, 0, _depthPyramidMipCount);
+
+    _depthPyramidMipViews.resize(_depthPyramidMipCount);
+    for(uint32_t i = 0; i < _depthPyramidMipCount; ++i)
+    {
+        vk::ImageViewCreateInfo createInfo{};
+        createInfo.image = _depthPyramid;
+        createInfo.viewType = vk::ImageViewType::e2D;
+        createInfo.format = vk::Format::eR32Sfloat;
+        createInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        createInfo.subresourceRange.baseMipLevel = i;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        util::VK_ASSERT(_brain.device.createImageView(&createInfo, nullptr, &_depthPyramidMipViews[i]), "Failed creating depth pyramid mip view!");
+    }
+
+    std::vector<vk::DescriptorSetLayout> layouts(_depthPyramidMipCount, _depthPyramidDescriptorSetLayout);
+    vk::DescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.descriptorPool = _brain.descriptorPool;
+    allocateInfo.descriptorSetCount = layouts.size();
+    allocateInfo.pSetLayouts = layouts.data();
+
+    _depthPyramidDescriptorSets.resize(_depthPyramidMipCount);
+    util::VK_ASSERT(_brain.device.allocateDescriptorSets(&allocateInfo, _depthPyramidDescriptorSets.data()),
+                    "Failed allocating depth pyramid descriptor sets!");
+
+    for(uint32_t i = 0; i < _depthPyramidMipCount; ++i)
+    {
+        vk::DescriptorImageInfo inputInfo{};
+        inputInfo.sampler = *_sampler;
+        inputInfo.imageView = i == 0 ? _gBuffers.DepthImageView() : _depthPyramidMipViews[i - 1];
+        inputInfo.imageLayout = i == 0 ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eGeneral;
+
+        vk::DescriptorImageInfo outputInfo{};
+        outputInfo.imageView = _depthPyramidMipViews[i];
+        outputInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+        std::array<vk::WriteDescriptorSet, 2> descriptorWrites{};
+        descriptorWrites[0].dstSet = _depthPyramidDescriptorSets[i];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &inputInfo;
+
+        descriptorWrites[1].dstSet = _depthPyramidDescriptorSets[i];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = vk::DescriptorType::eStorageImage;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &outputInfo;
+
+        _brain.device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void CullingPipeline::DestroyDepthPyramid()
+{
+    util::VK_ASSERT(_brain.device.freeDescriptorSets(_brain.descriptorPool, _depthPyramidDescriptorSets.size(), _depthPyramidDescriptorSets.data()),
+                    "Failed freeing depth pyramid descriptor sets!");
+    _depthPyramidDescriptorSets.clear();
+
+    for(auto& view : _depthPyramidMipViews)
+        _brain.device.destroy(view);
+    _depthPyramidMipViews.clear();
+
+    _brain.device.destroy(_depthPyramidView);
+    util::DestroyImage(_brain.vmaAllocator, _depthPyramid, _depthPyramidAllocation);
+}
+
+void CullingPipeline::CreateBuffers(uint32_t frameIndex)
+{
+    FrameData& frame = _frameData[frameIndex];
+
+    // Holds the commands of both phases back to back.
+    util::CreateBuffer(_brain, sizeof(vk::DrawIndexedIndirectCommand) * frame.drawCapacity * 2,
+                       vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+                       frame.indirectBuffer, false, frame.indirectBufferAllocation,
+                       VMA_MEMORY_USAGE_GPU_ONLY,
+                       "Indirect draw buffer");
+
+    util::CreateBuffer(_brain, sizeof(vk::DrawMeshTasksIndirectCommandEXT) * frame.drawCapacity * 2,
+                       vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+                       frame.meshTaskBuffer, false, frame.meshTaskBufferAllocation,
+                       VMA_MEMORY_USAGE_GPU_ONLY,
+                       "Indirect mesh task buffer");
+
+    util::CreateBuffer(_brain, sizeof(uint32_t) * frame.drawCapacity,
+                       vk::BufferUsageFlagBits::eStorageBuffer,
+                       frame.visibilityBuffer, false, frame.visibilityBufferAllocation,
+                       VMA_MEMORY_USAGE_GPU_ONLY,
+                       "Visibility buffer");
+}
+
+void CullingPipeline::DestroyBuffers(uint32_t frameIndex)
+{
+    FrameData& frame = _frameData[frameIndex];
+    util::DestroyBuffer(_brain.vmaAllocator, frame.indirectBuffer, frame.indirectBufferAllocation);
+    util::DestroyBuffer(_brain.vmaAllocator, frame.meshTaskBuffer, frame.meshTaskBufferAllocation);
+    util::DestroyBuffer(_brain.vmaAllocator, frame.visibilityBuffer, frame.visibilityBufferAllocation);
+}
+
+void CullingPipeline::GrowBuffers(uint32_t frameIndex, uint32_t drawCount)
+{
+    // The fence of this frame was waited on, so its previous commands are done with the buffers and the descriptor set.
+    // Visibility is only carried from the early to the late phase of the same frame, nothing has to be copied over.
+    DestroyBuffers(frameIndex);
+    _frameData[frameIndex].drawCapacity = std::bit_ceil(drawCount);
+    CreateBuffers(frameIndex);
+    UpdateCullingDescriptorSet(frameIndex);
+
+    spdlog::info("Culling buffers of frame {} grew to {} draws", frameIndex, _frameData[frameIndex].drawCapacity);
+}
+
+void CullingPipeline::CreateDescriptorSetLayouts()
+{
+    std::array<vk::DescriptorSetLayoutBinding, 5> cullingBindings{};
+    for(size_t i = 0; i < 3; ++i)
+    {
+        cullingBindings[i].binding = i;
+        cullingBindings[i].descriptorCount = 1;
+        cullingBindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        cullingBindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+    cullingBindings[3].binding = 3;
+    cullingBindings[3].descriptorCount = 1;
+    cullingBindings[3].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    cullingBindings[3].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    cullingBindings[4].binding = 4;
+    cullingBindings[4].descriptorCount = 1;
+    cullingBindings[4].descriptorType = vk::DescriptorType::eStorageBuffer;
+    cullingBindings[4].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    // Draw infos are written to the frame allocator every frame.
+    cullingBindings[0].descriptorType = vk::DescriptorType::eStorageBufferDynamic;
+
+    vk::DescriptorSetLayoutCreateInfo cullingCreateInfo{};
+    cullingCreateInfo.bindingCount = cullingBindings.size();
+    cullingCreateInfo.pBindings = cullingBindings.data();
+
+    util::VK_ASSERT(_brain.device.createDescriptorSetLayout(&cullingCreateInfo, nullptr, &_cullingDescriptorSetLayout),
+                    "Failed creating culling descriptor set layout!");
+
+    std::array<vk::DescriptorSetLayoutBinding, 2> depthPyramidBindings{};
+    depthPyramidBindings[0].binding = 0;
+    depthPyramidBindings[0].descriptorCount = 1;
+    depthPyramidBindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    depthPyramidBindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    depthPyramidBindings[1].binding = 1;
+    depthPyramidBindings[1].descriptorCount = 1;
+    depthPyramidBindings[1].descriptorType = vk::DescriptorType::eStorageImage;
+    depthPyramidBindings[1].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutCreateInfo depthPyramidCreateInfo{};
+    depthPyramidCreateInfo.bindingCount = depthPyramidBindings.size();
+    depthPyramidCreateInfo.pBindings = depthPyramidBindings.data();
+
+    util::VK_ASSERT(_brain.device.createDescriptorSetLayout(&depthPyramidCreateInfo, nullptr, &_depthPyramidDescriptorSetLayout),
+                    "Failed creating depth pyramid descriptor set layout!");
+}
+
+void CullingPipeline::CreateDescriptorSets()
+{
+    std::array<vk::DescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts{};
+    std::for_each(layouts.begin(), layouts.end(), [this](auto& l)
+    { l = _cullingDescriptorSetLayout; });
+    vk::DescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.descriptorPool = _brain.descriptorPool;
+    allocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+    allocateInfo.pSetLayouts = layouts.data();
+
+    std::array<vk::DescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets;
+
+    util::VK_ASSERT(_brain.device.allocateDescriptorSets(&allocateInfo, descriptorSets.data()),
+                    "Failed allocating descriptor sets!");
+    for(size_t i = 0; i < descriptorSets.size(); ++i)
+    {
+        _frameData[i].descriptorSet = descriptorSets[i];
+        UpdateCullingDescriptorSet(i);
+    }
+}
+
+void CullingPipeline::UpdateCullingDescriptorSet(uint32_t frameIndex)
+{
+    uint32_t drawCapacity = _frameData[frameIndex].drawCapacity;
+
+    std::array<vk::DescriptorBufferInfo, 4> bufferInfos{};
+    bufferInfos[0].buffer = _frameAllocator.Buffer(frameIndex);
+    bufferInfos[0].range = sizeof(DrawInfo) * drawCapacity;
+    bufferInfos[1].buffer = _frameData[frameIndex].indirectBuffer;
+    bufferInfos[1].range = sizeof(vk::DrawIndexedIndirectCommand) * drawCapacity * 2;
+    bufferInfos[2].buffer = _frameData[frameIndex].visibilityBuffer;
+    bufferInfos[2].range = sizeof(uint32_t) * drawCapacity;
+    bufferInfos[3].buffer = _frameData[frameIndex].meshTaskBuffer;
+    bufferInfos[3].range = sizeof(vk::DrawMeshTasksIndirectCommandEXT) * drawCapacity * 2;
+
+    vk::DescriptorImageInfo imageInfo{};
+    imageInfo.sampler = *_sampler;
+    imageInfo.imageView = _depthPyramidView;
+    imageInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    std::array<vk::WriteDescriptorSet, 5> descriptorWrites{};
+    for(size_t i = 0; i < bufferInfos.size(); ++i)
+    {
+        // Binding 3 is the depth pyramid, the mesh task commands come after it.
+        uint32_t binding = i < 3 ? i : i + 1;
+        descriptorWrites[binding].dstSet = _frameData[frameIndex].descriptorSet;
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorType = binding == 0 ? vk::DescriptorType::eStorageBufferDynamic : vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[binding].descriptorCount = 1;
+        descriptorWrites[binding].pBufferInfo = &bufferInfos[i];
+    }
+
+    descriptorWrites[3].dstSet = _frameData[frameIndex].descriptorSet;
+    descriptorWrites[3].dstBinding = 3;
+    descriptorWrites[3].dstArrayElement = 0;
+    descriptorWrites[3].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    descriptorWrites[3].descriptorCount = 1;
+    descriptorWrites[3].pImageInfo = &imageInfo;
+
+    _brain.device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
+
+void CullingPipeline::CreateCullingPipeline(PipelineCompiler& compiler)
+{
+    std::array<vk::DescriptorSetLayout, 2> layouts = { _cullingDescriptorSetLayout, _camera.descriptorSetLayout };
+
+    vk::PushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullingPushConstants);
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.setLayoutCount = layouts.size();
+    pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_cullingPipelineLayout),
+                    "Failed creating culling pipeline layout!");
+
+    _cullingPipeline = compiler.Compile(ComputePipelineDescription{ "culling", "shaders/culling-c.spv", _cullingPipelineLayout });
+}
+
+void CullingPipeline::CreateDepthPyramidPipeline(PipelineCompiler& compiler)
+{
+    vk::PushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DepthPyramidPushConstants);
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &_depthPyramidDescriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_depthPyramidPipelineLayout),
+                    "Failed creating depth pyramid pipeline layout!");
+
+    _depthPyramidPipeline = compiler.Compile(ComputePipelineDescription{ "depth pyramid", "shaders/depth_pyramid-c.spv", _depthPyramidPipelineLayout });
+}
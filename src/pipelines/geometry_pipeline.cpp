@@ -1,35 +1,153 @@
 #include "pipelines/geometry_pipeline.hpp"
-#include "shaders/shader_loader.hpp"
 
 VkDeviceSize align(VkDeviceSize value, VkDeviceSize alignment) {
     return (value + alignment - 1) & ~(alignment - 1);
 }
 
-GeometryPipeline::GeometryPipeline(const VulkanBrain& brain, const GBuffers& gBuffers, vk::DescriptorSetLayout materialDescriptorSetLayout, const CameraStructure& camera) :
+namespace
+{
+// Primitives without a material, like the ones in the CPU benchmarks, use the variant that samples no maps.
+uint32_t FeatureMask(const MeshPrimitiveHandle& primitive)
+{
+    return primitive.material != nullptr ? primitive.material->featureMask : 0;
+}
+
+// Sets the specialization constants of the fragment shader to the maps in the feature mask.
+GraphicsPipelineDescription Specialize(GraphicsPipelineDescription description, uint32_t featureMask)
+{
+    description.name += fmt::format(" {:05b}", featureMask);
+    for(auto& shader : description.shaders)
+    {
+        if(shader.stage != vk::ShaderStageFlagBits::eFragment)
+            continue;
+
+        for(uint32_t i = 0; i < MaterialHandle::TEXTURE_COUNT; ++i)
+            shader.specializationConstants.emplace_back((featureMask >> i) & 1u);
+    }
+
+    return description;
+}
+}
+
+GeometryPipeline::GeometryPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const GBuffers& gBuffers, vk::DescriptorSetLayout materialDescriptorSetLayout, const CameraStructure& camera, const CullingPipeline& culling, const TextureStreamer& textureStreamer, FrameAllocator& frameAllocator) :
     _brain(brain),
+    _compiler(compiler),
     _gBuffers(gBuffers),
-    _camera(camera)
+    _camera(camera),
+    _culling(culling),
+    _textureStreamer(textureStreamer),
+    _frameAllocator(frameAllocator)
 {
+    _uniformStride = align(sizeof(UBO), _frameAllocator.Alignment());
+
     CreateDescriptorSetLayout();
-    CreateUniformBuffers();
     CreateDescriptorSets();
     CreatePipeline(materialDescriptorSetLayout);
+    if(_brain.meshShadersSupported)
+        CreateMeshPipeline(materialDescriptorSetLayout);
+
+    // The default material, used by primitives without one.
+    GetVariant(0);
 }
 
 GeometryPipeline::~GeometryPipeline()
 {
-    _brain.device.destroy(_pipeline);
-    _brain.device.destroy(_pipelineLayout);
-    for(size_t i = 0; i < _frameData.size(); ++i)
+    for(auto& [featureMask, variant] : _variants)
     {
-        vmaUnmapMemory(_brain.vmaAllocator, _frameData[i].uniformBufferAllocation);
-        vmaDestroyBuffer(_brain.vmaAllocator, _frameData[i].uniformBuffer, _frameData[i].uniformBufferAllocation);
+        variant.pipeline.Destroy(_brain.device);
+        variant.equalDepthPipeline.Destroy(_brain.device);
+        variant.meshPipeline.Destroy(_brain.device);
     }
+    _depthPipeline.Destroy(_brain.device);
+    _brain.device.destroy(_pipelineLayout);
+    _brain.device.destroy(_meshPipelineLayout);
+    _brain.device.destroy(_meshletDescriptorSetLayout);
     _brain.device.destroy(_descriptorSetLayout);
 }
 
-void GeometryPipeline::RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene)
+void GeometryPipeline::PrepareDrawCalls(uint32_t currentFrame, const SceneDescription& scene)
+{
+    std::vector<glm::mat4> transforms;
+    GatherDrawCalls(scene, static_cast<float>(_gBuffers.Size().y), _drawCalls, transforms);
+
+    // Variants of materials that weren't prepared yet block recording until they're compiled. Draws are sorted by
+    // feature mask, so every bucket is only looked up once.
+    for(size_t i = 0; i < _drawCalls.size(); ++i)
+        if(i == 0 || _drawCalls[i].featureMask != _drawCalls[i - 1].featureMask)
+            GetVariant(_drawCalls[i].featureMask);
+    for(const auto& primitive : scene.otherMeshes)
+        GetVariant(FeatureMask(primitive));
+
+    UpdateUniformData(currentFrame, transforms, scene.camera);
+}
+
+void GeometryPipeline::GatherDrawCalls(const SceneDescription& scene, float viewportHeight, std::vector<DrawCall>& drawCalls, std::vector<glm::mat4>& transforms)
+{
+    drawCalls.clear();
+    transforms.clear();
+
+    for(auto& gameObject : scene.gameObjects)
+    {
+        for(auto& node : gameObject.model->hierarchy.allNodes)
+        {
+            uint32_t uniformIndex = transforms.size();
+            glm::mat4 transform = gameObject.transform * node.transform;
+            transforms.emplace_back(transform);
+
+            for(const auto& primitive : node.mesh->primitives)
+            {
+                if(primitive.topology != vk::PrimitiveTopology::eTriangleList)
+                    throw std::runtime_error("No support for topology other than triangle list!");
+
+                drawCalls.emplace_back(DrawCall{ &primitive, transform, uniformIndex, SelectLOD(primitive, transform, scene.camera, viewportHeight), FeatureMask(primitive) });
+            }
+        }
+    }
+
+    // Buckets the draws by pipeline variant. Visibility only carries over from the early to the late culling phase of the
+    // same frame, so the order within a bucket doesn't have to stay the same between frames.
+    std::sort(drawCalls.begin(), drawCalls.end(), [](const DrawCall& a, const DrawCall& b) { return a.featureMask < b.featureMask; });
+}
+
+void GeometryPipeline::PrepareVariants(const ModelHandle& model)
 {
+    for(const auto& material : model.materials)
+        GetVariant(material->featureMask);
+}
+
+uint32_t GeometryPipeline::SelectLOD(const MeshPrimitiveHandle& primitive, const glm::mat4& transform, const Camera& camera, float viewportHeight)
+{
+    if(primitive.lods.size() <= 1)
+        return 0;
+
+    float scale = std::max({ glm::length(glm::vec3{ transform[0] }), glm::length(glm::vec3{ transform[1] }), glm::length(glm::vec3{ transform[2] }) });
+    glm::vec3 center = transform * glm::vec4{ (primitive.boundingBox.min + primitive.boundingBox.max) * 0.5f, 1.0f };
+    float radius = glm::length(primitive.boundingBox.max - primitive.boundingBox.min) * 0.5f * scale;
+
+    float distance = glm::length(center - camera.position) - radius;
+    if(distance <= camera.nearPlane)
+        return 0;
+
+    // Pixels covered by one world unit at the given distance.
+    float pixelsPerUnit = viewportHeight / (2.0f * std::tan(camera.fov * 0.5f) * distance);
+
+    uint32_t lod = 0;
+    while(lod + 1 < primitive.lods.size() && primitive.lods[lod + 1].error * scale * pixelsPerUnit <= LOD_ERROR_THRESHOLD)
+        ++lod;
+
+    return lod;
+}
+
+void GeometryPipeline::RecordCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene, CullingPhase phase)
+{
+    // Meshlets are culled individually in the task shader, which already removes most of the overdraw a pre-pass would save.
+    bool depthPrepass = _depthPrepass && !MeshShadingEnabled();
+    if(depthPrepass)
+        RecordDepthPrepassCommands(commandBuffer, currentFrame, scene, phase);
+
+    // The late phase adds to what the early phase rendered.
+    vk::AttachmentLoadOp loadOp = phase == CullingPhase::eEarly ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
+
     std::array<vk::RenderingAttachmentInfoKHR, DEFERRED_ATTACHMENT_COUNT> colorAttachmentInfos{};
     for(size_t i = 0; i < colorAttachmentInfos.size(); ++i)
     {
@@ -37,15 +155,16 @@ void GeometryPipeline::RecordCommands(vk::CommandBuffer commandBuffer, uint32_t
         info.imageView = _gBuffers.GBufferView(i);
         info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
         info.storeOp = vk::AttachmentStoreOp::eStore;
-        info.loadOp = vk::AttachmentLoadOp::eClear;
+        info.loadOp = loadOp;
         info.clearValue.color = vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 0.0f };
     }
 
     vk::RenderingAttachmentInfoKHR depthAttachmentInfo{};
     depthAttachmentInfo.imageView = _gBuffers.DepthImageView();
     depthAttachmentInfo.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
-    depthAttachmentInfo.storeOp = vk::AttachmentStoreOp::eDontCare;
-    depthAttachmentInfo.loadOp = vk::AttachmentLoadOp::eClear;
+    // Depth from the early phase is needed for building the depth pyramid and the late phase.
+    depthAttachmentInfo.storeOp = phase == CullingPhase::eEarly ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare;
+    depthAttachmentInfo.loadOp = depthPrepass ? vk::AttachmentLoadOp::eLoad : loadOp;
     depthAttachmentInfo.clearValue.depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
 
     vk::RenderingAttachmentInfoKHR  stencilAttachmentInfo{depthAttachmentInfo};
@@ -63,77 +182,194 @@ void GeometryPipeline::RecordCommands(vk::CommandBuffer commandBuffer, uint32_t
     renderingInfo.pDepthAttachment = &depthAttachmentInfo;
     renderingInfo.pStencilAttachment = util::HasStencilComponent(_gBuffers.DepthFormat()) ? &stencilAttachmentInfo : nullptr;
 
-    util::BeginLabel(commandBuffer, "Geometry pass", glm::vec3{ 6.0f, 214.0f, 160.0f } / 255.0f, _brain.dldi);
+    util::BeginLabel(commandBuffer, phase == CullingPhase::eEarly ? "Geometry pass early" : "Geometry pass late", glm::vec3{ 6.0f, 214.0f, 160.0f } / 255.0f, _brain.dldi);
 
     commandBuffer.beginRenderingKHR(&renderingInfo, _brain.dldi);
 
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
+    commandBuffer.setViewport(0, 1, &_gBuffers.Viewport());
+    commandBuffer.setScissor(0, 1, &_gBuffers.Scissor());
+
+    // With the pre-pass depth is already resolved, so only the closest surface passes the equal test.
+    RecordDraws(commandBuffer, currentFrame, scene, phase, depthPrepass ? DrawPass::eAfterDepthPrepass : DrawPass::eGeometry);
+
+    commandBuffer.endRenderingKHR(_brain.dldi);
+
+    util::EndLabel(commandBuffer, _brain.dldi);
+}
+
+void GeometryPipeline::RecordDepthPrepassCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene, CullingPhase phase)
+{
+    vk::RenderingAttachmentInfoKHR depthAttachmentInfo{};
+    depthAttachmentInfo.imageView = _gBuffers.DepthImageView();
+    depthAttachmentInfo.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depthAttachmentInfo.storeOp = vk::AttachmentStoreOp::eStore;
+    depthAttachmentInfo.loadOp = phase == CullingPhase::eEarly ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad;
+    depthAttachmentInfo.clearValue.depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+
+    vk::RenderingAttachmentInfoKHR  stencilAttachmentInfo{depthAttachmentInfo};
+    stencilAttachmentInfo.storeOp = vk::AttachmentStoreOp::eDontCare;
+    stencilAttachmentInfo.loadOp = vk::AttachmentLoadOp::eDontCare;
+    stencilAttachmentInfo.clearValue.depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+
+    vk::RenderingInfoKHR renderingInfo{};
+    glm::uvec2 displaySize = _gBuffers.Size();
+    renderingInfo.renderArea.extent = vk::Extent2D{ displaySize.x, displaySize.y };
+    renderingInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+    renderingInfo.colorAttachmentCount = 0;
+    renderingInfo.pColorAttachments = nullptr;
+    renderingInfo.layerCount = 1;
+    renderingInfo.pDepthAttachment = &depthAttachmentInfo;
+    renderingInfo.pStencilAttachment = util::HasStencilComponent(_gBuffers.DepthFormat()) ? &stencilAttachmentInfo : nullptr;
+
+    util::BeginLabel(commandBuffer, phase == CullingPhase::eEarly ? "Depth pre-pass early" : "Depth pre-pass late", glm::vec3{ 4.0f, 140.0f, 105.0f } / 255.0f, _brain.dldi);
+
+    commandBuffer.beginRenderingKHR(&renderingInfo, _brain.dldi);
 
     commandBuffer.setViewport(0, 1, &_gBuffers.Viewport());
     commandBuffer.setScissor(0, 1, &_gBuffers.Scissor());
 
-    std::vector<glm::mat4> transforms;
-    for(auto& gameObject : scene.gameObjects)
+    RecordDraws(commandBuffer, currentFrame, scene, phase, DrawPass::eDepthPrepass);
+
+    commandBuffer.endRenderingKHR(_brain.dldi);
+
+    util::EndLabel(commandBuffer, _brain.dldi);
+}
+
+void GeometryPipeline::RecordDraws(vk::CommandBuffer commandBuffer, uint32_t currentFrame, const SceneDescription& scene, CullingPhase phase, DrawPass pass)
+{
+    bool positionsOnly = pass == DrawPass::eDepthPrepass;
+
+    // The pre-pass doesn't shade, so it uses the same pipeline for every material.
+    auto pipelineFor = [&](uint32_t featureMask, bool meshShader)
     {
-        for(auto& node : gameObject.model->hierarchy.allNodes)
-        {
-            transforms.emplace_back(gameObject.transform * node.transform);
-        }
-    }
-    UpdateUniformData(currentFrame, transforms, scene.camera);
+        if(positionsOnly)
+            return _depthPipeline.Get();
 
-    for(const auto& primitive : scene.otherMeshes)
+        const Variant& variant = _variants.at(featureMask);
+        if(meshShader)
+            return variant.meshPipeline.Get();
+
+        return pass == DrawPass::eAfterDepthPrepass ? variant.equalDepthPipeline.Get() : variant.pipeline.Get();
+    };
+
+    vk::Pipeline boundPipeline = nullptr;
+    auto bindPipeline = [&](vk::Pipeline pipelineToBind)
     {
-        const MaterialHandle& material = *primitive.material;
+        if(boundPipeline == pipelineToBind)
+            return;
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineToBind);
+        boundPipeline = pipelineToBind;
+    };
 
-        uint32_t dynamicOffset = static_cast<uint32_t>(0 * sizeof(UBO));
+    auto bindPrimitive = [&](const MeshPrimitiveHandle& primitive, uint32_t uniformIndex, vk::PipelineLayout pipelineLayout)
+    {
+        uint32_t dynamicOffset = static_cast<uint32_t>(_frameData[currentFrame].uniformOffset + uniformIndex * _uniformStride);
 
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 0, 1, &_frameData[currentFrame].descriptorSet, 1, &dynamicOffset);
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 1, 1, &_camera.descriptorSets[currentFrame], 0, nullptr);
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 2, 1, &material.descriptorSet, 0, nullptr);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 1, &_frameData[currentFrame].descriptorSet, 1, &dynamicOffset);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, 1, &_camera.descriptorSets[currentFrame], 1, &_camera.offsets[currentFrame]);
+        if(!positionsOnly)
+        {
+            assert(primitive.material && "There should always be a material available.");
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 2, 1, &primitive.material->descriptorSet, 0, nullptr);
+        }
+    };
 
-        vk::Buffer vertexBuffers[] = { primitive.vertexBuffer };
+    auto bindBuffers = [&](const MeshPrimitiveHandle& primitive)
+    {
+        vk::Buffer vertexBuffers[] = { positionsOnly ? primitive.positionBuffer : primitive.vertexBuffer };
         vk::DeviceSize offsets[] = { 0 };
         commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
         commandBuffer.bindIndexBuffer(primitive.indexBuffer, 0, primitive.indexType);
+    };
 
-        commandBuffer.drawIndexed(primitive.indexCount, 1, 0, 0, 0);
+    // Meshes outside the scene hierarchy aren't culled, so they only need to be drawn once.
+    if(phase == CullingPhase::eEarly)
+    {
+        for(const auto& primitive : scene.otherMeshes)
+        {
+            bindPipeline(pipelineFor(FeatureMask(primitive), false));
+            bindPrimitive(primitive, 0, _pipelineLayout);
+            bindBuffers(primitive);
+            commandBuffer.drawIndexed(primitive.indexCount, 1, 0, 0, 0);
+        }
     }
 
-    uint32_t counter = 0;
-    for(auto& gameObject : scene.gameObjects)
+    bool meshShading = MeshShadingEnabled() && !positionsOnly;
+
+    // Instance and task counts are written by the culling pass, culled draws end up with zero instances or tasks.
+    vk::Buffer indirectBuffer = _culling.IndirectBuffer(currentFrame);
+    vk::DeviceSize indirectOffset = _culling.IndirectOffset(currentFrame, phase);
+    vk::Buffer meshTaskBuffer = _culling.MeshTaskBuffer(currentFrame);
+    vk::DeviceSize meshTaskOffset = _culling.MeshTaskOffset(currentFrame, phase);
+    // Draws are sorted by their features, so binding only changes between buckets.
+    for(size_t i = 0; i < _drawCalls.size(); ++i)
     {
-        for(size_t i = 0; i < gameObject.model->hierarchy.allNodes.size(); ++i, ++counter)
+        const DrawCall& drawCall = _drawCalls[i];
+
+        // Primitives without meshlets fall back to the regular indirect draw.
+        if(meshShading && drawCall.primitive->meshletCount > 0)
         {
-            const auto& node = gameObject.model->hierarchy.allNodes[i];
+            bindPipeline(pipelineFor(drawCall.featureMask, true));
+            bindPrimitive(*drawCall.primitive, drawCall.uniformIndex, _meshPipelineLayout);
 
-            for(const auto& primitive : node.mesh->primitives)
-            {
-                if(primitive.topology != vk::PrimitiveTopology::eTriangleList)
-                    throw std::runtime_error("No support for topology other than triangle list!");
+            vk::DescriptorSet meshletDescriptorSet = MeshletDescriptorSet(*drawCall.primitive);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _meshPipelineLayout, 3, 1, &meshletDescriptorSet, 0, nullptr);
+
+            MeshletPushConstants pushConstants{ drawCall.primitive->meshletCount };
+            commandBuffer.pushConstants(_meshPipelineLayout, vk::ShaderStageFlagBits::eTaskEXT, 0, sizeof(pushConstants), &pushConstants);
+
+            commandBuffer.drawMeshTasksIndirectEXT(meshTaskBuffer, meshTaskOffset + i * sizeof(vk::DrawMeshTasksIndirectCommandEXT), 1, sizeof(vk::DrawMeshTasksIndirectCommandEXT), _brain.dldi);
+            continue;
+        }
+
+        bindPipeline(pipelineFor(drawCall.featureMask, false));
+        bindPrimitive(*drawCall.primitive, drawCall.uniformIndex, _pipelineLayout);
+        bindBuffers(*drawCall.primitive);
+        commandBuffer.drawIndexedIndirect(indirectBuffer, indirectOffset + i * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
+    }
+}
 
-                assert(primitive.material && "There should always be a material available.");
-                const MaterialHandle& material = *primitive.material;
+vk::DescriptorSet GeometryPipeline::MeshletDescriptorSet(const MeshPrimitiveHandle& primitive)
+{
+    auto it = _meshletDescriptorSets.find(&primitive);
+    if(it != _meshletDescriptorSets.end())
+        return it->second;
 
-                uint32_t dynamicOffset = static_cast<uint32_t>(counter * sizeof(UBO));
+    vk::DescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.descriptorPool = _brain.descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &_meshletDescriptorSetLayout;
 
-                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 0, 1, &_frameData[currentFrame].descriptorSet, 1, &dynamicOffset);
-                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 1, 1, &_camera.descriptorSets[currentFrame], 0, nullptr);
-                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipelineLayout, 2, 1, &material.descriptorSet, 0, nullptr);
+    vk::DescriptorSet descriptorSet;
+    util::VK_ASSERT(_brain.device.allocateDescriptorSets(&allocateInfo, &descriptorSet),
+                    "Failed allocating meshlet descriptor set!");
 
-                vk::Buffer vertexBuffers[] = { primitive.vertexBuffer };
-                vk::DeviceSize offsets[] = { 0 };
-                commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-                commandBuffer.bindIndexBuffer(primitive.indexBuffer, 0, primitive.indexType);
+    std::array<vk::DescriptorBufferInfo, 4> bufferInfos{};
+    bufferInfos[0].buffer = primitive.meshletBuffer;
+    bufferInfos[1].buffer = primitive.meshletVertexBuffer;
+    bufferInfos[2].buffer = primitive.meshletTriangleBuffer;
+    bufferInfos[3].buffer = primitive.vertexBuffer;
 
-                commandBuffer.drawIndexed(primitive.indexCount, 1, 0, 0, 0);
-            }
-        }
+    std::array<vk::WriteDescriptorSet, 4> descriptorWrites{};
+    for(size_t i = 0; i < descriptorWrites.size(); ++i)
+    {
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = vk::WholeSize;
+
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
     }
 
-    commandBuffer.endRenderingKHR(_brain.dldi);
+    _brain.device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 
-    util::EndLabel(commandBuffer, _brain.dldi);
+    _meshletDescriptorSets.emplace(&primitive, descriptorSet);
+
+    return descriptorSet;
 }
 
 void GeometryPipeline::CreatePipeline(vk::DescriptorSetLayout materialDescriptorSetLayout)
@@ -148,138 +384,119 @@ void GeometryPipeline::CreatePipeline(vk::DescriptorSetLayout materialDescriptor
     util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_pipelineLayout),
                     "Failed creating geometry pipeline layout!");
 
-    auto vertByteCode = shader::ReadFile("shaders/geom-v.spv");
-    auto fragByteCode = shader::ReadFile("shaders/geom-f.spv");
-
-    vk::ShaderModule vertModule = shader::CreateShaderModule(vertByteCode, _brain.device);
-    vk::ShaderModule fragModule = shader::CreateShaderModule(fragByteCode, _brain.device);
-
-    vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
-    vertShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eVertex;
-    vertShaderStageCreateInfo.module = vertModule;
-    vertShaderStageCreateInfo.pName = "main";
+    _description.name = "geometry";
+    _description.shaders = { { vk::ShaderStageFlagBits::eVertex, "shaders/geom-v.spv" },
+                             { vk::ShaderStageFlagBits::eFragment, "shaders/geom-f.spv" } };
+    _description.layout = _pipelineLayout;
+    _description.vertexBindings = { Vertex::GetBindingDescription() };
+    auto attributes = Vertex::GetAttributeDescriptions();
+    _description.vertexAttributes.assign(attributes.begin(), attributes.end());
+    _description.frontFace = vk::FrontFace::eCounterClockwise;
+    _description.depthTest = true;
+    _description.depthWrite = true;
+    _description.colorFormats.assign(DEFERRED_ATTACHMENT_COUNT, GBuffers::GBufferFormat());
+    _description.depthFormat = _gBuffers.DepthFormat();
+
+    // Variant used after the depth pre-pass, only shades the fragments that ended up in the depth buffer.
+    _equalDepthDescription = _description;
+    _equalDepthDescription.name = "equal depth geometry";
+    _equalDepthDescription.depthWrite = false;
+    _equalDepthDescription.depthCompareOp = vk::CompareOp::eEqual;
+
+    // Depth pre-pass, only reads the position stream and has no fragment shader or color attachments.
+    GraphicsPipelineDescription depthDescription = _description;
+    depthDescription.name = "depth pre-pass";
+    depthDescription.shaders = { { vk::ShaderStageFlagBits::eVertex, "shaders/depth-v.spv" } };
+    depthDescription.vertexBindings = { Vertex::GetPositionBindingDescription() };
+    depthDescription.vertexAttributes = { Vertex::GetPositionAttributeDescription() };
+    depthDescription.colorFormats.clear();
+
+    _depthPipeline = _compiler.Compile(std::move(depthDescription));
+}
 
-    vk::PipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
-    fragShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eFragment;
-    fragShaderStageCreateInfo.module = fragModule;
-    fragShaderStageCreateInfo.pName = "main";
+void GeometryPipeline::CreateMeshPipeline(vk::DescriptorSetLayout materialDescriptorSetLayout)
+{
+    // Meshlets, meshlet vertices, meshlet triangles and vertices.
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings{};
+    for(size_t i = 0; i < bindings.size(); ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[i].stageFlags = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+    }
 
-    vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo };
+    vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+    descriptorSetLayoutCreateInfo.bindingCount = bindings.size();
+    descriptorSetLayoutCreateInfo.pBindings = bindings.data();
 
-    auto bindingDesc = Vertex::GetBindingDescription();
-    auto attributes = Vertex::GetAttributeDescriptions();
+    util::VK_ASSERT(_brain.device.createDescriptorSetLayout(&descriptorSetLayoutCreateInfo, nullptr, &_meshletDescriptorSetLayout),
+                    "Failed creating meshlet descriptor set layout!");
 
-    vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
-    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputStateCreateInfo.pVertexBindingDescriptions = &bindingDesc;
-    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = attributes.size();
-    vertexInputStateCreateInfo.pVertexAttributeDescriptions = attributes.data();
+    vk::PushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eTaskEXT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(MeshletPushConstants);
 
-    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
-    inputAssemblyStateCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
-    inputAssemblyStateCreateInfo.primitiveRestartEnable = vk::False;
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    std::array<vk::DescriptorSetLayout, 4> layouts = { _descriptorSetLayout, _camera.descriptorSetLayout, materialDescriptorSetLayout, _meshletDescriptorSetLayout };
+    pipelineLayoutCreateInfo.setLayoutCount = layouts.size();
+    pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_meshPipelineLayout),
+                    "Failed creating mesh pipeline layout!");
+
+    _meshDescription.name = "mesh shading";
+    _meshDescription.shaders = { { vk::ShaderStageFlagBits::eTaskEXT, "shaders/meshlet-t.spv" },
+                                 { vk::ShaderStageFlagBits::eMeshEXT, "shaders/meshlet-m.spv" },
+                                 { vk::ShaderStageFlagBits::eFragment, "shaders/geom-f.spv" } };
+    _meshDescription.layout = _meshPipelineLayout;
+    _meshDescription.frontFace = vk::FrontFace::eCounterClockwise;
+    _meshDescription.depthTest = true;
+    _meshDescription.depthWrite = true;
+    _meshDescription.colorFormats.assign(DEFERRED_ATTACHMENT_COUNT, GBuffers::GBufferFormat());
+    _meshDescription.depthFormat = _gBuffers.DepthFormat();
+}
 
-    std::array<vk::DynamicState, 2> dynamicStates = {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor,
-    };
+const GeometryPipeline::Variant& GeometryPipeline::GetVariant(uint32_t featureMask)
+{
+    auto it = _variants.find(featureMask);
+    if(it != _variants.end())
+        return it->second;
 
-    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-    vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.scissorCount = 1;
-
-    vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
-    rasterizationStateCreateInfo.depthClampEnable = vk::False;
-    rasterizationStateCreateInfo.rasterizerDiscardEnable = vk::False;
-    rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
-    rasterizationStateCreateInfo.lineWidth = 1.0f;
-    rasterizationStateCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
-    rasterizationStateCreateInfo.frontFace = vk::FrontFace::eCounterClockwise;
-    rasterizationStateCreateInfo.depthBiasEnable = vk::False;
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
-
-    vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
-    multisampleStateCreateInfo.sampleShadingEnable = vk::False;
-    multisampleStateCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
-    multisampleStateCreateInfo.minSampleShading = 1.0f;
-    multisampleStateCreateInfo.pSampleMask = nullptr;
-    multisampleStateCreateInfo.alphaToCoverageEnable = vk::False;
-    multisampleStateCreateInfo.alphaToOneEnable = vk::False;
-
-    std::array<vk::PipelineColorBlendAttachmentState, DEFERRED_ATTACHMENT_COUNT> colorBlendAttachmentStates{};
-    for(auto& blendAttachmentState : colorBlendAttachmentStates)
-    {
-        blendAttachmentState.blendEnable = vk::False;
-        blendAttachmentState.colorWriteMask =
-                vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eA;
-    }
+    Variant variant{};
+    variant.pipeline = _compiler.Compile(Specialize(_description, featureMask));
+    variant.equalDepthPipeline = _compiler.Compile(Specialize(_equalDepthDescription, featureMask));
+    if(_brain.meshShadersSupported)
+        variant.meshPipeline = _compiler.Compile(Specialize(_meshDescription, featureMask));
 
-    vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
-    colorBlendStateCreateInfo.logicOpEnable = vk::False;
-    colorBlendStateCreateInfo.attachmentCount = colorBlendAttachmentStates.size();
-    colorBlendStateCreateInfo.pAttachments = colorBlendAttachmentStates.data();
-
-    vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
-    depthStencilStateCreateInfo.depthTestEnable = true;
-    depthStencilStateCreateInfo.depthWriteEnable = true;
-    depthStencilStateCreateInfo.depthCompareOp = vk::CompareOp::eLess;
-    depthStencilStateCreateInfo.depthBoundsTestEnable = false;
-    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
-    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
-    depthStencilStateCreateInfo.stencilTestEnable = false;
-
-    vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-    pipelineCreateInfo.layout = _pipelineLayout;
-    pipelineCreateInfo.subpass = 0;
-    pipelineCreateInfo.basePipelineHandle = nullptr;
-    pipelineCreateInfo.basePipelineIndex = -1;
-
-    vk::PipelineRenderingCreateInfoKHR pipelineRenderingCreateInfoKhr{};
-    std::array<vk::Format, DEFERRED_ATTACHMENT_COUNT> formats{};
-    std::fill(formats.begin(), formats.end(), GBuffers::GBufferFormat());
-    pipelineRenderingCreateInfoKhr.colorAttachmentCount = DEFERRED_ATTACHMENT_COUNT;
-    pipelineRenderingCreateInfoKhr.pColorAttachmentFormats = formats.data();
-    pipelineRenderingCreateInfoKhr.depthAttachmentFormat = _gBuffers.DepthFormat();
-
-    pipelineCreateInfo.pNext = &pipelineRenderingCreateInfoKhr;
-    pipelineCreateInfo.renderPass = nullptr; // Using dynamic rendering.
-
-    auto result = _brain.device.createGraphicsPipeline(nullptr, pipelineCreateInfo, nullptr);
-    util::VK_ASSERT(result.result, "Failed creating the geometry pipeline layout!");
-    _pipeline = result.value;
-
-    _brain.device.destroy(vertModule);
-    _brain.device.destroy(fragModule);
+    return _variants.emplace(featureMask, std::move(variant)).first->second;
 }
 
 void GeometryPipeline::CreateDescriptorSetLayout()
 {
-    std::array<vk::DescriptorSetLayoutBinding, 1> bindings{};
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings{};
 
     vk::DescriptorSetLayoutBinding& descriptorSetLayoutBinding{bindings[0]};
     descriptorSetLayoutBinding.binding = 0;
     descriptorSetLayoutBinding.descriptorCount = 1;
     descriptorSetLayoutBinding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
     descriptorSetLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+    if(_brain.meshShadersSupported)
+        descriptorSetLayoutBinding.stageFlags |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
     descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
+    // Texture streaming: full texture sizes and the mip feedback written by the fragment shader.
+    for(uint32_t i = 1; i < bindings.size(); ++i)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[i].stageFlags = vk::ShaderStageFlagBits::eFragment;
+    }
+
     vk::DescriptorSetLayoutCreateInfo createInfo{};
     createInfo.bindingCount = bindings.size();
     createInfo.pBindings = bindings.data();
@@ -312,11 +529,17 @@ void GeometryPipeline::CreateDescriptorSets()
 void GeometryPipeline::UpdateGeometryDescriptorSet(uint32_t frameIndex)
 {
     vk::DescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = _frameData[frameIndex].uniformBuffer;
+    bufferInfo.buffer = _frameAllocator.Buffer(frameIndex);
     bufferInfo.offset = 0;
     bufferInfo.range = sizeof(UBO);
 
-    std::array<vk::WriteDescriptorSet, 1> descriptorWrites{};
+    std::array<vk::DescriptorBufferInfo, 2> streamingInfos{};
+    streamingInfos[0].buffer = _textureStreamer.TextureSizeBuffer();
+    streamingInfos[0].range = vk::WholeSize;
+    streamingInfos[1].buffer = _textureStreamer.FeedbackBuffer();
+    streamingInfos[1].range = vk::WholeSize;
+
+    std::array<vk::WriteDescriptorSet, 3> descriptorWrites{};
 
     vk::WriteDescriptorSet& bufferWrite{ descriptorWrites[0] };
     bufferWrite.dstSet = _frameData[frameIndex].descriptorSet;
@@ -326,32 +549,29 @@ void GeometryPipeline::UpdateGeometryDescriptorSet(uint32_t frameIndex)
     bufferWrite.descriptorCount = 1;
     bufferWrite.pBufferInfo = &bufferInfo;
 
-    _brain.device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-}
-
-void GeometryPipeline::CreateUniformBuffers()
-{
-    vk::DeviceSize bufferSize = sizeof(UBO) * MAX_MESHES;
-
-    for(size_t i = 0; i < _frameData.size(); ++i)
+    for(uint32_t i = 0; i < streamingInfos.size(); ++i)
     {
-        util::CreateBuffer(_brain, bufferSize,
-                           vk::BufferUsageFlagBits::eUniformBuffer,
-                           _frameData[i].uniformBuffer, true, _frameData[i].uniformBufferAllocation,
-                           VMA_MEMORY_USAGE_CPU_ONLY,
-                           "Uniform buffer");
-
-        util::VK_ASSERT(vmaMapMemory(_brain.vmaAllocator, _frameData[i].uniformBufferAllocation, &_frameData[i].uniformBufferMapped), "Failed mapping memory for UBO!");
+        descriptorWrites[i + 1].dstSet = _frameData[frameIndex].descriptorSet;
+        descriptorWrites[i + 1].dstBinding = i + 1;
+        descriptorWrites[i + 1].dstArrayElement = 0;
+        descriptorWrites[i + 1].descriptorType = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[i + 1].descriptorCount = 1;
+        descriptorWrites[i + 1].pBufferInfo = &streamingInfos[i];
     }
+
+    _brain.device.updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
-void GeometryPipeline::UpdateUniformData(uint32_t currentFrame, const std::vector<glm::mat4> transforms, const Camera& camera)
+void GeometryPipeline::UpdateUniformData(uint32_t currentFrame, const std::vector<glm::mat4>& transforms, const Camera& camera)
 {
-    std::array<UBO, MAX_MESHES> ubos;
-    for(size_t i = 0; i < std::min(transforms.size(), ubos.size()); ++i)
+    // Meshes outside the hierarchy use the first transform, so there's always at least one.
+    FrameAllocation allocation = _frameAllocator.Allocate(currentFrame, std::max(transforms.size(), size_t{ 1 }) * _uniformStride);
+    _frameData[currentFrame].uniformOffset = allocation.offset;
+
+    auto* mapped = static_cast<std::byte*>(allocation.mapped);
+    for(size_t i = 0; i < transforms.size(); ++i)
     {
-        ubos[i].model = transforms[i];
+        UBO ubo{ transforms[i] };
+        std::memcpy(mapped + i * _uniformStride, &ubo, sizeof(UBO));
     }
-
-    memcpy(_frameData[currentFrame].uniformBufferMapped, ubos.data(), ubos.size() * sizeof(UBO));
 }
@@ -1,10 +1,10 @@
 #include "pipelines/ibl_pipeline.hpp"
 #include "vulkan_helper.hpp"
-#include "shaders/shader_loader.hpp"
+#include "memory_manager.hpp"
 #include "single_time_commands.hpp"
 #include "stopwatch.hpp"
 
-IBLPipeline::IBLPipeline(const VulkanBrain& brain, const TextureHandle& environmentMap) :
+IBLPipeline::IBLPipeline(const VulkanBrain& brain, PipelineCompiler& compiler, const TextureHandle& environmentMap) :
     _brain(brain),
     _environmentMap(environmentMap)
 {
@@ -21,32 +21,32 @@ IBLPipeline::IBLPipeline(const VulkanBrain& brain, const TextureHandle& environm
     CreateBRDFLUT();
     CreateDescriptorSetLayout();
     CreateDescriptorSet();
-    CreateIrradiancePipeline();
-    CreatePrefilterPipeline();
-    CreateBRDFLUTPipeline();
+    CreateIrradiancePipeline(compiler);
+    CreatePrefilterPipeline(compiler);
+    CreateBRDFLUTPipeline(compiler);
 }
 
 IBLPipeline::~IBLPipeline()
 {
-    vmaDestroyImage(_brain.vmaAllocator, _irradianceMap.image, _irradianceMap.allocation);
+    util::DestroyImage(_brain.vmaAllocator, _irradianceMap.image, _irradianceMap.allocation);
     _brain.device.destroy(_irradianceMap.view);
     for(const auto& view : _irradianceMapViews)
         _brain.device.destroy(view);
 
-    vmaDestroyImage(_brain.vmaAllocator, _prefilterMap.image, _prefilterMap.allocation);
+    util::DestroyImage(_brain.vmaAllocator, _prefilterMap.image, _prefilterMap.allocation);
     _brain.device.destroy(_prefilterMap.view);
     for(const auto& mips : _prefilterMapViews)
         for(const auto& view : mips)
             _brain.device.destroy(view);
 
-    vmaDestroyImage(_brain.vmaAllocator, _brdfLUT.image, _brdfLUT.imageAllocation);
+    util::DestroyImage(_brain.vmaAllocator, _brdfLUT.image, _brdfLUT.imageAllocation);
     _brain.device.destroy(_brdfLUT.imageView);
 
-    _brain.device.destroy(_prefilterPipeline);
+    _prefilterPipeline.Destroy(_brain.device);
     _brain.device.destroy(_prefilterPipelineLayout);
-    _brain.device.destroy(_irradiancePipeline);
+    _irradiancePipeline.Destroy(_brain.device);
     _brain.device.destroy(_irradiancePipelineLayout);
-    _brain.device.destroy(_brdfLUTPipeline);
+    _brdfLUTPipeline.Destroy(_brain.device);
     _brain.device.destroy(_brdfLUTPipelineLayout);
     _brain.device.destroy(_descriptorSetLayout);
 }
@@ -77,7 +77,7 @@ void IBLPipeline::RecordCommands(vk::CommandBuffer commandBuffer)
         commandBuffer.beginRenderingKHR(&renderingInfo, _brain.dldi);
 
         commandBuffer.pushConstants(_irradiancePipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t), &i);
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _irradiancePipeline);
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _irradiancePipeline.Get());
         commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _irradiancePipelineLayout, 0, 1, &_descriptorSet, 0, nullptr);
 
         vk::Viewport viewport = vk::Viewport{ 0.0f, 0.0f, static_cast<float>(_irradianceMap.size), static_cast<float>(_irradianceMap.size), 0.0f,
@@ -126,7 +126,7 @@ void IBLPipeline::RecordCommands(vk::CommandBuffer commandBuffer)
             PrefilterPushConstant pc{ static_cast<uint32_t>(j), static_cast<float>(i) / static_cast<float>(_prefilterMap.mipLevels - 1)};
 
             commandBuffer.pushConstants(_prefilterPipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(PrefilterPushConstant), &pc);
-            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _prefilterPipeline);
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _prefilterPipeline.Get());
             commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _prefilterPipelineLayout, 0, 1, &_descriptorSet, 0, nullptr);
 
             vk::Viewport viewport = vk::Viewport{ 0.0f, 0.0f, static_cast<float>(size), static_cast<float>(size), 0.0f,
@@ -169,7 +169,7 @@ void IBLPipeline::RecordCommands(vk::CommandBuffer commandBuffer)
 
     commandBuffer.beginRenderingKHR(&renderingInfo, _brain.dldi);
 
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _brdfLUTPipeline);
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _brdfLUTPipeline.Get());
 
     vk::Viewport viewport = vk::Viewport{ 0.0f, 0.0f, static_cast<float>(size), static_cast<float>(size), 0.0f,
                                           1.0f };
@@ -188,7 +188,7 @@ void IBLPipeline::RecordCommands(vk::CommandBuffer commandBuffer)
     util::EndLabel(commandBuffer, _brain.dldi);
 }
 
-void IBLPipeline::CreateIrradiancePipeline()
+void IBLPipeline::CreateIrradiancePipeline(PipelineCompiler& compiler)
 {
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
     std::array<vk::DescriptorSetLayout, 1> layouts = { _descriptorSetLayout };
@@ -205,118 +205,17 @@ void IBLPipeline::CreateIrradiancePipeline()
     util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_irradiancePipelineLayout),
                     "Failed to create IBL pipeline layout!");
 
-    auto vertByteCode = shader::ReadFile("shaders/irradiance-v.spv");
-    auto fragByteCode = shader::ReadFile("shaders/irradiance-f.spv");
-
-    vk::ShaderModule vertModule = shader::CreateShaderModule(vertByteCode, _brain.device);
-    vk::ShaderModule fragModule = shader::CreateShaderModule(fragByteCode, _brain.device);
-
-    vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
-    vertShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eVertex;
-    vertShaderStageCreateInfo.module = vertModule;
-    vertShaderStageCreateInfo.pName = "main";
-
-    vk::PipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
-    fragShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eFragment;
-    fragShaderStageCreateInfo.module = fragModule;
-    fragShaderStageCreateInfo.pName = "main";
-
-    vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo };
-
-    vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
-
-    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
-    inputAssemblyStateCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
-    inputAssemblyStateCreateInfo.primitiveRestartEnable = vk::False;
-
-    std::array<vk::DynamicState, 2> dynamicStates = {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor,
-    };
-
-    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-    vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.scissorCount = 1;
-
-    vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
-    rasterizationStateCreateInfo.depthClampEnable = vk::False;
-    rasterizationStateCreateInfo.rasterizerDiscardEnable = vk::False;
-    rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
-    rasterizationStateCreateInfo.lineWidth = 1.0f;
-    rasterizationStateCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
-    rasterizationStateCreateInfo.frontFace = vk::FrontFace::eClockwise;
-    rasterizationStateCreateInfo.depthBiasEnable = vk::False;
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
-
-    vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
-    multisampleStateCreateInfo.sampleShadingEnable = vk::False;
-    multisampleStateCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
-    multisampleStateCreateInfo.minSampleShading = 1.0f;
-    multisampleStateCreateInfo.pSampleMask = nullptr;
-    multisampleStateCreateInfo.alphaToCoverageEnable = vk::False;
-    multisampleStateCreateInfo.alphaToOneEnable = vk::False;
-
-    std::array<vk::PipelineColorBlendAttachmentState, 1> colorBlendAttachmentStates{};
-    for(auto& blendAttachmentState : colorBlendAttachmentStates)
-    {
-        blendAttachmentState.blendEnable = vk::False;
-        blendAttachmentState.colorWriteMask =
-                vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eA;
-    }
+    GraphicsPipelineDescription description{};
+    description.name = "irradiance";
+    description.shaders = { { vk::ShaderStageFlagBits::eVertex, "shaders/irradiance-v.spv" },
+                            { vk::ShaderStageFlagBits::eFragment, "shaders/irradiance-f.spv" } };
+    description.layout = _irradiancePipelineLayout;
+    description.colorFormats = { _irradianceMap.format };
 
-    vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
-    colorBlendStateCreateInfo.logicOpEnable = vk::False;
-    colorBlendStateCreateInfo.attachmentCount = colorBlendAttachmentStates.size();
-    colorBlendStateCreateInfo.pAttachments = colorBlendAttachmentStates.data();
-
-    vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
-    depthStencilStateCreateInfo.depthTestEnable = true;
-    depthStencilStateCreateInfo.depthWriteEnable = true;
-    depthStencilStateCreateInfo.depthCompareOp = vk::CompareOp::eLess;
-    depthStencilStateCreateInfo.depthBoundsTestEnable = false;
-    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
-    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
-    depthStencilStateCreateInfo.stencilTestEnable = false;
-
-    vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-    pipelineCreateInfo.layout = _irradiancePipelineLayout;
-    pipelineCreateInfo.subpass = 0;
-    pipelineCreateInfo.basePipelineHandle = nullptr;
-    pipelineCreateInfo.basePipelineIndex = -1;
-
-    vk::PipelineRenderingCreateInfoKHR pipelineRenderingCreateInfoKhr{};
-    pipelineRenderingCreateInfoKhr.colorAttachmentCount = 1;
-    pipelineRenderingCreateInfoKhr.pColorAttachmentFormats = &_irradianceMap.format;
-
-    pipelineCreateInfo.pNext = &pipelineRenderingCreateInfoKhr;
-    pipelineCreateInfo.renderPass = nullptr; // Using dynamic rendering.
-
-    auto result = _brain.device.createGraphicsPipeline(nullptr, pipelineCreateInfo, nullptr);
-    util::VK_ASSERT(result.result, "Failed creating the IBL pipeline!");
-    _irradiancePipeline = result.value;
-
-    _brain.device.destroy(vertModule);
-    _brain.device.destroy(fragModule);
+    _irradiancePipeline = compiler.Compile(std::move(description));
 }
 
-void IBLPipeline::CreatePrefilterPipeline()
+void IBLPipeline::CreatePrefilterPipeline(PipelineCompiler& compiler)
 {
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
     std::array<vk::DescriptorSetLayout, 1> layouts = { _descriptorSetLayout };
@@ -334,118 +233,17 @@ void IBLPipeline::CreatePrefilterPipeline()
     util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_prefilterPipelineLayout),
                     "Failed to create IBL pipeline layout!");
 
-    auto vertByteCode = shader::ReadFile("shaders/prefilter-v.spv");
-    auto fragByteCode = shader::ReadFile("shaders/prefilter-f.spv");
-
-    vk::ShaderModule vertModule = shader::CreateShaderModule(vertByteCode, _brain.device);
-    vk::ShaderModule fragModule = shader::CreateShaderModule(fragByteCode, _brain.device);
-
-    vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
-    vertShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eVertex;
-    vertShaderStageCreateInfo.module = vertModule;
-    vertShaderStageCreateInfo.pName = "main";
-
-    vk::PipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
-    fragShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eFragment;
-    fragShaderStageCreateInfo.module = fragModule;
-    fragShaderStageCreateInfo.pName = "main";
-
-    vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo };
-
-    vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
-
-    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
-    inputAssemblyStateCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
-    inputAssemblyStateCreateInfo.primitiveRestartEnable = vk::False;
-
-    std::array<vk::DynamicState, 2> dynamicStates = {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor,
-    };
-
-    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-    vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.scissorCount = 1;
-
-    vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
-    rasterizationStateCreateInfo.depthClampEnable = vk::False;
-    rasterizationStateCreateInfo.rasterizerDiscardEnable = vk::False;
-    rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
-    rasterizationStateCreateInfo.lineWidth = 1.0f;
-    rasterizationStateCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
-    rasterizationStateCreateInfo.frontFace = vk::FrontFace::eClockwise;
-    rasterizationStateCreateInfo.depthBiasEnable = vk::False;
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
-
-    vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
-    multisampleStateCreateInfo.sampleShadingEnable = vk::False;
-    multisampleStateCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
-    multisampleStateCreateInfo.minSampleShading = 1.0f;
-    multisampleStateCreateInfo.pSampleMask = nullptr;
-    multisampleStateCreateInfo.alphaToCoverageEnable = vk::False;
-    multisampleStateCreateInfo.alphaToOneEnable = vk::False;
-
-    std::array<vk::PipelineColorBlendAttachmentState, 1> colorBlendAttachmentStates{};
-    for(auto& blendAttachmentState : colorBlendAttachmentStates)
-    {
-        blendAttachmentState.blendEnable = vk::False;
-        blendAttachmentState.colorWriteMask =
-                vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eA;
-    }
+    GraphicsPipelineDescription description{};
+    description.name = "prefilter";
+    description.shaders = { { vk::ShaderStageFlagBits::eVertex, "shaders/prefilter-v.spv" },
+                            { vk::ShaderStageFlagBits::eFragment, "shaders/prefilter-f.spv" } };
+    description.layout = _prefilterPipelineLayout;
+    description.colorFormats = { _prefilterMap.format };
 
-    vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
-    colorBlendStateCreateInfo.logicOpEnable = vk::False;
-    colorBlendStateCreateInfo.attachmentCount = colorBlendAttachmentStates.size();
-    colorBlendStateCreateInfo.pAttachments = colorBlendAttachmentStates.data();
-
-    vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
-    depthStencilStateCreateInfo.depthTestEnable = true;
-    depthStencilStateCreateInfo.depthWriteEnable = true;
-    depthStencilStateCreateInfo.depthCompareOp = vk::CompareOp::eLess;
-    depthStencilStateCreateInfo.depthBoundsTestEnable = false;
-    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
-    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
-    depthStencilStateCreateInfo.stencilTestEnable = false;
-
-    vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-    pipelineCreateInfo.layout = _prefilterPipelineLayout;
-    pipelineCreateInfo.subpass = 0;
-    pipelineCreateInfo.basePipelineHandle = nullptr;
-    pipelineCreateInfo.basePipelineIndex = -1;
-
-    vk::PipelineRenderingCreateInfoKHR pipelineRenderingCreateInfoKhr{};
-    pipelineRenderingCreateInfoKhr.colorAttachmentCount = 1;
-    pipelineRenderingCreateInfoKhr.pColorAttachmentFormats = &_prefilterMap.format;
-
-    pipelineCreateInfo.pNext = &pipelineRenderingCreateInfoKhr;
-    pipelineCreateInfo.renderPass = nullptr; // Using dynamic rendering.
-
-    auto result = _brain.device.createGraphicsPipeline(nullptr, pipelineCreateInfo, nullptr);
-    util::VK_ASSERT(result.result, "Failed creating the IBL pipeline!");
-    _prefilterPipeline = result.value;
-
-    _brain.device.destroy(vertModule);
-    _brain.device.destroy(fragModule);
+    _prefilterPipeline = compiler.Compile(std::move(description));
 }
 
-void IBLPipeline::CreateBRDFLUTPipeline()
+void IBLPipeline::CreateBRDFLUTPipeline(PipelineCompiler& compiler)
 {
     vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
     std::array<vk::DescriptorSetLayout, 1> layouts = { _descriptorSetLayout };
@@ -457,115 +255,14 @@ void IBLPipeline::CreateBRDFLUTPipeline()
     util::VK_ASSERT(_brain.device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &_brdfLUTPipelineLayout),
                     "Failed to create IBL pipeline layout!");
 
-    auto vertByteCode = shader::ReadFile("shaders/brdf_integration-v.spv");
-    auto fragByteCode = shader::ReadFile("shaders/brdf_integration-f.spv");
-
-    vk::ShaderModule vertModule = shader::CreateShaderModule(vertByteCode, _brain.device);
-    vk::ShaderModule fragModule = shader::CreateShaderModule(fragByteCode, _brain.device);
-
-    vk::PipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
-    vertShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eVertex;
-    vertShaderStageCreateInfo.module = vertModule;
-    vertShaderStageCreateInfo.pName = "main";
-
-    vk::PipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
-    fragShaderStageCreateInfo.stage = vk::ShaderStageFlagBits::eFragment;
-    fragShaderStageCreateInfo.module = fragModule;
-    fragShaderStageCreateInfo.pName = "main";
-
-    vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo };
-
-    vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
-
-    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
-    inputAssemblyStateCreateInfo.topology = vk::PrimitiveTopology::eTriangleList;
-    inputAssemblyStateCreateInfo.primitiveRestartEnable = vk::False;
-
-    std::array<vk::DynamicState, 2> dynamicStates = {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor,
-    };
-
-    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-    dynamicStateCreateInfo.dynamicStateCount = dynamicStates.size();
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
-
-    vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.scissorCount = 1;
-
-    vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
-    rasterizationStateCreateInfo.depthClampEnable = vk::False;
-    rasterizationStateCreateInfo.rasterizerDiscardEnable = vk::False;
-    rasterizationStateCreateInfo.polygonMode = vk::PolygonMode::eFill;
-    rasterizationStateCreateInfo.lineWidth = 1.0f;
-    rasterizationStateCreateInfo.cullMode = vk::CullModeFlagBits::eBack;
-    rasterizationStateCreateInfo.frontFace = vk::FrontFace::eClockwise;
-    rasterizationStateCreateInfo.depthBiasEnable = vk::False;
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
-
-    vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
-    multisampleStateCreateInfo.sampleShadingEnable = vk::False;
-    multisampleStateCreateInfo.rasterizationSamples = vk::SampleCountFlagBits::e1;
-    multisampleStateCreateInfo.minSampleShading = 1.0f;
-    multisampleStateCreateInfo.pSampleMask = nullptr;
-    multisampleStateCreateInfo.alphaToCoverageEnable = vk::False;
-    multisampleStateCreateInfo.alphaToOneEnable = vk::False;
-
-    std::array<vk::PipelineColorBlendAttachmentState, 1> colorBlendAttachmentStates{};
-    for(auto& blendAttachmentState : colorBlendAttachmentStates)
-    {
-        blendAttachmentState.blendEnable = vk::False;
-        blendAttachmentState.colorWriteMask =
-                vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
-                vk::ColorComponentFlagBits::eA;
-    }
+    GraphicsPipelineDescription description{};
+    description.name = "BRDF integration";
+    description.shaders = { { vk::ShaderStageFlagBits::eVertex, "shaders/brdf_integration-v.spv" },
+                            { vk::ShaderStageFlagBits::eFragment, "shaders/brdf_integration-f.spv" } };
+    description.layout = _brdfLUTPipelineLayout;
+    description.colorFormats = { _brdfLUT.format };
 
-    vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
-    colorBlendStateCreateInfo.logicOpEnable = vk::False;
-    colorBlendStateCreateInfo.attachmentCount = colorBlendAttachmentStates.size();
-    colorBlendStateCreateInfo.pAttachments = colorBlendAttachmentStates.data();
-
-    vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
-    depthStencilStateCreateInfo.depthTestEnable = true;
-    depthStencilStateCreateInfo.depthWriteEnable = true;
-    depthStencilStateCreateInfo.depthCompareOp = vk::CompareOp::eLess;
-    depthStencilStateCreateInfo.depthBoundsTestEnable = false;
-    depthStencilStateCreateInfo.minDepthBounds = 0.0f;
-    depthStencilStateCreateInfo.maxDepthBounds = 1.0f;
-    depthStencilStateCreateInfo.stencilTestEnable = false;
-
-    vk::GraphicsPipelineCreateInfo pipelineCreateInfo{};
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
-    pipelineCreateInfo.layout = _brdfLUTPipelineLayout;
-    pipelineCreateInfo.subpass = 0;
-    pipelineCreateInfo.basePipelineHandle = nullptr;
-    pipelineCreateInfo.basePipelineIndex = -1;
-
-    vk::PipelineRenderingCreateInfoKHR pipelineRenderingCreateInfoKhr{};
-    pipelineRenderingCreateInfoKhr.colorAttachmentCount = 1;
-    pipelineRenderingCreateInfoKhr.pColorAttachmentFormats = &_brdfLUT.format;
-
-    pipelineCreateInfo.pNext = &pipelineRenderingCreateInfoKhr;
-    pipelineCreateInfo.renderPass = nullptr; // Using dynamic rendering.
-
-    auto result = _brain.device.createGraphicsPipeline(nullptr, pipelineCreateInfo, nullptr);
-    util::VK_ASSERT(result.result, "Failed creating the IBL pipeline!");
-    _brdfLUTPipeline = result.value;
-
-    _brain.device.destroy(vertModule);
-    _brain.device.destroy(fragModule);
+    _brdfLUTPipeline = compiler.Compile(std::move(description));
 }
 
 void IBLPipeline::CreateDescriptorSetLayout()
@@ -634,7 +331,7 @@ void IBLPipeline::CreateIrradianceCubemap()
     allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
     util::VK_ASSERT(vmaCreateImage(_brain.vmaAllocator, reinterpret_cast<VkImageCreateInfo*>(&imageCreateInfo), &allocationInfo, reinterpret_cast<VkImage*>(&_irradianceMap.image), &_irradianceMap.allocation, nullptr), "Failed creating image!");
-    vmaSetAllocationName(_brain.vmaAllocator, _irradianceMap.allocation, "Irradiance map");
+    MemoryManager::TrackAllocation(_brain.vmaAllocator, _irradianceMap.allocation, "Irradiance map");
 
     for(size_t i = 0; i < 6; ++i)
     {
@@ -687,7 +384,7 @@ void IBLPipeline::CreatePrefilterCubemap()
     allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
     util::VK_ASSERT(vmaCreateImage(_brain.vmaAllocator, reinterpret_cast<VkImageCreateInfo*>(&imageCreateInfo), &allocationInfo, reinterpret_cast<VkImage*>(&_prefilterMap.image), &_prefilterMap.allocation, nullptr), "Failed creating image!");
-    vmaSetAllocationName(_brain.vmaAllocator, _prefilterMap.allocation, "Irradiance map");
+    MemoryManager::TrackAllocation(_brain.vmaAllocator, _prefilterMap.allocation, "Irradiance map");
 
     _prefilterMapViews.resize(_prefilterMap.mipLevels);
     for(size_t i = 0; i < _prefilterMap.mipLevels; ++i)
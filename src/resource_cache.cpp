@@ -0,0 +1,138 @@
+#include "resource_cache.hpp"
+#include "vulkan_brain.hpp"
+
+namespace
+{
+uint64_t Mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+
+    return value;
+}
+}
+
+ResourceCache::ResourceCache(const VulkanBrain& brain) :
+    _brain(brain)
+{
+}
+
+uint64_t ResourceCache::HashBytes(std::span<const std::byte> bytes)
+{
+    // Consumes 8 bytes per step, encoded images can be several megabytes.
+    uint64_t hash = Mix(bytes.size() + 0x9e3779b97f4a7c15ull);
+
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, sizeof(word));
+        hash = (hash ^ Mix(word)) * 0x9e3779b97f4a7c15ull;
+    }
+
+    uint64_t tail = 0;
+    if(i < bytes.size())
+        std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+    hash = Mix(hash ^ tail);
+
+    // 0 marks uncacheable resources.
+    return hash == 0 ? 1 : hash;
+}
+
+std::shared_ptr<TextureHandle> ResourceCache::FindTexture(uint64_t key, std::span<const std::byte> encoded) const
+{
+    if(key == 0)
+        return nullptr;
+
+    auto it = _textures.find(key);
+    if(it == _textures.end() || !std::ranges::equal(it->second.encoded, encoded))
+        return nullptr;
+
+    return it->second.handle.lock();
+}
+
+std::shared_ptr<TextureHandle> ResourceCache::AddTexture(uint64_t key, std::span<const std::byte> encoded, const TextureHandle& texture)
+{
+    const VulkanBrain& brain = _brain;
+    std::shared_ptr<TextureHandle> handle{ new TextureHandle{ texture }, [&brain](TextureHandle* texture)
+    {
+        brain.device.destroy(texture->imageView);
+        util::DestroyImage(brain.vmaAllocator, texture->image, texture->imageAllocation);
+        delete texture;
+    } };
+
+    if(key == 0)
+        return handle;
+
+    TextureEntry& entry = _textures[key];
+    if(entry.handle.expired())
+    {
+        entry.encoded.assign(encoded.begin(), encoded.end());
+        entry.handle = handle;
+    }
+
+    return handle;
+}
+
+std::shared_ptr<MaterialHandle> ResourceCache::FindMaterial(const MaterialHandle::MaterialInfo& info, const std::array<std::shared_ptr<TextureHandle>, MaterialHandle::TEXTURE_COUNT>& textures) const
+{
+    auto it = _materials.find(MakeMaterialKey(info, textures));
+    return it != _materials.end() ? it->second.lock() : nullptr;
+}
+
+std::shared_ptr<MaterialHandle> ResourceCache::AddMaterial(const MaterialHandle::MaterialInfo& info, const MaterialHandle& material)
+{
+    const VulkanBrain& brain = _brain;
+    std::shared_ptr<MaterialHandle> handle{ new MaterialHandle{ material }, [&brain](MaterialHandle* material)
+    {
+        util::DestroyBuffer(brain.vmaAllocator, material->materialUniformBuffer, material->materialUniformAllocation);
+        delete material;
+    } };
+
+    // Drop expired entries first, their texture pointers could be reused by new textures.
+    std::erase_if(_materials, [](const auto& entry) { return entry.second.expired(); });
+    std::erase_if(_textures, [](const auto& entry) { return entry.second.handle.expired(); });
+
+    _materials[MakeMaterialKey(info, material.textures)] = handle;
+
+    return handle;
+}
+
+size_t ResourceCache::TextureCount() const
+{
+    return std::count_if(_textures.begin(), _textures.end(), [](const auto& entry) { return !entry.second.handle.expired(); });
+}
+
+size_t ResourceCache::MaterialCount() const
+{
+    return std::count_if(_materials.begin(), _materials.end(), [](const auto& entry) { return !entry.second.expired(); });
+}
+
+bool ResourceCache::MaterialKey::operator==(const MaterialKey& other) const
+{
+    return std::memcmp(&info, &other.info, sizeof(info)) == 0 && textures == other.textures;
+}
+
+size_t ResourceCache::MaterialKeyHash::operator()(const MaterialKey& key) const
+{
+    uint64_t hash = HashBytes({ reinterpret_cast<const std::byte*>(&key.info), sizeof(key.info) });
+    for(const TextureHandle* texture : key.textures)
+        hash = Mix(hash ^ reinterpret_cast<uintptr_t>(texture));
+
+    return hash;
+}
+
+ResourceCache::MaterialKey ResourceCache::MakeMaterialKey(const MaterialHandle::MaterialInfo& info, const std::array<std::shared_ptr<TextureHandle>, MaterialHandle::TEXTURE_COUNT>& textures)
+{
+    MaterialKey key{};
+    key.info = info;
+    // Never written, but compared bytewise.
+    key.info._padding1 = 0.0f;
+    for(size_t i = 0; i < textures.size(); ++i)
+        key.textures[i] = textures[i].get();
+
+    return key;
+}
@@ -0,0 +1,97 @@
+#include "shaders/shader_compiler.hpp"
+
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(SHADER_HOT_RELOAD)
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace
+{
+struct GLSLStage
+{
+    std::string_view extension;
+    // Appended to the file name without extension, matches shader_comp.py.
+    std::string_view suffix;
+    // Mesh shading requires SPIR-V 1.4.
+    bool spirv14;
+};
+
+constexpr std::array<GLSLStage, 8> GLSL_STAGES = { {
+    { ".frag", "-f.spv", false },
+    { ".vert", "-v.spv", false },
+    { ".geom", "-g.spv", false },
+    { ".tesc", "-tc.spv", false },
+    { ".tese", "-te.spv", false },
+    { ".comp", "-c.spv", false },
+    { ".task", "-t.spv", true },
+    { ".mesh", "-m.spv", true },
+} };
+
+const GLSLStage* FindStage(const std::filesystem::path& source)
+{
+    std::string extension = source.extension().string();
+    for(const auto& stage : GLSL_STAGES)
+        if(stage.extension == extension)
+            return &stage;
+
+    return nullptr;
+}
+
+#if defined(SHADER_HOT_RELOAD)
+shaderc_shader_kind ShaderKind(std::string_view extension)
+{
+    if(extension == ".frag") return shaderc_fragment_shader;
+    if(extension == ".vert") return shaderc_vertex_shader;
+    if(extension == ".geom") return shaderc_geometry_shader;
+    if(extension == ".tesc") return shaderc_tess_control_shader;
+    if(extension == ".tese") return shaderc_tess_evaluation_shader;
+    if(extension == ".task") return shaderc_task_shader;
+    if(extension == ".mesh") return shaderc_mesh_shader;
+    return shaderc_compute_shader;
+}
+#endif
+}
+
+std::optional<std::filesystem::path> shader::SPIRVPath(const std::filesystem::path& source)
+{
+    const GLSLStage* stage = FindStage(source);
+    if(stage == nullptr)
+        return std::nullopt;
+
+    return source.parent_path() / (source.stem().string() + std::string{ stage->suffix });
+}
+
+std::vector<uint32_t> shader::CompileGLSL(const std::filesystem::path& source)
+{
+    const GLSLStage* stage = FindStage(source);
+    if(stage == nullptr)
+        throw std::runtime_error("Unknown shader stage for " + source.string());
+
+    std::ifstream file{ source };
+    if(!file.is_open())
+        throw std::runtime_error("Failed opening shader source " + source.string());
+
+    std::stringstream text;
+    text << file.rdbuf();
+
+#if defined(SHADER_HOT_RELOAD)
+    shaderc::CompileOptions options;
+    if(stage->spirv14)
+        options.SetTargetSpirv(shaderc_spirv_version_1_4);
+
+    shaderc::Compiler compiler;
+    std::string sourceText = text.str();
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(sourceText, ShaderKind(stage->extension), source.string().c_str(), options);
+    if(result.GetCompilationStatus() != shaderc_compilation_status_success)
+        throw std::runtime_error(result.GetErrorMessage());
+
+    return { result.cbegin(), result.cend() };
+#else
+    throw std::runtime_error("Built without shaderc, " + source.string() + " can't be compiled at runtime!");
+#endif
+}
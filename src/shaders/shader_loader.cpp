@@ -1,5 +1,6 @@
 #include "shaders/shader_loader.hpp"
 
+#include <cstring>
 #include <fstream>
 
 #include "vulkan_helper.hpp"
@@ -41,3 +42,30 @@ vk::ShaderModule shader::CreateShaderModule(const std::vector<std::byte>& byteCo
 
     return shaderModule;
 }
+
+bool shader::HasSpecializationConstant(const std::vector<std::byte>& byteCode, uint32_t constantId)
+{
+    constexpr size_t HEADER_WORDS = 5;
+    constexpr uint32_t OP_DECORATE = 71;
+    constexpr uint32_t DECORATION_SPEC_ID = 1;
+
+    std::vector<uint32_t> words(byteCode.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), byteCode.data(), words.size() * sizeof(uint32_t));
+
+    // Every instruction starts with its word count in the high and its opcode in the low 16 bits.
+    for(size_t i = HEADER_WORDS; i < words.size();)
+    {
+        uint32_t wordCount = words[i] >> 16;
+        uint32_t opcode = words[i] & 0xFFFF;
+        if(wordCount == 0 || i + wordCount > words.size())
+            return false;
+
+        // OpDecorate <target> SpecId <constant_id>
+        if(opcode == OP_DECORATE && wordCount == 4 && words[i + 2] == DECORATION_SPEC_ID && words[i + 3] == constantId)
+            return true;
+
+        i += wordCount;
+    }
+
+    return false;
+}
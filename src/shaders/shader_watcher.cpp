@@ -0,0 +1,121 @@
+#include "shaders/shader_watcher.hpp"
+#include "shaders/shader_compiler.hpp"
+
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+// Time between scans, short enough that a saved shader shows up before switching back to the window.
+constexpr std::chrono::milliseconds SCAN_INTERVAL{ 250 };
+}
+
+ShaderWatcher::ShaderWatcher(std::filesystem::path directory) :
+    _directory(std::move(directory))
+{
+    // The SPIR-V files are expected to be up to date at startup, only later changes are compiled.
+    Scan();
+
+    _thread = std::thread{ [this]() { WatchLoop(); } };
+    spdlog::info("Watching {} for shader changes", _directory.string());
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    {
+        std::scoped_lock lock{ _mutex };
+        _stopping = true;
+    }
+    _stopRequested.notify_all();
+
+    _thread.join();
+}
+
+std::vector<std::string> ShaderWatcher::TakeRecompiled()
+{
+    std::scoped_lock lock{ _mutex };
+    return std::exchange(_recompiled, {});
+}
+
+void ShaderWatcher::WatchLoop()
+{
+    while(true)
+    {
+        {
+            std::unique_lock lock{ _mutex };
+            if(_stopRequested.wait_for(lock, SCAN_INTERVAL, [this]() { return _stopping; }))
+                return;
+        }
+
+        for(const auto& source : Scan())
+            Recompile(source);
+    }
+}
+
+std::vector<std::filesystem::path> ShaderWatcher::Scan()
+{
+    std::vector<std::filesystem::path> changed;
+
+    // Editors replace files while saving, so errors only skip this scan.
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator{ _directory, error })
+    {
+        if(!entry.is_regular_file(error) || !shader::SPIRVPath(entry.path()))
+            continue;
+
+        std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+        if(error)
+            continue;
+
+        auto [it, inserted] = _writeTimes.try_emplace(entry.path(), writeTime);
+        if(!inserted && it->second != writeTime)
+        {
+            it->second = writeTime;
+            changed.emplace_back(entry.path());
+        }
+    }
+
+    return changed;
+}
+
+void ShaderWatcher::Recompile(const std::filesystem::path& source)
+{
+    std::vector<uint32_t> spirv;
+    try
+    {
+        spirv = shader::CompileGLSL(source);
+    }
+    catch(const std::exception& e)
+    {
+        // The old SPIR-V stays in place, saving the fixed source tries again.
+        spdlog::error("Failed compiling {}:\n{}", source.string(), e.what());
+        return;
+    }
+
+    // Written next to the destination and moved over it, so a pipeline compiling at the same time never reads half a file.
+    std::filesystem::path destination = *shader::SPIRVPath(source);
+    std::filesystem::path temporary = destination;
+    temporary += ".tmp";
+    {
+        std::ofstream file{ temporary, std::ios::binary };
+        file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        if(!file)
+        {
+            spdlog::error("Failed writing {}", temporary.string());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, destination, error);
+    if(error)
+    {
+        spdlog::error("Failed replacing {}: {}", destination.string(), error.message());
+        return;
+    }
+
+    spdlog::info("Recompiled {}", source.string());
+
+    std::scoped_lock lock{ _mutex };
+    _recompiled.emplace_back(destination.generic_string());
+}
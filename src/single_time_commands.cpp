@@ -2,6 +2,8 @@
 #include "include.hpp"
 #include "vulkan_helper.hpp"
 #include "vulkan_brain.hpp"
+#include "hdr_loader.hpp"
+#include "cpu_profiler.hpp"
 
 SingleTimeCommands::SingleTimeCommands(const VulkanBrain& brain) :
     _brain(brain)
@@ -32,6 +34,8 @@ void SingleTimeCommands::Submit()
     if(_submitted)
         return;
 
+    PROFILE_ZONE("SingleTimeCommands::Submit");
+
     _commandBuffer.end();
 
     vk::SubmitInfo submitInfo{};
@@ -48,7 +52,7 @@ void SingleTimeCommands::Submit()
     assert(_stagingAllocations.size() == _stagingBuffers.size());
     for(size_t i = 0; i < _stagingBuffers.size(); ++i)
     {
-        vmaDestroyBuffer(_brain.vmaAllocator, _stagingBuffers[i], _stagingAllocations[i]);
+        util::DestroyBuffer(_brain.vmaAllocator, _stagingBuffers[i], _stagingAllocations[i]);
     }
     _submitted = true;
 }
@@ -117,6 +121,61 @@ void SingleTimeCommands::CreateTextureImage(const Texture& texture, TextureHandl
     textureHandle.imageView = util::CreateImageView(_brain.device, textureHandle.image, texture.GetFormat(), vk::ImageAspectFlagBits::eColor, 0, mipCount);
 }
 
+void SingleTimeCommands::CreateHDRImage(std::string_view path, TextureHandle& textureHandle)
+{
+    CreateStagedImage(StageHDRImage(_brain, path), textureHandle);
+}
+
+void SingleTimeCommands::CreateStagedImage(const StagedImage& stagedImage, TextureHandle& textureHandle)
+{
+    _stagingBuffers.emplace_back(stagedImage.buffer);
+    _stagingAllocations.emplace_back(stagedImage.allocation);
+
+    textureHandle.width = stagedImage.width;
+    textureHandle.height = stagedImage.height;
+    textureHandle.format = stagedImage.format;
+
+    util::CreateImage(_brain.vmaAllocator, textureHandle.width, textureHandle.height, textureHandle.format,
+                      vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                      textureHandle.image, textureHandle.imageAllocation, "HDR image", false, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    util::TransitionImageLayout(_commandBuffer, textureHandle.image, textureHandle.format, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+
+    util::CopyBufferToImage(_commandBuffer, stagedImage.buffer, textureHandle.image, textureHandle.width, textureHandle.height);
+
+    util::TransitionImageLayout(_commandBuffer, textureHandle.image, textureHandle.format, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    textureHandle.imageView = util::CreateImageView(_brain.device, textureHandle.image, textureHandle.format, vk::ImageAspectFlagBits::eColor);
+}
+
+StagedImage SingleTimeCommands::StageHDRImage(const VulkanBrain& brain, std::string_view path)
+{
+    PROFILE_ZONE("SingleTimeCommands::StageHDRImage");
+
+    HDRReader reader{ path };
+
+    StagedImage stagedImage{};
+    stagedImage.width = reader.Width();
+    stagedImage.height = reader.Height();
+    stagedImage.format = vk::Format::eR16G16B16A16Sfloat;
+
+    vk::DeviceSize rowSize = stagedImage.width * 4 * sizeof(uint16_t);
+    vk::DeviceSize imageSize = rowSize * stagedImage.height;
+
+    util::CreateBuffer(brain, imageSize, vk::BufferUsageFlagBits::eTransferSrc, stagedImage.buffer, true, stagedImage.allocation, VMA_MEMORY_USAGE_CPU_ONLY, "HDR staging buffer");
+
+    void* mapped;
+    util::VK_ASSERT(vmaMapMemory(brain.vmaAllocator, stagedImage.allocation, &mapped), "Failed mapping memory for HDR staging buffer!");
+
+    for(uint32_t y = 0; y < stagedImage.height; ++y)
+        reader.ReadScanline(reinterpret_cast<uint16_t*>(static_cast<std::byte*>(mapped) + y * rowSize));
+
+    vmaFlushAllocation(brain.vmaAllocator, stagedImage.allocation, 0, VK_WHOLE_SIZE);
+    vmaUnmapMemory(brain.vmaAllocator, stagedImage.allocation);
+
+    return stagedImage;
+}
+
 void SingleTimeCommands::CreateLocalBuffer(const std::byte* vec, uint32_t count, vk::Buffer& buffer,
                                            VmaAllocation& allocation, vk::BufferUsageFlags usage, std::string_view name)
 {
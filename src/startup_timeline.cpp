@@ -0,0 +1,110 @@
+#include "startup_timeline.hpp"
+#include "cpu_profiler.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <fstream>
+
+StartupTimeline::StartupTimeline() :
+    _origin(CPUProfiler::Now())
+{
+}
+
+StartupTimeline::Stage::Stage(StartupTimeline& timeline, std::string name) :
+    _timeline(timeline),
+    _name(std::move(name)),
+    _begin(CPUProfiler::Now())
+{
+}
+
+StartupTimeline::Stage::~Stage()
+{
+    _timeline.AddStage(std::move(_name), _begin, CPUProfiler::Now());
+}
+
+void StartupTimeline::AddStage(std::string name, uint64_t begin, uint64_t end)
+{
+    auto toMilliseconds = [this](uint64_t time) { return static_cast<float>(static_cast<double>(time - _origin) / 1000000.0); };
+
+    std::scoped_lock lock{ _mutex };
+    _entries.emplace_back(Entry{ std::move(name), toMilliseconds(begin), toMilliseconds(end), false });
+}
+
+void StartupTimeline::AddMilestone(std::string name)
+{
+    float time = static_cast<float>(static_cast<double>(CPUProfiler::Now() - _origin) / 1000000.0);
+
+    std::scoped_lock lock{ _mutex };
+    _entries.emplace_back(Entry{ std::move(name), time, time, true });
+}
+
+bool StartupTimeline::HasMilestone(std::string_view name) const
+{
+    std::scoped_lock lock{ _mutex };
+    return std::any_of(_entries.begin(), _entries.end(), [&](const Entry& entry) { return entry.milestone && entry.name == name; });
+}
+
+std::vector<StartupTimeline::Entry> StartupTimeline::SortedEntries() const
+{
+    std::vector<Entry> entries;
+    {
+        std::scoped_lock lock{ _mutex };
+        entries = _entries;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.begin < b.begin; });
+    return entries;
+}
+
+void StartupTimeline::Report() const
+{
+    spdlog::info("Startup timeline, in milliseconds since start:");
+    for(const auto& entry : SortedEntries())
+    {
+        if(entry.milestone)
+            spdlog::info("  {:>9.1f}                        {}", entry.begin, entry.name);
+        else
+            spdlog::info("  {:>9.1f} - {:>9.1f} ({:>8.1f})  {}", entry.begin, entry.end, entry.end - entry.begin, entry.name);
+    }
+}
+
+bool StartupTimeline::ExportJSON(const std::filesystem::path& path) const
+{
+    std::ofstream file{ path };
+    if(!file)
+    {
+        spdlog::error("Failed writing startup timeline to {}", path.string());
+        return false;
+    }
+
+    std::vector<Entry> entries = SortedEntries();
+
+    file << "{\n  \"stages\": [";
+    bool first = true;
+    for(const auto& entry : entries)
+    {
+        if(entry.milestone)
+            continue;
+
+        file << (first ? "\n" : ",\n") << "    { \"name\": \"";
+        CPUProfiler::WriteEscaped(file, entry.name);
+        file << "\", \"begin_ms\": " << entry.begin << ", \"end_ms\": " << entry.end << " }";
+        first = false;
+    }
+
+    file << "\n  ],\n  \"milestones\": {";
+    first = true;
+    for(const auto& entry : entries)
+    {
+        if(!entry.milestone)
+            continue;
+
+        file << (first ? "\n" : ",\n") << "    \"";
+        CPUProfiler::WriteEscaped(file, entry.name);
+        file << "\": " << entry.begin;
+        first = false;
+    }
+    file << "\n  }\n}\n";
+
+    spdlog::info("Wrote startup timeline to {}", path.string());
+    return true;
+}
@@ -2,6 +2,7 @@
 #include "vulkan_helper.hpp"
 #include "vulkan/vulkan.h"
 #include "engine.hpp"
+#include <fstream>
 
 SwapChain::SwapChain(const VulkanBrain& brain, const glm::uvec2& screenSize) :
     _brain(brain)
@@ -17,6 +18,12 @@ SwapChain::~SwapChain()
 void SwapChain::CreateSwapChain(const glm::uvec2& screenSize)
 {
     _imageSize = screenSize;
+    if(_brain.headless)
+    {
+        CreateOffscreenImages(screenSize);
+        return;
+    }
+
     SupportDetails swapChainSupport = QuerySupport(_brain.physicalDevice, _brain.surface);
 
     auto surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -72,6 +79,114 @@ void SwapChain::CreateSwapChain(const glm::uvec2& screenSize)
     CreateSwapChainImageViews();
 }
 
+void SwapChain::CreateOffscreenImages(const glm::uvec2& screenSize)
+{
+    auto format = util::FindSupportedFormat(_brain.physicalDevice, { vk::Format::eB8G8R8A8Unorm, vk::Format::eR8G8B8A8Unorm },
+                                            vk::ImageTiling::eOptimal,
+                                            vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eTransferSrc);
+    if(!format.has_value())
+        throw std::runtime_error("No supported format for offscreen images!");
+
+    _format = format.value();
+    _extent = vk::Extent2D{ screenSize.x, screenSize.y };
+
+    _images.resize(HEADLESS_IMAGE_COUNT);
+    _imageAllocations.resize(HEADLESS_IMAGE_COUNT);
+    _readbackBuffers.resize(HEADLESS_IMAGE_COUNT);
+    _readbackAllocations.resize(HEADLESS_IMAGE_COUNT);
+    _readbackMapped.resize(HEADLESS_IMAGE_COUNT);
+    for(size_t i = 0; i < HEADLESS_IMAGE_COUNT; ++i)
+    {
+        util::CreateImage(_brain.vmaAllocator, screenSize.x, screenSize.y, _format, vk::ImageTiling::eOptimal,
+                          vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+                          _images[i], _imageAllocations[i], "Offscreen image", false, VMA_MEMORY_USAGE_GPU_ONLY);
+
+        util::CreateBuffer(_brain, static_cast<vk::DeviceSize>(screenSize.x) * screenSize.y * 4, vk::BufferUsageFlagBits::eTransferDst,
+                           _readbackBuffers[i], false, _readbackAllocations[i], VMA_MEMORY_USAGE_GPU_TO_CPU, "Offscreen readback buffer");
+        util::VK_ASSERT(vmaMapMemory(_brain.vmaAllocator, _readbackAllocations[i], reinterpret_cast<void**>(&_readbackMapped[i])),
+                        "Failed mapping offscreen readback buffer!");
+    }
+
+    CreateSwapChainImageViews();
+}
+
+vk::Result SwapChain::AcquireNextImage(vk::Semaphore signalSemaphore, uint32_t& imageIndex)
+{
+    if(_brain.headless)
+    {
+        imageIndex = _nextImage;
+        _nextImage = (_nextImage + 1) % HEADLESS_IMAGE_COUNT;
+        return vk::Result::eSuccess;
+    }
+
+    return _brain.device.acquireNextImageKHR(_swapChain, std::numeric_limits<uint64_t>::max(), signalSemaphore, nullptr, &imageIndex);
+}
+
+vk::Result SwapChain::Present(vk::Semaphore waitSemaphore, uint32_t imageIndex)
+{
+    if(_brain.headless)
+        return vk::Result::eSuccess;
+
+    vk::PresentInfoKHR presentInfo{};
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &waitSemaphore;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &_swapChain;
+    presentInfo.pImageIndices = &imageIndex;
+
+    return _brain.presentQueue.presentKHR(&presentInfo);
+}
+
+void SwapChain::RecordReadbackCommands(vk::CommandBuffer commandBuffer, uint32_t imageIndex) const
+{
+    assert(_brain.headless && "Only offscreen images can be read back!");
+
+    vk::BufferImageCopy region{};
+    region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = vk::Extent3D{ _extent.width, _extent.height, 1 };
+
+    commandBuffer.copyImageToBuffer(_images[imageIndex], vk::ImageLayout::eTransferSrcOptimal, _readbackBuffers[imageIndex], 1, &region);
+
+    // Makes the copy visible to the host once the fence of this frame was waited on.
+    vk::MemoryBarrier barrier{};
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                                  vk::DependencyFlags{ 0 }, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void SwapChain::WriteReadback(uint32_t imageIndex, const std::filesystem::path& path) const
+{
+    assert(_brain.headless && "Only offscreen images can be read back!");
+
+    util::VK_ASSERT(vmaInvalidateAllocation(_brain.vmaAllocator, _readbackAllocations[imageIndex], 0, VK_WHOLE_SIZE),
+                    "Failed invalidating offscreen readback buffer!");
+
+    std::ofstream file{ path, std::ios::binary };
+    if(!file)
+    {
+        spdlog::error("Failed opening {} for writing", path.string());
+        return;
+    }
+
+    file << "P6\n" << _extent.width << " " << _extent.height << "\n255\n";
+
+    bool bgr = _format == vk::Format::eB8G8R8A8Unorm;
+    std::vector<std::byte> row(_extent.width * 3);
+    for(uint32_t y = 0; y < _extent.height; ++y)
+    {
+        const std::byte* pixels = _readbackMapped[imageIndex] + static_cast<size_t>(y) * _extent.width * 4;
+        for(uint32_t x = 0; x < _extent.width; ++x)
+        {
+            row[x * 3 + 0] = pixels[x * 4 + (bgr ? 2 : 0)];
+            row[x * 3 + 1] = pixels[x * 4 + 1];
+            row[x * 3 + 2] = pixels[x * 4 + (bgr ? 0 : 2)];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+}
+
 void SwapChain::Resize(const glm::uvec2& screenSize)
 {
     _brain.device.waitIdle();
@@ -163,6 +278,14 @@ void SwapChain::CleanUpSwapChain()
     for(auto imageView : _imageViews)
         _brain.device.destroy(imageView);
 
+    for(size_t i = 0; i < _imageAllocations.size(); ++i)
+    {
+        util::DestroyImage(_brain.vmaAllocator, _images[i], _imageAllocations[i]);
+        vmaUnmapMemory(_brain.vmaAllocator, _readbackAllocations[i]);
+        util::DestroyBuffer(_brain.vmaAllocator, _readbackBuffers[i], _readbackAllocations[i]);
+    }
+    _imageAllocations.clear();
+
     _brain.device.destroy(_swapChain);
 }
 
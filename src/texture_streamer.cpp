@@ -0,0 +1,494 @@
+#include "texture_streamer.hpp"
+#include "vulkan_helper.hpp"
+#include "vulkan_brain.hpp"
+#include "single_time_commands.hpp"
+#include "cpu_profiler.hpp"
+
+namespace
+{
+constexpr uint32_t NO_REQUEST = std::numeric_limits<uint32_t>::max();
+constexpr vk::Format STREAMED_FORMAT = vk::Format::eR8G8B8A8Unorm;
+
+// 2x2 box filter, odd sizes clamp at the edge.
+std::vector<std::byte> Downsample(const std::vector<std::byte>& source, uint32_t width, uint32_t height)
+{
+    uint32_t mipWidth = std::max(width / 2, 1u);
+    uint32_t mipHeight = std::max(height / 2, 1u);
+    std::vector<std::byte> mip(mipWidth * mipHeight * 4);
+
+    for(uint32_t y = 0; y < mipHeight; ++y)
+    {
+        uint32_t y0 = std::min(y * 2, height - 1);
+        uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+        for(uint32_t x = 0; x < mipWidth; ++x)
+        {
+            uint32_t x0 = std::min(x * 2, width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+            for(uint32_t c = 0; c < 4; ++c)
+            {
+                uint32_t sum = static_cast<uint32_t>(source[(y0 * width + x0) * 4 + c]) + static_cast<uint32_t>(source[(y0 * width + x1) * 4 + c])
+                             + static_cast<uint32_t>(source[(y1 * width + x0) * 4 + c]) + static_cast<uint32_t>(source[(y1 * width + x1) * 4 + c]);
+                mip[(y * mipWidth + x) * 4 + c] = static_cast<std::byte>((sum + 2) / 4);
+            }
+        }
+    }
+
+    return mip;
+}
+}
+
+TextureStreamer::TextureStreamer(const VulkanBrain& brain, vk::DeviceSize budget) :
+    _brain(brain),
+    _budget(budget)
+{
+    util::CreateBuffer(_brain, MAX_STREAMED_TEXTURES * sizeof(glm::vec2), vk::BufferUsageFlagBits::eStorageBuffer,
+                       _textureSizeBuffer, true, _textureSizeAllocation, VMA_MEMORY_USAGE_CPU_ONLY, "Streamed texture size buffer");
+    util::VK_ASSERT(vmaMapMemory(_brain.vmaAllocator, _textureSizeAllocation, reinterpret_cast<void**>(&_textureSizes)), "Failed mapping streamed texture sizes!");
+
+    vk::DeviceSize feedbackSize = MAX_STREAMED_TEXTURES * sizeof(uint32_t);
+    util::CreateBuffer(_brain, feedbackSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+                       _feedbackBuffer, false, _feedbackAllocation, VMA_MEMORY_USAGE_GPU_ONLY, "Texture streaming feedback buffer");
+
+    for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        util::CreateBuffer(_brain, feedbackSize, vk::BufferUsageFlagBits::eTransferDst,
+                           _readbackBuffers[i], false, _readbackAllocations[i], VMA_MEMORY_USAGE_GPU_TO_CPU, "Texture streaming readback buffer");
+        util::VK_ASSERT(vmaMapMemory(_brain.vmaAllocator, _readbackAllocations[i], reinterpret_cast<void**>(&_readbackMapped[i])),
+                        "Failed mapping texture streaming readback buffer!");
+    }
+
+    SingleTimeCommands commands{ _brain };
+    commands.CommandBuffer().fillBuffer(_feedbackBuffer, 0, vk::WholeSize, NO_REQUEST);
+    commands.Submit();
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    if(_pendingBatch.has_value())
+    {
+        util::VK_ASSERT(_brain.device.waitForFences(1, &_pendingBatch->fence, vk::True, std::numeric_limits<uint64_t>::max()), "Failed waiting on streaming batch!");
+
+        for(auto& transition : _pendingBatch->transitions)
+        {
+            _brain.device.destroy(transition.imageView);
+            util::DestroyImage(_brain.vmaAllocator, transition.image, transition.allocation);
+        }
+        _brain.device.free(_brain.commandPool, _pendingBatch->commandBuffer);
+        _brain.device.destroy(_pendingBatch->fence);
+        util::DestroyBuffer(_brain.vmaAllocator, _pendingBatch->stagingBuffer, _pendingBatch->stagingAllocation);
+    }
+
+    for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        vmaUnmapMemory(_brain.vmaAllocator, _readbackAllocations[i]);
+        util::DestroyBuffer(_brain.vmaAllocator, _readbackBuffers[i], _readbackAllocations[i]);
+    }
+    util::DestroyBuffer(_brain.vmaAllocator, _feedbackBuffer, _feedbackAllocation);
+    vmaUnmapMemory(_brain.vmaAllocator, _textureSizeAllocation);
+    util::DestroyBuffer(_brain.vmaAllocator, _textureSizeBuffer, _textureSizeAllocation);
+}
+
+void TextureStreamer::BuildMips(Texture& texture)
+{
+    if(texture.GetFormat() != STREAMED_FORMAT || texture.numChannels != 4 || !texture.mips.empty())
+        return;
+
+    PROFILE_ZONE("TextureStreamer::BuildMips");
+
+    uint32_t mipCount = static_cast<uint32_t>(floor(log2(std::max(texture.width, texture.height)))) + 1;
+    texture.mips.reserve(mipCount - 1);
+    for(uint32_t i = 1; i < mipCount; ++i)
+    {
+        const std::vector<std::byte>& source = i == 1 ? texture.data : texture.mips[i - 2];
+        texture.mips.emplace_back(Downsample(source, std::max(texture.width >> (i - 1), 1u), std::max(texture.height >> (i - 1), 1u)));
+    }
+}
+
+void TextureStreamer::CreateTexture(Texture&& texture, TextureHandle& textureHandle, SingleTimeCommands& commands)
+{
+    bool streamable = texture.GetFormat() == STREAMED_FORMAT && texture.numChannels == 4;
+    if(!streamable || (_freeIndices.empty() && _textures.size() >= MAX_STREAMED_TEXTURES))
+    {
+        commands.CreateTextureImage(texture, textureHandle, true);
+        return;
+    }
+
+    uint32_t index;
+    if(_freeIndices.empty())
+    {
+        index = _textures.size();
+        _textures.emplace_back();
+    }
+    else
+    {
+        index = _freeIndices.back();
+        _freeIndices.pop_back();
+    }
+
+    StreamedTexture& streamed = _textures[index];
+    streamed = StreamedTexture{};
+    streamed.width = texture.width;
+    streamed.height = texture.height;
+    streamed.requestedMip = NO_REQUEST;
+
+    BuildMips(texture);
+    streamed.mips.reserve(texture.mips.size() + 1);
+    streamed.mips.emplace_back(std::move(texture.data));
+    for(auto& mip : texture.mips)
+        streamed.mips.emplace_back(std::move(mip));
+
+    streamed.tailMip = 0;
+    while(std::max(texture.width >> streamed.tailMip, texture.height >> streamed.tailMip) > STREAMING_MIP_TAIL_SIZE)
+        ++streamed.tailMip;
+    streamed.residentMip = streamed.tailMip;
+    streamed.active = true;
+
+    // The tail is created like any other texture, its smaller mips are blitted on the GPU.
+    Texture tail{};
+    tail.width = std::max(texture.width >> streamed.tailMip, 1u);
+    tail.height = std::max(texture.height >> streamed.tailMip, 1u);
+    tail.numChannels = 4;
+    tail.data = streamed.mips[streamed.tailMip];
+    commands.CreateTextureImage(tail, textureHandle, true);
+
+    textureHandle.width = texture.width;
+    textureHandle.height = texture.height;
+    textureHandle.format = STREAMED_FORMAT;
+    textureHandle.streamIndex = index;
+
+    _textureSizes[index] = glm::vec2{ texture.width, texture.height };
+    _residentBytes += ResidentSize(streamed, streamed.residentMip);
+    ++_streamedTextureCount;
+}
+
+void TextureStreamer::TrackTexture(const std::shared_ptr<TextureHandle>& texture)
+{
+    if(texture->streamIndex != NO_STREAM_INDEX)
+        _textures[texture->streamIndex].handle = texture;
+}
+
+void TextureStreamer::TrackMaterial(const std::shared_ptr<MaterialHandle>& material)
+{
+    _materials.emplace_back(material);
+}
+
+void TextureStreamer::Update(uint32_t currentFrame)
+{
+    ++_frameCounter;
+    ReleaseExpired();
+
+    if(_readbackValid[currentFrame])
+    {
+        // Readback memory may be cached and not coherent, the host would otherwise see stale requests.
+        util::VK_ASSERT(vmaInvalidateAllocation(_brain.vmaAllocator, _readbackAllocations[currentFrame], 0, VK_WHOLE_SIZE),
+                        "Failed invalidating texture streaming readback buffer!");
+
+        const uint32_t* requests = _readbackMapped[currentFrame];
+        for(size_t i = 0; i < _textures.size(); ++i)
+        {
+            StreamedTexture& texture = _textures[i];
+            if(!texture.active || requests[i] == NO_REQUEST)
+                continue;
+
+            texture.requestedMip = std::min(requests[i], texture.tailMip);
+            texture.lastRequestedFrame = _frameCounter;
+        }
+    }
+
+    if(_pendingBatch.has_value())
+        return;
+
+    auto unused = [this](const StreamedTexture& texture) { return texture.lastRequestedFrame + STREAMING_UNUSED_FRAMES < _frameCounter; };
+
+    // Where textures could shrink to if memory is needed, least recently requested first.
+    std::vector<uint32_t> evictable;
+    for(uint32_t i = 0; i < _textures.size(); ++i)
+        if(_textures[i].active && !_textures[i].pending && _textures[i].residentMip < _textures[i].tailMip)
+            evictable.emplace_back(i);
+    std::sort(evictable.begin(), evictable.end(), [this](uint32_t lhs, uint32_t rhs) { return _textures[lhs].lastRequestedFrame < _textures[rhs].lastRequestedFrame; });
+
+    auto evictionTarget = [&](const StreamedTexture& texture)
+    {
+        if(unused(texture))
+            return texture.tailMip;
+        return texture.requestedMip != NO_REQUEST ? std::max(texture.requestedMip, texture.residentMip) : texture.tailMip;
+    };
+
+    std::vector<Transition> transitions;
+    vk::DeviceSize projected = _residentBytes;
+    vk::DeviceSize batchSize = 0;
+    size_t evictionCursor = 0;
+
+    auto evictNext = [&](uint64_t newerThan)
+    {
+        while(evictionCursor < evictable.size())
+        {
+            uint32_t index = evictable[evictionCursor++];
+            StreamedTexture& texture = _textures[index];
+            uint32_t target = evictionTarget(texture);
+            if(target == texture.residentMip || texture.lastRequestedFrame >= newerThan)
+                continue;
+
+            projected -= ResidentSize(texture, texture.residentMip) - ResidentSize(texture, target);
+            batchSize += ResidentSize(texture, target);
+            texture.pending = true;
+            transitions.emplace_back(Transition{ index, target });
+            return true;
+        }
+        return false;
+    };
+
+    // The budget might have been lowered, everything that isn't needed right now has to go.
+    while(projected > _budget && evictNext(_frameCounter))
+        ;
+
+    std::vector<uint32_t> candidates;
+    for(uint32_t i = 0; i < _textures.size(); ++i)
+    {
+        const StreamedTexture& texture = _textures[i];
+        if(texture.active && !texture.pending && !unused(texture) && texture.requestedMip < texture.residentMip)
+            candidates.emplace_back(i);
+    }
+    // Biggest improvements first.
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t lhs, uint32_t rhs)
+    {
+        return _textures[lhs].residentMip - _textures[lhs].requestedMip > _textures[rhs].residentMip - _textures[rhs].requestedMip;
+    });
+
+    for(uint32_t index : candidates)
+    {
+        StreamedTexture& texture = _textures[index];
+
+        uint32_t target = texture.requestedMip;
+        while(target < texture.residentMip)
+        {
+            vk::DeviceSize growth = ResidentSize(texture, target) - ResidentSize(texture, texture.residentMip);
+            while(projected + growth > _budget && evictNext(texture.lastRequestedFrame))
+                ;
+
+            if(projected + growth <= _budget)
+                break;
+
+            // Doesn't fit, settle for one mip less.
+            ++target;
+        }
+
+        if(target >= texture.residentMip || batchSize + ResidentSize(texture, target) > STREAMING_BATCH_SIZE)
+            continue;
+
+        projected += ResidentSize(texture, target) - ResidentSize(texture, texture.residentMip);
+        batchSize += ResidentSize(texture, target);
+        texture.pending = true;
+        transitions.emplace_back(Transition{ index, target });
+    }
+
+    if(!transitions.empty())
+        SubmitBatch(std::move(transitions));
+}
+
+bool TextureStreamer::BatchReady() const
+{
+    return _pendingBatch.has_value() && _brain.device.getFenceStatus(_pendingBatch->fence) == vk::Result::eSuccess;
+}
+
+void TextureStreamer::ApplyPendingBatch()
+{
+    if(!BatchReady())
+        return;
+
+    std::erase_if(_materials, [](const auto& material) { return material.expired(); });
+
+    std::vector<vk::DescriptorImageInfo> imageInfos;
+    std::vector<vk::WriteDescriptorSet> writes;
+    imageInfos.reserve(_pendingBatch->transitions.size() * _materials.size() * MaterialHandle::TEXTURE_COUNT);
+
+    for(auto& transition : _pendingBatch->transitions)
+    {
+        StreamedTexture& texture = _textures[transition.streamIndex];
+        texture.pending = false;
+
+        std::shared_ptr<TextureHandle> handle = texture.handle.lock();
+        if(handle == nullptr)
+        {
+            _brain.device.destroy(transition.imageView);
+            util::DestroyImage(_brain.vmaAllocator, transition.image, transition.allocation);
+            continue;
+        }
+
+        _brain.device.destroy(handle->imageView);
+        util::DestroyImage(_brain.vmaAllocator, handle->image, handle->imageAllocation);
+        handle->image = transition.image;
+        handle->imageAllocation = transition.allocation;
+        handle->imageView = transition.imageView;
+
+        _residentBytes += ResidentSize(texture, transition.targetMip);
+        _residentBytes -= ResidentSize(texture, texture.residentMip);
+        texture.residentMip = transition.targetMip;
+
+        for(const auto& weakMaterial : _materials)
+        {
+            std::shared_ptr<MaterialHandle> material = weakMaterial.lock();
+            if(material == nullptr)
+                continue;
+
+            for(size_t i = 0; i < MaterialHandle::TEXTURE_COUNT; ++i)
+            {
+                if(material->textures[i] != handle)
+                    continue;
+
+                // Capacity was reserved up front, so the pointers stay valid.
+                vk::DescriptorImageInfo& imageInfo = imageInfos.emplace_back();
+                imageInfo.imageView = handle->imageView;
+                imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+                vk::WriteDescriptorSet& write = writes.emplace_back();
+                write.dstSet = material->descriptorSet;
+                // Binding 0 holds the sampler.
+                write.dstBinding = i + 1;
+                write.dstArrayElement = 0;
+                write.descriptorType = vk::DescriptorType::eSampledImage;
+                write.descriptorCount = 1;
+                write.pImageInfo = &imageInfo;
+            }
+        }
+    }
+
+    _brain.device.updateDescriptorSets(writes.size(), writes.data(), 0, nullptr);
+
+    _brain.device.free(_brain.commandPool, _pendingBatch->commandBuffer);
+    _brain.device.destroy(_pendingBatch->fence);
+    util::DestroyBuffer(_brain.vmaAllocator, _pendingBatch->stagingBuffer, _pendingBatch->stagingAllocation);
+    _pendingBatch.reset();
+}
+
+void TextureStreamer::RecordFeedbackCommands(vk::CommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    vk::DeviceSize feedbackSize = MAX_STREAMED_TEXTURES * sizeof(uint32_t);
+
+    // Covers the geometry passes of previously submitted frames as well.
+    vk::MemoryBarrier barrier{};
+    barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+                                  vk::DependencyFlags{ 0 }, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vk::BufferCopy copy{ 0, 0, feedbackSize };
+    commandBuffer.copyBuffer(_feedbackBuffer, _readbackBuffers[currentFrame], 1, &copy);
+
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                                  vk::DependencyFlags{ 0 }, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    commandBuffer.fillBuffer(_feedbackBuffer, 0, feedbackSize, NO_REQUEST);
+
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eHostRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eHost,
+                                  vk::DependencyFlags{ 0 }, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    _readbackValid[currentFrame] = true;
+}
+
+void TextureStreamer::ReleaseExpired()
+{
+    for(uint32_t i = 0; i < _textures.size(); ++i)
+    {
+        StreamedTexture& texture = _textures[i];
+        if(!texture.active || texture.pending || !texture.handle.expired())
+            continue;
+
+        // The image itself was destroyed together with the handle.
+        _residentBytes -= ResidentSize(texture, texture.residentMip);
+        --_streamedTextureCount;
+        texture = StreamedTexture{};
+        _textureSizes[i] = glm::vec2{ 0.0f };
+        _freeIndices.emplace_back(i);
+    }
+}
+
+void TextureStreamer::UploadMips(vk::CommandBuffer commandBuffer, const StreamedTexture& texture, uint32_t baseMip, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset, vk::Image image)
+{
+    uint32_t mipCount = texture.mips.size() - baseMip;
+
+    std::vector<vk::BufferImageCopy> regions(mipCount);
+    for(uint32_t i = 0; i < mipCount; ++i)
+    {
+        uint32_t mip = baseMip + i;
+
+        vmaCopyMemoryToAllocation(_brain.vmaAllocator, texture.mips[mip].data(), _pendingBatch->stagingAllocation, stagingOffset, texture.mips[mip].size());
+
+        regions[i].bufferOffset = stagingOffset;
+        regions[i].imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        regions[i].imageSubresource.mipLevel = i;
+        regions[i].imageSubresource.baseArrayLayer = 0;
+        regions[i].imageSubresource.layerCount = 1;
+        regions[i].imageExtent = vk::Extent3D{ std::max(texture.width >> mip, 1u), std::max(texture.height >> mip, 1u), 1 };
+
+        stagingOffset += texture.mips[mip].size();
+    }
+
+    util::TransitionImageLayout(commandBuffer, image, STREAMED_FORMAT, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 1, 0, mipCount);
+    commandBuffer.copyBufferToImage(stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, regions.size(), regions.data());
+    util::TransitionImageLayout(commandBuffer, image, STREAMED_FORMAT, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 1, 0, mipCount);
+}
+
+void TextureStreamer::SubmitBatch(std::vector<Transition> transitions)
+{
+    Batch& batch = _pendingBatch.emplace();
+    batch.transitions = std::move(transitions);
+
+    vk::DeviceSize stagingSize = 0;
+    for(const auto& transition : batch.transitions)
+        stagingSize += ResidentSize(_textures[transition.streamIndex], transition.targetMip);
+
+    util::CreateBuffer(_brain, stagingSize, vk::BufferUsageFlagBits::eTransferSrc, batch.stagingBuffer, true, batch.stagingAllocation, VMA_MEMORY_USAGE_CPU_ONLY, "Texture streaming staging buffer");
+
+    vk::CommandBufferAllocateInfo allocateInfo{};
+    allocateInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocateInfo.commandPool = _brain.commandPool;
+    allocateInfo.commandBufferCount = 1;
+    util::VK_ASSERT(_brain.device.allocateCommandBuffers(&allocateInfo, &batch.commandBuffer), "Failed allocating texture streaming command buffer!");
+
+    vk::FenceCreateInfo fenceInfo{};
+    util::VK_ASSERT(_brain.device.createFence(&fenceInfo, nullptr, &batch.fence), "Failed creating texture streaming fence!");
+
+    vk::CommandBufferBeginInfo beginInfo{};
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    util::VK_ASSERT(batch.commandBuffer.begin(&beginInfo), "Failed beginning texture streaming command buffer!");
+
+    vk::DeviceSize stagingOffset = 0;
+    for(auto& transition : batch.transitions)
+    {
+        const StreamedTexture& texture = _textures[transition.streamIndex];
+        uint32_t width = std::max(texture.width >> transition.targetMip, 1u);
+        uint32_t height = std::max(texture.height >> transition.targetMip, 1u);
+
+        util::CreateImage(_brain.vmaAllocator, width, height, STREAMED_FORMAT, vk::ImageTiling::eOptimal,
+                          vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                          transition.image, transition.allocation, "Streamed texture image", true, VMA_MEMORY_USAGE_GPU_ONLY);
+
+        UploadMips(batch.commandBuffer, texture, transition.targetMip, batch.stagingBuffer, stagingOffset, transition.image);
+        stagingOffset += ResidentSize(texture, transition.targetMip);
+
+        transition.imageView = util::CreateImageView(_brain.device, transition.image, STREAMED_FORMAT, vk::ImageAspectFlagBits::eColor, 0, texture.mips.size() - transition.targetMip);
+    }
+
+    batch.commandBuffer.end();
+
+    vk::SubmitInfo submitInfo{};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    util::VK_ASSERT(_brain.graphicsQueue.submit(1, &submitInfo, batch.fence), "Failed submitting texture streaming batch!");
+}
+
+vk::DeviceSize TextureStreamer::ResidentSize(const StreamedTexture& texture, uint32_t baseMip) const
+{
+    vk::DeviceSize size = 0;
+    for(size_t i = baseMip; i < texture.mips.size(); ++i)
+        size += texture.mips[i].size();
+
+    return size;
+}
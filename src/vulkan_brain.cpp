@@ -4,15 +4,19 @@
 #include "vulkan_validation.hpp"
 #include <map>
 #include <set>
+#include <string_view>
 
-VulkanBrain::VulkanBrain(const InitInfo& initInfo)
+VulkanBrain::VulkanBrain(const InitInfo& initInfo) :
+    headless(initInfo.headless)
 {
     CreateInstance(initInfo);
     dldi = vk::DispatchLoaderDynamic{ instance, vkGetInstanceProcAddr, device, vkGetDeviceProcAddr };
     SetupDebugMessenger();
-    surface = initInfo.retrieveSurface(instance);
+    if(!headless)
+        surface = initInfo.retrieveSurface(instance);
     PickPhysicalDevice();
     CreateDevice();
+    dldi.init(device);
 
     CreateCommandPool();
     CreateDescriptorPool();
@@ -27,11 +31,14 @@ VulkanBrain::VulkanBrain(const InitInfo& initInfo)
     vmaAllocatorCreateInfo.instance = instance;
     vmaAllocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_3;
     vmaAllocatorCreateInfo.pVulkanFunctions = &vulkanFunctions;
+    if(memoryBudgetSupported)
+        vmaAllocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     vmaCreateAllocator(&vmaAllocatorCreateInfo, &vmaAllocator);
 
     vk::PhysicalDeviceProperties properties;
     physicalDevice.getProperties(&properties);
     minUniformBufferOffsetAlignment = properties.limits.minUniformBufferOffsetAlignment;
+    minStorageBufferOffsetAlignment = properties.limits.minStorageBufferOffsetAlignment;
 }
 
 VulkanBrain::~VulkanBrain()
@@ -128,14 +135,17 @@ uint32_t VulkanBrain::RateDeviceSuitability(const vk::PhysicalDevice& deviceToRa
         return 0;
 
     // Failed if no extensions are supported.
-    if(!ExtensionsSupported(deviceToRate))
+    if(!ExtensionsSupported(deviceToRate, RequiredDeviceExtensions()))
         return 0;
 
-    // Check support for swap chain.
-    SwapChain::SupportDetails swapChainSupportDetails = SwapChain::QuerySupport(deviceToRate, surface);
-    bool swapChainUnsupported = swapChainSupportDetails.formats.empty() || swapChainSupportDetails.presentModes.empty();
-    if(swapChainUnsupported)
-        return 0;
+    // Check support for swap chain, there's nothing to present to without a surface.
+    if(!headless)
+    {
+        SwapChain::SupportDetails swapChainSupportDetails = SwapChain::QuerySupport(deviceToRate, surface);
+        bool swapChainUnsupported = swapChainSupportDetails.formats.empty() || swapChainSupportDetails.presentModes.empty();
+        if(swapChainUnsupported)
+            return 0;
+    }
 
     // Favor discrete GPUs above all else.
     if(deviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
@@ -150,10 +160,10 @@ uint32_t VulkanBrain::RateDeviceSuitability(const vk::PhysicalDevice& deviceToRa
     return score;
 }
 
-bool VulkanBrain::ExtensionsSupported(const vk::PhysicalDevice &deviceToCheckSupport)
+bool VulkanBrain::ExtensionsSupported(const vk::PhysicalDevice &deviceToCheckSupport, const std::vector<const char*>& extensions)
 {
     std::vector<vk::ExtensionProperties> availableExtensions = deviceToCheckSupport.enumerateDeviceExtensionProperties();
-    std::set<std::string> requiredExtensions{ _deviceExtensions.begin(), _deviceExtensions.end() };
+    std::set<std::string> requiredExtensions{ extensions.begin(), extensions.end() };
     for(const auto &extension: availableExtensions)
         requiredExtensions.erase(extension.extensionName);
 
@@ -216,13 +226,44 @@ void VulkanBrain::CreateDevice()
     vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeaturesKhr{};
     dynamicRenderingFeaturesKhr.dynamicRendering = true;
 
+    std::vector<const char*> extensions = RequiredDeviceExtensions();
+
+    // Mesh shading is optional, the renderer falls back to indirect draws without it.
+    vk::PhysicalDeviceMeshShaderFeaturesEXT supportedMeshShaderFeatures{};
+    if(ExtensionsSupported(physicalDevice, _meshShaderExtensions))
+    {
+        vk::PhysicalDeviceFeatures2 features2{};
+        features2.pNext = &supportedMeshShaderFeatures;
+        physicalDevice.getFeatures2(&features2);
+    }
+    meshShadersSupported = supportedMeshShaderFeatures.taskShader && supportedMeshShaderFeatures.meshShader;
+
+    vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    if(meshShadersSupported)
+    {
+        meshShaderFeatures.taskShader = true;
+        meshShaderFeatures.meshShader = true;
+        dynamicRenderingFeaturesKhr.pNext = &meshShaderFeatures;
+        extensions.insert(extensions.end(), _meshShaderExtensions.begin(), _meshShaderExtensions.end());
+    }
+
+    // Timestamps are written with the synchronization 2 commands.
+    vk::PhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+    synchronization2Features.synchronization2 = true;
+    synchronization2Features.pNext = dynamicRenderingFeaturesKhr.pNext;
+    dynamicRenderingFeaturesKhr.pNext = &synchronization2Features;
+
+    memoryBudgetSupported = ExtensionsSupported(physicalDevice, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
+    if(memoryBudgetSupported)
+        extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
     vk::DeviceCreateInfo createInfo{};
     createInfo.pNext = &dynamicRenderingFeaturesKhr;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(_deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = _deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if(_enableValidationLayers)
     {
@@ -268,11 +309,20 @@ void VulkanBrain::CreateDescriptorPool()
     vk::DescriptorPoolCreateInfo createInfo{};
     createInfo.poolSizeCount = poolSizes.size();
     createInfo.pPoolSizes = poolSizes.data();
-    createInfo.maxSets = 200;
+    createInfo.maxSets = 1000;
     createInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
     util::VK_ASSERT(device.createDescriptorPool(&createInfo, nullptr, &descriptorPool), "Failed creating descriptor pool!");
 }
 
+std::vector<const char*> VulkanBrain::RequiredDeviceExtensions() const
+{
+    std::vector<const char*> extensions = _deviceExtensions;
+    if(headless)
+        std::erase_if(extensions, [](const char* extension) { return std::string_view{ extension } == VK_KHR_SWAPCHAIN_EXTENSION_NAME; });
+
+    return extensions;
+}
+
 QueueFamilyIndices QueueFamilyIndices::FindQueueFamilies(vk::PhysicalDevice device, vk::SurfaceKHR surface)
 {
     QueueFamilyIndices indices{};
@@ -288,6 +338,10 @@ QueueFamilyIndices QueueFamilyIndices::FindQueueFamilies(vk::PhysicalDevice devi
         if(queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics)
             indices.graphicsFamily = i;
 
+        // Without a surface nothing gets presented, the graphics queue stands in for the present queue.
+        if(!surface && indices.graphicsFamily.has_value())
+            indices.presentFamily = indices.graphicsFamily;
+
         if(!indices.presentFamily.has_value())
         {
             vk::Bool32 supported;
@@ -1,4 +1,5 @@
 #include "vulkan_helper.hpp"
+#include "memory_manager.hpp"
 
 void util::VK_ASSERT(vk::Result result, std::string_view message)
 {
@@ -98,10 +99,10 @@ void util::CreateImage(VmaAllocator allocator, uint32_t width, uint32_t height,
     allocationInfo.usage = memoryUsage;
 
     util::VK_ASSERT(vmaCreateImage(allocator, reinterpret_cast<VkImageCreateInfo*>(&createInfo), &allocationInfo, reinterpret_cast<VkImage*>(&image), &allocation, nullptr), "Failed creating image!");
-    vmaSetAllocationName(allocator, allocation, name.data());
+    MemoryManager::TrackAllocation(allocator, allocation, name);
 }
 
-void util::CreateBuffer(const VulkanBrain& brain, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, bool mappable, VmaAllocation& allocation, VmaMemoryUsage memoryUsage, std::string_view name)
+void util::CreateBuffer(const VulkanBrain& brain, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, bool mappable, VmaAllocation& allocation, VmaMemoryUsage memoryUsage, std::string_view name, VkMemoryPropertyFlags requiredFlags)
 {
     vk::BufferCreateInfo bufferInfo{};
     bufferInfo.size = size;
@@ -112,11 +113,24 @@ void util::CreateBuffer(const VulkanBrain& brain, vk::DeviceSize size, vk::Buffe
 
     VmaAllocationCreateInfo allocationInfo{};
     allocationInfo.usage = memoryUsage;
+    allocationInfo.requiredFlags = requiredFlags;
     if(mappable)
         allocationInfo.flags |= VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
 
     util::VK_ASSERT(vmaCreateBuffer(brain.vmaAllocator, reinterpret_cast<VkBufferCreateInfo*>(&bufferInfo), &allocationInfo, reinterpret_cast<VkBuffer*>(&buffer), &allocation, nullptr), "Failed creating buffer!");
-    vmaSetAllocationName(brain.vmaAllocator, allocation, name.data());
+    MemoryManager::TrackAllocation(brain.vmaAllocator, allocation, name);
+}
+
+void util::DestroyImage(VmaAllocator allocator, vk::Image image, VmaAllocation allocation)
+{
+    MemoryManager::UntrackAllocation(allocator, allocation);
+    vmaDestroyImage(allocator, image, allocation);
+}
+
+void util::DestroyBuffer(VmaAllocator allocator, vk::Buffer buffer, VmaAllocation allocation)
+{
+    MemoryManager::UntrackAllocation(allocator, allocation);
+    vmaDestroyBuffer(allocator, buffer, allocation);
 }
 
 vk::CommandBuffer util::BeginSingleTimeCommands(const VulkanBrain& brain)
@@ -164,6 +178,11 @@ MaterialHandle util::CreateMaterial(const VulkanBrain& brain, const std::array<s
 {
     MaterialHandle materialHandle;
     materialHandle.textures = textures;
+    materialHandle.featureMask = (info.useAlbedoMap ? 1u << 0 : 0u) |
+                                 (info.useMRMap ? 1u << 1 : 0u) |
+                                 (info.useNormalMap ? 1u << 2 : 0u) |
+                                 (info.useOcclusionMap ? 1u << 3 : 0u) |
+                                 (info.useEmissiveMap ? 1u << 4 : 0u);
 
     util::CreateBuffer(brain, sizeof(MaterialHandle::MaterialInfo), vk::BufferUsageFlagBits::eUniformBuffer, materialHandle.materialUniformBuffer, true, materialHandle.materialUniformAllocation, VMA_MEMORY_USAGE_CPU_ONLY, "Material uniform buffer");
 
@@ -261,7 +280,7 @@ void util::TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image imag
     vk::PipelineStageFlags sourceStage;
     vk::PipelineStageFlags destinationStage;
 
-    if(newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
+    if(newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal || oldLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
     {
         barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
         if(util::HasStencilComponent(format))
@@ -318,6 +337,14 @@ void util::TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image imag
         sourceStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
         destinationStage = vk::PipelineStageFlagBits::eBottomOfPipe;
     }
+    else if (oldLayout == vk::ImageLayout::eColorAttachmentOptimal && newLayout == vk::ImageLayout::eTransferSrcOptimal)
+    {
+        barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+        sourceStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        destinationStage = vk::PipelineStageFlagBits::eTransfer;
+    }
     else if(oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
     {
         barrier.srcAccessMask = vk::AccessFlags{ 0 };
@@ -326,6 +353,30 @@ void util::TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image imag
         sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
         destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
     }
+    else if(oldLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+    {
+        barrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+        sourceStage = vk::PipelineStageFlagBits::eLateFragmentTests;
+        destinationStage = vk::PipelineStageFlagBits::eComputeShader;
+    }
+    else if(oldLayout == vk::ImageLayout::eShaderReadOnlyOptimal && newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
+    {
+        barrier.srcAccessMask = vk::AccessFlags{ 0 };
+        barrier.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+        sourceStage = vk::PipelineStageFlagBits::eComputeShader;
+        destinationStage = vk::PipelineStageFlagBits::eEarlyFragmentTests;
+    }
+    else if(oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eGeneral)
+    {
+        barrier.srcAccessMask = vk::AccessFlags{ 0 };
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
+        destinationStage = vk::PipelineStageFlagBits::eComputeShader;
+    }
     else
         throw std::runtime_error("Unsupported layout transition!");
 